@@ -45,7 +45,21 @@
     **************************************
 
     ## Notes
-    (TODO)
+
+    The video output isn't decoded into the framebuffer on each CCLK tick,
+    instead the gate array collects horizontal spans of either decoded
+    video memory (contiguous in the framebuffer and in video memory) or a
+    solid color (border or sync), and renders a span in one go when it
+    can't be extended anymore. For most software this means that the
+    left border, the display area and the right border of a scanline are
+    each rendered in one pass.
+
+    A span is also rendered before anything changes which would affect
+    its output: before an ink register write, before a video mode switch,
+    and before the CPU writes to video memory read by the span (the host
+    system must call am40010_ram_write() for this). This keeps mid-line
+    palette changes ('rasters') and racing-the-beam exact. Call
+    am40010_flush_video() before the framebuffer content is displayed.
 
     ## Links
 
@@ -243,6 +257,25 @@ typedef struct am40010_crt_t {
     bool v_blank;       // true if currently in vertical blanking
 } am40010_crt_t;
 
+/* pixel decoder lookup table for the current video mode and inks, maps
+   a video memory byte to its 8 decoded pixels as hw palette indices
+*/
+typedef struct am40010_lut_t {
+    bool dirty;         // mode or inks have changed, table must be rebuilt
+    uint8_t mode;       // video mode the table was built for
+    uint8_t pixels[256][8];
+} am40010_lut_t;
+
+// a pending framebuffer span, see Notes
+typedef struct am40010_span_t {
+    uint32_t fb_start;  // framebuffer offset of the span start
+    uint32_t fb_end;    // framebuffer offset after the span (fb_start if none pending)
+    uint16_t addr;      // video memory address of the first decoded byte
+    uint16_t next_addr; // video memory address after the span
+    bool pixels;        // true: decoded video memory, false: solid color
+    uint8_t color;      // hw color index of a solid color span
+} am40010_span_t;
+
 // AM40010 state
 typedef struct am40010_t {
     bool dbg_vis;               // debug visualization currently enabled?
@@ -254,6 +287,8 @@ typedef struct am40010_t {
     am40010_registers_t regs;
     am40010_video_t video;
     am40010_crt_t crt;
+    am40010_lut_t lut;
+    am40010_span_t span;
     am40010_bankswitch_t bankswitch_cb;
     am40010_cclk_t cclk_cb;
     const uint8_t* ram;
@@ -285,6 +320,18 @@ void am40010_iorq(am40010_t* ga, uint64_t cpu_pins);
 */
 uint64_t am40010_tick(am40010_t* ga, uint64_t cpu_pins);
 
+// render the pending framebuffer span
+void am40010_flush_video(am40010_t* ga);
+// set the register state from outside (e.g. a snapshot file), marks the pixel decoder table dirty
+void am40010_set_registers(am40010_t* ga, const am40010_registers_t* regs);
+// call before the CPU writes to the gate-array-visible RAM (addr is the offset into the 64 KByte RAM)
+static inline void am40010_ram_write(am40010_t* ga, uint16_t addr) {
+    const am40010_span_t* s = &ga->span;
+    if (s->pixels && ((uint16_t)(addr - s->addr) < (uint16_t)(s->next_addr - s->addr))) {
+        am40010_flush_video(ga);
+    }
+}
+
 // prepare am40010_t snapshot before saving
 void am40010_snapshot_onsave(am40010_t* snapshot);
 // fixup am40010_t snapshot after loading
@@ -367,6 +414,7 @@ static uint32_t _am40010_cpc_colors[32] = {
 // initialize registers for poweron and reset
 static void _am40010_init_regs(am40010_t* ga) {
     memset(&ga->regs, 0, sizeof(ga->regs));
+    ga->lut.dirty = true;
 }
 
 // initialize video/vsync unit for poweron and reset
@@ -458,6 +506,7 @@ void am40010_init(am40010_t* ga, const am40010_desc_t* desc) {
 
 void am40010_reset(am40010_t* ga) {
     CHIPS_ASSERT(ga);
+    am40010_flush_video(ga);
     ga->seq_tick_count = 0;
     _am40010_init_regs(ga);
     _am40010_init_video(ga);
@@ -495,8 +544,10 @@ void am40010_iorq(am40010_t* ga, uint64_t pins) {
                 if (ga->regs.inksel & (1<<4)) {
                     ga->regs.border = data & 0x1F;
                 }
-                else {
+                else if (ga->regs.ink[ga->regs.inksel] != (data & 0x1F)) {
+                    am40010_flush_video(ga);
                     ga->regs.ink[ga->regs.inksel] = data & 0x1F;
+                    ga->lut.dirty = true;
                 }
                 break;
 
@@ -681,7 +732,14 @@ static bool _am40010_sync_irq(am40010_t* ga, uint64_t crtc_pins) {
     uint8_t clkcnt = ga->video.clkcnt;
     if (clkcnt == 7) {
         // trigger video-mode switch
-        ga->video.mode = ga->regs.config & AM40010_CONFIG_MODE;
+        const uint8_t mode = ga->regs.config & AM40010_CONFIG_MODE;
+        if (mode != ga->video.mode) {
+            am40010_flush_video(ga);
+            ga->video.mode = mode;
+        }
+        if (ga->video.mode != ga->lut.mode) {
+            ga->lut.dirty = true;
+        }
     }
     // if HSYNC is off, force the clkcnt counter to 0
     if (0 == (crtc_pins & AM40010_HS)) {
@@ -702,23 +760,13 @@ static bool _am40010_sync_irq(am40010_t* ga, uint64_t crtc_pins) {
     return ga->video.sync;
 }
 
-static void _am40010_decode_pixels(am40010_t* ga, uint8_t* dst, uint64_t crtc_pins) {
-    /*
-         compute the source address from current CRTC ma (memory address)
-         and ra (raster address) like this:
-
-         |ma13|ma12|ra2|ra1|ra0|ma9|ma8|ma7|ma6|ma5|ma4|ma3|ma2|ma1|ma0|0|
-
-        Bits ma13 and m12 point to the 16 KByte page, and all
-        other bits are the index into that page.
-    */
-    const uint16_t addr = ((crtc_pins & 0x3000) << 2) |     // MA13,MA12
-                          ((crtc_pins & 0x3FF) << 1) |      // MA9..MA0
-                          (((crtc_pins>>48) & 7) << 11);    // RA0..RA2
-    const uint8_t* src = &(ga->ram[addr]);
-    uint8_t c;
-    uint8_t p;
-    switch (ga->video.mode) {
+/*  Return the pen (ink index) of pixel i (0..7) of a video memory byte,
+    all video modes decode 8 pixels per byte, wider pixels are repeated.
+    The pen bits of the following pixels are at the same positions
+    when the byte is shifted left by one bit per pixel.
+*/
+static uint8_t _am40010_pen(uint8_t mode, uint8_t c, size_t i) {
+    switch (mode) {
         case 0:
             /*
                 160x200 @ 16 colors (2 pixels per byte)
@@ -726,14 +774,8 @@ static void _am40010_decode_pixels(am40010_t* ga, uint8_t* dst, uint64_t crtc_pi
                 0:       |1|5|3|7|
                 1:       |0|4|2|6|
             */
-            for (size_t i = 0; i < 2; i++) {
-                c = *src++;
-                p = ga->regs.ink[((c>>7)&0x1)|((c>>2)&0x2)|((c>>3)&0x4)|((c<<2)&0x8)];
-                *dst++ = p; *dst++ = p; *dst++ = p; *dst++ = p;
-                p = ga->regs.ink[((c>>6)&0x1)|((c>>1)&0x2)|((c>>2)&0x4)|((c<<3)&0x8)];
-                *dst++ = p; *dst++ = p; *dst++ = p; *dst++ = p;
-            }
-            break;
+            c = (uint8_t)(c << (i>>2));
+            return ((c>>7)&0x1)|((c>>2)&0x2)|((c>>3)&0x4)|((c<<2)&0x8);
         case 1:
             /*
                 320x200 @ 4 colors (4 pixels per byte)
@@ -743,32 +785,11 @@ static void _am40010_decode_pixels(am40010_t* ga, uint8_t* dst, uint64_t crtc_pi
                 2:       |1|5|
                 3:       |0|4|
             */
-            for (size_t i = 0; i < 2; i++) {
-                c = *src++;
-                p = ga->regs.ink[((c>>2)&2)|((c>>7)&1)];
-                *dst++ = p; *dst++ = p;
-                p = ga->regs.ink[((c>>1)&2)|((c>>6)&1)];
-                *dst++ = p; *dst++ = p;
-                p = ga->regs.ink[((c>>0)&2)|((c>>5)&1)];
-                *dst++ = p; *dst++ = p;
-                p = ga->regs.ink[((c<<1)&2)|((c>>4)&1)];
-                *dst++ = p; *dst++ = p;
-            }
-            break;
+            c = (uint8_t)(c << (i>>1));
+            return ((c>>2)&2)|((c>>7)&1);
         case 2:
             // 640x200 @ 2 colors (8 pixels per byte)
-            for (size_t i = 0; i < 2; i++) {
-                c = *src++;
-                *dst++ = ga->regs.ink[(c>>7)&1];
-                *dst++ = ga->regs.ink[(c>>6)&1];
-                *dst++ = ga->regs.ink[(c>>5)&1];
-                *dst++ = ga->regs.ink[(c>>4)&1];
-                *dst++ = ga->regs.ink[(c>>3)&1];
-                *dst++ = ga->regs.ink[(c>>2)&1];
-                *dst++ = ga->regs.ink[(c>>1)&1];
-                *dst++ = ga->regs.ink[(c>>0)&1];
-            }
-            break;
+            return (c>>(7-i))&1;
         case 3:
             /*  undocumented mode 3:
                 160x200 @ 4 colors (2 pixels per byte)
@@ -776,21 +797,133 @@ static void _am40010_decode_pixels(am40010_t* ga, uint8_t* dst, uint64_t crtc_pi
                 0:       |x|x|3|7|
                 1:       |x|x|2|6|
             */
-            for (size_t i = 0; i < 2; i++) {
-                c = *src++;
-                p = ga->regs.ink[((c>>7)&0x1)|((c>>2)&0x2)];
-                *dst++ = p; *dst++ = p; *dst++ = p; *dst++ = p;
-                p = ga->regs.ink[((c>>6)&0x1)|((c>>1)&0x2)];
-                *dst++ = p; *dst++ = p; *dst++ = p; *dst++ = p;
+            c = (uint8_t)(c << (i>>2));
+            return ((c>>7)&0x1)|((c>>2)&0x2);
+        default: _AM40010_UNREACHABLE; return 0;
+    }
+}
+
+/*  Rebuild the pixel decoder lookup table for the current mode and inks.
+
+    In all modes, the left 4 pixels only depend on 4 bits of a video byte
+    (selected by the mask below), and the right 4 pixels on the other 4
+    bits. So only 2*16 half-entries need to be decoded, and each of the 256
+    table entries is then just a combination of a left and right half.
+*/
+static void _am40010_build_lut(am40010_t* ga) {
+    static const uint8_t left_mask[4] = { 0xAA, 0xCC, 0xF0, 0xAA };
+    const uint8_t mode = ga->video.mode;
+    uint8_t bits[2][16];
+    uint8_t half[2][16][4];
+    for (size_t h = 0; h < 2; h++) {
+        const uint8_t mask = h ? ~left_mask[mode] : left_mask[mode];
+        for (uint8_t n = 0; n < 16; n++) {
+            // deposit the 4 bits of n into the mask bit positions
+            uint8_t c = 0;
+            uint8_t nb = 0;
+            for (uint8_t b = 0; b < 8; b++) {
+                if (mask & (1<<b)) {
+                    if (n & (1<<nb)) {
+                        c |= (1<<b);
+                    }
+                    nb++;
+                }
+            }
+            bits[h][n] = c;
+            for (size_t i = 0; i < 4; i++) {
+                half[h][n][i] = ga->regs.ink[_am40010_pen(mode, c, h*4 + i)];
             }
-            break;
-        default: _AM40010_UNREACHABLE;
+        }
     }
+    for (size_t l = 0; l < 16; l++) {
+        for (size_t r = 0; r < 16; r++) {
+            uint8_t* dst = ga->lut.pixels[bits[0][l] | bits[1][r]];
+            memcpy(dst, half[0][l], 4);
+            memcpy(dst + 4, half[1][r], 4);
+        }
+    }
+    ga->lut.mode = mode;
+    ga->lut.dirty = false;
+}
+
+/*
+    compute the video memory address from current CRTC ma (memory address)
+    and ra (raster address) like this:
+
+    |ma13|ma12|ra2|ra1|ra0|ma9|ma8|ma7|ma6|ma5|ma4|ma3|ma2|ma1|ma0|0|
+
+    Bits ma13 and m12 point to the 16 KByte page, and all
+    other bits are the index into that page.
+*/
+static inline uint16_t _am40010_video_addr(uint64_t crtc_pins) {
+    return ((crtc_pins & 0x3000) << 2) |    // MA13,MA12
+           ((crtc_pins & 0x3FF) << 1) |     // MA9..MA0
+           (((crtc_pins>>48) & 7) << 11);   // RA0..RA2
+}
+
+// decode the 2 video memory bytes of a CCLK tick into 16 pixels
+static void _am40010_decode_pixels(am40010_t* ga, uint8_t* dst, uint64_t crtc_pins) {
+    const uint8_t* src = &(ga->ram[_am40010_video_addr(crtc_pins)]);
+    if (ga->lut.dirty) {
+        _am40010_build_lut(ga);
+    }
+    memcpy(dst, ga->lut.pixels[src[0]], 8);
+    memcpy(dst + 8, ga->lut.pixels[src[1]], 8);
+}
+
+void am40010_flush_video(am40010_t* ga) {
+    CHIPS_ASSERT(ga);
+    am40010_span_t* s = &ga->span;
+    if (s->fb_end != s->fb_start) {
+        uint8_t* dst = &ga->fb[s->fb_start];
+        const uint32_t num_bytes = s->fb_end - s->fb_start;
+        if (s->pixels) {
+            if (ga->lut.dirty) {
+                _am40010_build_lut(ga);
+            }
+            const uint8_t* src = &ga->ram[s->addr];
+            for (uint32_t i = 0; i < num_bytes; i += 8) {
+                memcpy(&dst[i], ga->lut.pixels[*src++], 8);
+            }
+        }
+        else {
+            memset(dst, s->color, num_bytes);
+        }
+        s->fb_start = s->fb_end;
+    }
+    // make sure that the next CCLK tick starts a new span
+    s->pixels = false;
+    s->color = 0xFF;
+}
+
+// extend the pending span by 16 decoded pixels, or start a new span
+static inline void _am40010_span_pixels(am40010_t* ga, uint32_t fb_ofs, uint16_t addr) {
+    am40010_span_t* s = &ga->span;
+    if (!(s->pixels && (fb_ofs == s->fb_end) && (addr == s->next_addr))) {
+        am40010_flush_video(ga);
+        s->pixels = true;
+        s->fb_start = s->fb_end = fb_ofs;
+        s->addr = s->next_addr = addr;
+    }
+    s->fb_end += 16;
+    s->next_addr += 2;
+}
+
+// extend the pending span by 16 solid color pixels, or start a new span
+static inline void _am40010_span_color(am40010_t* ga, uint32_t fb_ofs, uint8_t color) {
+    am40010_span_t* s = &ga->span;
+    if (s->pixels || (color != s->color) || (fb_ofs != s->fb_end)) {
+        am40010_flush_video(ga);
+        s->color = color;
+        s->fb_start = s->fb_end = fb_ofs;
+    }
+    s->fb_end += 16;
 }
 
 // video signal generator, call this at 1 MHz frequency
 static void _am40010_decode_video(am40010_t* ga, uint64_t crtc_pins) {
     if (ga->dbg_vis) {
+        am40010_flush_video(ga);
         size_t dst_x = ga->crt.h_pos * 16;
         size_t dst_y = ga->crt.v_pos;
         if ((dst_x <= (AM40010_FRAMEBUFFER_WIDTH-16)) && (dst_y < AM40010_FRAMEBUFFER_HEIGHT)) {
@@ -838,22 +971,15 @@ static void _am40010_decode_video(am40010_t* ga, uint64_t crtc_pins) {
         }
     }
     else if (ga->crt.visible) {
-        size_t dst_x = ga->crt.pos_x * 16;
-        size_t dst_y = ga->crt.pos_y;
-        bool black = ga->video.sync;
-        uint8_t* dst = &ga->fb[dst_x + dst_y * AM40010_FRAMEBUFFER_WIDTH];
+        const uint32_t fb_ofs = ga->crt.pos_x * 16 + ga->crt.pos_y * AM40010_FRAMEBUFFER_WIDTH;
         if (crtc_pins & AM40010_DE) {
-            _am40010_decode_pixels(ga, dst, crtc_pins);
+            _am40010_span_pixels(ga, fb_ofs, _am40010_video_addr(crtc_pins));
         }
-        else if (black) {
-            for (int i = 0; i < 16; i++) {
-                *dst++ = 63;    // special 'pure black' hw color
-            }
+        else if (ga->video.sync) {
+            _am40010_span_color(ga, fb_ofs, 63);    // special 'pure black' hw color
         }
         else {
-            for (int i = 0; i < 16; i++) {
-                *dst++ = ga->regs.border;
-            }
+            _am40010_span_color(ga, fb_ofs, ga->regs.border);
         }
     }
 }
@@ -929,6 +1055,18 @@ uint64_t am40010_tick(am40010_t* ga, uint64_t pins) {
     return pins;
 }
 
+void am40010_set_registers(am40010_t* ga, const am40010_registers_t* regs) {
+    CHIPS_ASSERT(ga && regs);
+    am40010_flush_video(ga);
+    ga->regs.inksel = regs->inksel & 0x1F;
+    ga->regs.config = regs->config & 0x3F;
+    ga->regs.border = regs->border & 0x1F;
+    for (int i = 0; i < 16; i++) {
+        ga->regs.ink[i] = regs->ink[i] & 0x1F;
+    }
+    ga->lut.dirty = true;
+}
+
 void am40010_snapshot_onsave(am40010_t* snapshot) {
     CHIPS_ASSERT(snapshot);
     snapshot->bankswitch_cb = 0;
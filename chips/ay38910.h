@@ -7,6 +7,10 @@
     before you include this file in *one* C or C++ file to create the
     implementation.
 
+    You need to include chips/chips_common.h before including ay38910.h,
+    the chip output is converted to the host sample rate with the
+    band-limited step resampler (chips_blep_t) from chips_common.h.
+
     Optionally provde the following macros with your own implementation
 
     CHIPS_ASSERT(c)     -- your own assert macro (default: assert(c))
@@ -33,6 +37,23 @@
       a CP1610 CPU
     - the RESET pin state is ignored, instead call ay38910_reset()
 
+    RENDERING SAMPLE BLOCKS:
+
+    Instead of calling ay38910_tick() on every tick, the PSG can be
+    advanced in bulk between register accesses with:
+
+        uint32_t ay38910_render(ay38910_t* ay, uint32_t num_ticks, float* samples, int max_samples, int* num_samples)
+
+    This runs the PSG for up to num_ticks ticks and writes the new samples
+    to the samples array, it stops right after the tick which produced the
+    max_samples-th sample. The number of samples written is returned in
+    num_samples, and the number of ticks actually run is the return value.
+
+    Between two tone, noise or envelope counter overflows the output level
+    doesn't change, so those ticks are skipped in one step (and the samples
+    in between are generated by the resampler without ticking the PSG).
+    The result is identical to calling ay38910_tick() num_ticks times.
+
     ## zlib/libpng license
 
     Copyright (c) 2018 Andre Weissflog
@@ -161,12 +182,8 @@ extern "C" {
 #define AY38910_REG_IO_PORT_B           (15)    // not on AY-3-8912/3
 // number of registers
 #define AY38910_NUM_REGISTERS (16)
-// error-accumulation precision boost
-#define AY38910_FIXEDPOINT_SCALE (16)
 // number of channels
 #define AY38910_NUM_CHANNELS (3)
-// DC adjustment buffer length
-#define AY38910_DCADJ_BUFLEN (512)
 
 // IO port names
 #define AY38910_PORT_A (0)
@@ -263,13 +280,9 @@ typedef struct {
     uint64_t pins;          // last pin state for debug inspection
 
     // sample generation state
-    int sample_period;
-    int sample_counter;
     float mag;
     float sample;
-    float dcadj_sum;
-    uint32_t dcadj_pos;
-    float dcadj_buf[AY38910_DCADJ_BUFLEN];
+    chips_blep_t blep;
 } ay38910_t;
 
 // extract 8-bit data bus from 64-bit pins
@@ -289,6 +302,8 @@ void ay38910_reset(ay38910_t* ay);
 uint64_t ay38910_iorq(ay38910_t* ay, uint64_t pins);
 // tick the AY-3-8910, return true if a new sample is ready
 bool ay38910_tick(ay38910_t* ay);
+// run the AY-3-8910 for up to num_ticks ticks and write the new samples into a buffer, returns number of ticks run
+uint32_t ay38910_render(ay38910_t* ay, uint32_t num_ticks, float* samples, int max_samples, int* num_samples);
 // helper functions to directly write register values and update dependent state, not intended for regular operation!
 void ay38910_set_register(ay38910_t* ay, uint8_t addr, uint8_t data);
 void ay38910_set_addr_latch(ay38910_t* ay, uint8_t addr);
@@ -380,17 +395,26 @@ static const uint8_t _ay38910_shapes[16][32] = {
     { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 };
 
-/* DC adjustment filter from StSound, this moves an "offcenter"
-   signal back to the zero-line (e.g. the volume-level output
-   from the chip simulation which is >0.0 gets converted to
-   a +/- sample value)
-*/
-static float _ay38910_dcadjust(ay38910_t* ay, float s) {
-    ay->dcadj_sum -= ay->dcadj_buf[ay->dcadj_pos];
-    ay->dcadj_sum += s;
-    ay->dcadj_buf[ay->dcadj_pos] = s;
-    ay->dcadj_pos = (ay->dcadj_pos + 1) & (AY38910_DCADJ_BUFLEN-1);
-    return s - (ay->dcadj_sum / AY38910_DCADJ_BUFLEN);
+// report the current output level to the resampler
+static void _ay38910_update_level(ay38910_t* ay) {
+    float sm = 0.0f;
+    for (int i = 0; i < AY38910_NUM_CHANNELS; i++) {
+        const ay38910_tone_t* chn = &ay->tone[i];
+        float vol;
+        if (0 == (ay->reg[AY38910_REG_AMP_A+i] & (1<<4))) {
+            // fixed amplitude
+            vol = _ay38910_volumes[ay->reg[AY38910_REG_AMP_A+i] & 0x0F];
+        }
+        else {
+            // envelope control
+            vol = _ay38910_volumes[ay->env.shape_state];
+        }
+        int vol_enable = (chn->bit|chn->tone_disable) & ((ay->noise.rng&1)|(chn->noise_disable));
+        if (vol_enable) {
+            sm += vol;
+        }
+    }
+    chips_blep_set(&ay->blep, sm * ay->mag);
 }
 
 // update computed values after registers have been reprogrammed
@@ -444,11 +468,11 @@ void ay38910_init(ay38910_t* ay, const ay38910_desc_t* desc) {
     ay->user_data = desc->user_data;
     ay->type = desc->type;
     ay->noise.rng = 1;
-    ay->sample_period = (desc->tick_hz * AY38910_FIXEDPOINT_SCALE) / desc->sound_hz;
-    ay->sample_counter = ay->sample_period;
     ay->mag = desc->magnitude;
+    chips_blep_init(&ay->blep, desc->tick_hz, desc->sound_hz);
     _ay38910_update_values(ay);
     _ay38910_restart_env_shape(ay);
+    _ay38910_update_level(ay);
 }
 
 void ay38910_reset(ay38910_t* ay) {
@@ -458,11 +482,14 @@ void ay38910_reset(ay38910_t* ay) {
     for (int i = 0; i < AY38910_NUM_REGISTERS; i++) {
         ay->reg[i] = 0;
     }
+    chips_blep_reset(&ay->blep);
     _ay38910_update_values(ay);
     _ay38910_restart_env_shape(ay);
+    _ay38910_update_level(ay);
 }
 
 bool ay38910_tick(ay38910_t* ay) {
+    bool update_level = false;
     ay->tick++;
     if ((ay->tick & 7) == 0) {
         // tick the tone channels
@@ -488,6 +515,7 @@ bool ay38910_tick(ay38910_t* ay) {
                 ay->noise.rng >>= 1;
             }
         }
+        update_level = true;
     }
 
     // tick the envelope generator
@@ -504,34 +532,82 @@ bool ay38910_tick(ay38910_t* ay) {
         }
     }
 
+    // the output level can only change when the tone, noise or envelope generator ticked
+    if (update_level) {
+        _ay38910_update_level(ay);
+    }
+
     // generate new sample?
-    ay->sample_counter -= AY38910_FIXEDPOINT_SCALE;
-    if (ay->sample_counter <= 0) {
-        ay->sample_counter += ay->sample_period;
-        float sm = 0.0f;
-        for (int i = 0; i < AY38910_NUM_CHANNELS; i++) {
-            const ay38910_tone_t* chn = &ay->tone[i];
-            float vol;
-            if (0 == (ay->reg[AY38910_REG_AMP_A+i] & (1<<4))) {
-                // fixed amplitude
-                vol = _ay38910_volumes[ay->reg[AY38910_REG_AMP_A+i] & 0x0F];
-            }
-            else {
-                // envelope control
-                vol = _ay38910_volumes[ay->env.shape_state];
-            }
-            int vol_enable = (chn->bit|chn->tone_disable) & ((ay->noise.rng&1)|(chn->noise_disable));
-            if (vol_enable) {
-                sm += vol;
-            }
-        }
-        ay->sample = _ay38910_dcadjust(ay, sm) * ay->mag;
+    if (chips_blep_tick(&ay->blep)) {
+        ay->sample = ay->blep.sample;
         return true; // new sample is ready
     }
     // fallthrough: no new sample ready yet
     return false;
 }
 
+// number of ticks until the next tone, noise or envelope counter overflow
+static uint32_t _ay38910_ticks_until_event(const ay38910_t* ay) {
+    // tone and noise counters are ticked every 8 ticks, the envelope every 16 ticks
+    const uint32_t first_step8 = 8 - (ay->tick & 7);
+    const uint32_t first_step16 = 16 - (ay->tick & 15);
+    uint32_t steps = (ay->noise.counter < ay->noise.period) ? (ay->noise.period - ay->noise.counter) : 1;
+    for (int i = 0; i < AY38910_NUM_CHANNELS; i++) {
+        const ay38910_tone_t* chn = &ay->tone[i];
+        const uint32_t s = (chn->counter < chn->period) ? (chn->period - chn->counter) : 1;
+        if (s < steps) {
+            steps = s;
+        }
+    }
+    const uint32_t ticks8 = first_step8 + 8 * (steps - 1);
+    const uint32_t env_steps = (ay->env.counter < ay->env.period) ? (ay->env.period - ay->env.counter) : 1;
+    const uint32_t ticks16 = first_step16 + 16 * (env_steps - 1);
+    return (ticks8 < ticks16) ? ticks8 : ticks16;
+}
+
+// advance the counters by a number of ticks without counter overflow
+static void _ay38910_skip(ay38910_t* ay, uint32_t num_ticks) {
+    const uint16_t steps8 = (uint16_t)(((ay->tick & 7) + num_ticks) >> 3);
+    const uint16_t steps16 = (uint16_t)(((ay->tick & 15) + num_ticks) >> 4);
+    for (int i = 0; i < AY38910_NUM_CHANNELS; i++) {
+        ay->tone[i].counter += steps8;
+    }
+    ay->noise.counter += steps8;
+    ay->env.counter += steps16;
+    ay->tick += num_ticks;
+}
+
+uint32_t ay38910_render(ay38910_t* ay, uint32_t num_ticks, float* samples, int max_samples, int* num_samples) {
+    CHIPS_ASSERT(ay && num_samples && ((max_samples == 0) || samples));
+    uint32_t ticks = 0;
+    int n = 0;
+    while ((ticks < num_ticks) && (n < max_samples)) {
+        uint32_t idle_ticks = _ay38910_ticks_until_event(ay) - 1;
+        if (idle_ticks > (num_ticks - ticks)) {
+            idle_ticks = num_ticks - ticks;
+        }
+        if (idle_ticks > 0) {
+            // the output level is constant until the next counter overflow
+            int k = 0;
+            const uint32_t r = chips_blep_run(&ay->blep, idle_ticks, &samples[n], max_samples - n, &k);
+            _ay38910_skip(ay, r);
+            if (k > 0) {
+                n += k;
+                ay->sample = samples[n-1];
+            }
+            ticks += r;
+        }
+        else {
+            if (ay38910_tick(ay)) {
+                samples[n++] = ay->sample;
+            }
+            ticks++;
+        }
+    }
+    *num_samples = n;
+    return ticks;
+}
+
 uint64_t ay38910_iorq(ay38910_t* ay, uint64_t pins) {
     if (pins & AY38910_BDIR) {
         const uint8_t data = AY38910_GET_DATA(pins);
@@ -579,6 +655,7 @@ uint64_t ay38910_iorq(ay38910_t* ay, uint64_t pins) {
                         }
                     }
                 }
+                _ay38910_update_level(ay);
             }
         }
     }
@@ -649,6 +726,7 @@ void ay38910_set_register(ay38910_t* ay, uint8_t addr, uint8_t data) {
     if (addr == AY38910_REG_ENV_SHAPE_CYCLE) {
         _ay38910_restart_env_shape(ay);
     }
+    _ay38910_update_level(ay);
 }
 
 void ay38910_set_addr_latch(ay38910_t* ay, uint8_t addr) {
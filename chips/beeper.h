@@ -2,7 +2,39 @@
 /*
     beeper.h    -- simple square-wave beeper
 
-    TODO: docs
+    You need to include chips/chips_common.h before including beeper.h,
+    the beeper output is converted to the host sample rate with the
+    band-limited step resampler (chips_blep_t) from chips_common.h.
+
+    The beeper can be driven in two ways:
+
+    - per tick: call beeper_set(), beeper_toggle() or beeper_set_volume()
+      whenever the output changes, and beeper_tick() on every input tick,
+      a new sample is ready in beeper->sample when beeper_tick() returns
+      true
+
+    - event mode: call beeper_set_at(), beeper_toggle_at() or
+      beeper_set_volume_at() with the number of ticks since the last
+      beeper_run() call, this only records the output change with its
+      timestamp, and call beeper_run() when the samples are needed (for
+      instance when the audio buffer is flushed), the work then only
+      depends on the number of output changes and output samples, not
+      on the number of ticks
+
+    ~~~C
+    uint32_t beeper_run(beeper_t* beeper, uint32_t num_ticks, float* samples, int max_samples, int* num_samples)
+    ~~~
+        Advance the beeper by up to num_ticks ticks, applying all recorded
+        output changes at their timestamps, and write the new samples to
+        samples. Stops right after the tick which produced the
+        max_samples-th sample, returns the number of ticks actually run
+        and the number of samples written in num_samples. The timestamps
+        of the remaining recorded changes are moved back by the returned
+        number of ticks.
+
+    Up to BEEPER_MAX_EVENTS changes can be recorded, call beeper_run()
+    before recording a new change when beeper_events_full() returns true.
+    Don't mix the per-tick and event mode functions.
 
     ## zlib/libpng license
 
@@ -29,10 +61,10 @@
 extern "C" {
 #endif
 
-// error-accumulation precision boost
-#define BEEPER_FIXEDPOINT_SCALE (16)
-// DC adjust buffer size
-#define BEEPER_DCADJ_BUFLEN (512)
+// max number of recorded output changes in event mode
+#ifndef BEEPER_MAX_EVENTS
+#define BEEPER_MAX_EVENTS (32)
+#endif
 
 // initialization parameters
 typedef struct {
@@ -41,37 +73,87 @@ typedef struct {
     float base_volume;
 } beeper_desc_t;
 
+// a recorded output change in event mode
+typedef struct {
+    uint32_t tick;      // ticks since the last beeper_run() call
+    float level;        // the new output level
+} beeper_event_t;
+
 // beeper state
 typedef struct {
     int state;
-    int period;
-    int counter;
     float base_volume;
     float volume;
     float sample;
-    float dcadj_sum;
-    uint32_t dcadj_pos;
-    float dcadj_buf[BEEPER_DCADJ_BUFLEN];
+    chips_blep_t blep;
+    uint32_t num_events;
+    beeper_event_t events[BEEPER_MAX_EVENTS];
 } beeper_t;
 
 // initialize beeper instance
 void beeper_init(beeper_t* beeper, const beeper_desc_t* desc);
 // reset the beeper instance
 void beeper_reset(beeper_t* beeper);
+// report the current output level to the resampler
+static inline void _beeper_update(beeper_t* beeper) {
+    chips_blep_set(&beeper->blep, (float)beeper->state * beeper->volume * beeper->base_volume);
+}
 // set current on/off state
 static inline void beeper_set(beeper_t* beeper, bool state) {
-    beeper->state = state ? 1 : 0;
+    const int s = state ? 1 : 0;
+    if (s != beeper->state) {
+        beeper->state = s;
+        _beeper_update(beeper);
+    }
 }
 // toggle current state (on->off or off->on)
 static inline void beeper_toggle(beeper_t* beeper) {
     beeper->state = !beeper->state;
+    _beeper_update(beeper);
 }
 // set current volume 0.0 to 1.0
 static inline void beeper_set_volume(beeper_t* beeper, float vol) {
-    beeper->volume = vol;
+    if (vol != beeper->volume) {
+        beeper->volume = vol;
+        _beeper_update(beeper);
+    }
 }
 // tick the beeper, return true if a new sample is ready
-bool beeper_tick(beeper_t* beeper);
+static inline bool beeper_tick(beeper_t* beeper) {
+    if (chips_blep_tick(&beeper->blep)) {
+        beeper->sample = beeper->blep.sample;
+        return true;
+    }
+    return false;
+}
+// return true if no more output changes can be recorded until the next beeper_run()
+static inline bool beeper_events_full(const beeper_t* beeper) {
+    return beeper->num_events >= BEEPER_MAX_EVENTS;
+}
+// record the current output level (called from the *_at() functions)
+void beeper_record_event(beeper_t* beeper, uint32_t tick);
+// event mode: set current on/off state at a tick offset
+static inline void beeper_set_at(beeper_t* beeper, uint32_t tick, bool state) {
+    const int s = state ? 1 : 0;
+    if (s != beeper->state) {
+        beeper->state = s;
+        beeper_record_event(beeper, tick);
+    }
+}
+// event mode: toggle current state at a tick offset
+static inline void beeper_toggle_at(beeper_t* beeper, uint32_t tick) {
+    beeper->state = !beeper->state;
+    beeper_record_event(beeper, tick);
+}
+// event mode: set current volume 0.0 to 1.0 at a tick offset
+static inline void beeper_set_volume_at(beeper_t* beeper, uint32_t tick, float vol) {
+    if (vol != beeper->volume) {
+        beeper->volume = vol;
+        beeper_record_event(beeper, tick);
+    }
+}
+// event mode: run the beeper for up to num_ticks and write the new samples into a buffer
+uint32_t beeper_run(beeper_t* beeper, uint32_t num_ticks, float* samples, int max_samples, int* num_samples);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -88,43 +170,63 @@ void beeper_init(beeper_t* b, const beeper_desc_t* desc) {
     CHIPS_ASSERT(b && desc);
     CHIPS_ASSERT((desc->tick_hz > 0) && (desc->sound_hz > 0));
     *b = (beeper_t){
-        .period = (desc->tick_hz * BEEPER_FIXEDPOINT_SCALE) / desc->sound_hz,
-        .counter = b->period,
         .base_volume = desc->base_volume,
         .volume = 1.0f,
     };
+    chips_blep_init(&b->blep, desc->tick_hz, desc->sound_hz);
 }
 
 void beeper_reset(beeper_t* b) {
     CHIPS_ASSERT(b);
     b->state = 0;
-    b->counter = b->period;
     b->sample = 0;
+    b->num_events = 0;
+    chips_blep_reset(&b->blep);
 }
 
-/* DC adjustment filter from StSound, this moves an "offcenter"
-   signal back to the zero-line (e.g. the volume-level output
-   from the chip simulation which is >0.0 gets converted to
-   a +/- sample value)
-*/
-static float _beeper_dcadjust(beeper_t* bp, float s) {
-    bp->dcadj_sum -= bp->dcadj_buf[bp->dcadj_pos];
-    bp->dcadj_sum += s;
-    bp->dcadj_buf[bp->dcadj_pos] = s;
-    bp->dcadj_pos = (bp->dcadj_pos + 1) & (BEEPER_DCADJ_BUFLEN-1);
-    return s - (bp->dcadj_sum / BEEPER_DCADJ_BUFLEN);
+void beeper_record_event(beeper_t* b, uint32_t tick) {
+    CHIPS_ASSERT(b && (b->num_events < BEEPER_MAX_EVENTS));
+    CHIPS_ASSERT((b->num_events == 0) || (tick >= b->events[b->num_events-1].tick));
+    beeper_event_t* ev = &b->events[b->num_events++];
+    ev->tick = tick;
+    ev->level = (float)b->state * b->volume * b->base_volume;
 }
 
-bool beeper_tick(beeper_t* bp) {
-    /* generate a new sample? */
-    bp->counter -= BEEPER_FIXEDPOINT_SCALE;
-    if (bp->counter <= 0) {
-        bp->counter += bp->period;
-        bp->sample = _beeper_dcadjust(bp, (float)bp->state * bp->volume * bp->base_volume);
-        return true;
+uint32_t beeper_run(beeper_t* b, uint32_t num_ticks, float* samples, int max_samples, int* num_samples) {
+    CHIPS_ASSERT(b && num_samples && ((max_samples == 0) || samples));
+    uint32_t ticks = 0;
+    uint32_t ev = 0;
+    int n = 0;
+    for (;;) {
+        // apply the output changes at the current tick
+        while ((ev < b->num_events) && (b->events[ev].tick <= ticks)) {
+            chips_blep_set(&b->blep, b->events[ev++].level);
+        }
+        if ((ticks >= num_ticks) || (n >= max_samples)) {
+            break;
+        }
+        // the output is constant until the next change
+        uint32_t until = num_ticks;
+        if ((ev < b->num_events) && (b->events[ev].tick < until)) {
+            until = b->events[ev].tick;
+        }
+        int k = 0;
+        ticks += chips_blep_run(&b->blep, until - ticks, &samples[n], max_samples - n, &k);
+        n += k;
     }
-    return false;
+    if (n > 0) {
+        b->sample = samples[n-1];
+    }
+    // move the remaining changes to the front, relative to the new start tick
+    uint32_t num_events = 0;
+    for (; ev < b->num_events; ev++) {
+        b->events[num_events].tick = b->events[ev].tick - ticks;
+        b->events[num_events].level = b->events[ev].level;
+        num_events++;
+    }
+    b->num_events = num_events;
+    *num_samples = n;
+    return ticks;
 }
 
-
 #endif /* CHIPS_IMPL */
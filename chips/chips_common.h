@@ -4,6 +4,49 @@
 
     Common data types for chips system headers.
 
+    ## Band-limited audio resampling
+
+    The sound chips (m6561.h, ay38910.h, beeper.h) don't produce output
+    samples themselves, instead they report changes of their output level
+    to a chips_blep_t which converts from the chip clock to the host
+    sample rate:
+
+    ~~~C
+    void chips_blep_init(chips_blep_t* blep, int tick_hz, int sound_hz)
+    ~~~
+        Initialize the resampler for an input clock (the frequency at which
+        chips_blep_tick() will be called) and an output sample rate.
+
+    ~~~C
+    void chips_blep_set(chips_blep_t* blep, float level)
+    ~~~
+        Set the input level at the current tick. Each level change is
+        inserted into the output as a band-limited step (a windowed-sinc
+        'BLEP') at its exact position between two output samples, calling
+        this function with an unchanged level does nothing.
+
+    ~~~C
+    bool chips_blep_tick(chips_blep_t* blep)
+    ~~~
+        Advance by one input tick, returns true when a new output sample
+        is ready in blep->sample.
+
+    ~~~C
+    uint32_t chips_blep_run(chips_blep_t* blep, uint32_t num_ticks, float* samples, int max_samples, int* num_samples)
+    ~~~
+        Advance by up to num_ticks input ticks without level changes and
+        write the new output samples to samples, stops right after the
+        tick which produced the max_samples-th sample. Returns the number
+        of ticks actually run, the number of samples written is returned
+        in num_samples.
+
+    Since the work only depends on the number of level changes and output
+    samples, mostly constant signals (like a beeper) are cheap, and unlike
+    point-sampling or averaging the chip output over a sample period, tones
+    above the Nyquist frequency don't alias back into the audible range.
+    The output has a latency of CHIPS_BLEP_TAPS/2 samples and is passed
+    through a DC blocking filter, so chips may report 'off-center' levels.
+
     ## zlib/libpng license
 
     Copyright (c) 2018 Andre Weissflog
@@ -75,6 +118,49 @@ typedef struct {
     float volume;
 } chips_audio_desc_t;
 
+// fixed point precision for the input-ticks-per-sample ratio
+#define CHIPS_BLEP_FIXEDPOINT_SCALE (256)
+// number of sub-sample positions of a band-limited step
+#define CHIPS_BLEP_PHASES (32)
+// width of a band-limited step in output samples
+#define CHIPS_BLEP_TAPS (16)
+// length of the pending step ring buffer (power of 2 and >= CHIPS_BLEP_TAPS)
+#define CHIPS_BLEP_BUFLEN (32)
+
+// band-limited step resampler state
+typedef struct {
+    int period;         // input ticks per output sample (fixed point)
+    int counter;        // input ticks until next output sample (fixed point)
+    float level;        // current input level
+    float accum;        // integrated band-limited steps
+    float dc_in;        // DC blocking filter state
+    float dc_out;
+    float sample;       // last output sample
+    uint32_t pos;       // current position in buf
+    float buf[CHIPS_BLEP_BUFLEN];   // pending step deltas
+} chips_blep_t;
+
+// initialize a band-limited step resampler
+void chips_blep_init(chips_blep_t* blep, int tick_hz, int sound_hz);
+// reset the resampler to silence
+void chips_blep_reset(chips_blep_t* blep);
+// set the input level at the current tick
+void chips_blep_set(chips_blep_t* blep, float level);
+// generate the next output sample (called from chips_blep_tick())
+void chips_blep_sample(chips_blep_t* blep);
+// advance by one input tick, return true when a new sample is ready
+static inline bool chips_blep_tick(chips_blep_t* blep) {
+    blep->counter -= CHIPS_BLEP_FIXEDPOINT_SCALE;
+    if (blep->counter <= 0) {
+        blep->counter += blep->period;
+        chips_blep_sample(blep);
+        return true;
+    }
+    return false;
+}
+// advance by up to num_ticks input ticks and write the new samples into a buffer
+uint32_t chips_blep_run(chips_blep_t* blep, uint32_t num_ticks, float* samples, int max_samples, int* num_samples);
+
 // prepare chips_audio_t snapshot for saving
 void chips_audio_callback_snapshot_onsave(chips_audio_callback_t* snapshot);
 // fixup chips_audio_t snapshot after loading
@@ -90,6 +176,11 @@ void chips_debug_snapshot_onload(chips_debug_t* snapshot, chips_debug_t* sys);
 
 /*--- IMPLEMENTATION ---------------------------------------------------------*/
 #ifdef CHIPS_IMPL
+#include <string.h>
+#ifndef CHIPS_ASSERT
+    #include <assert.h>
+    #define CHIPS_ASSERT(c) assert(c)
+#endif
 
 void chips_audio_callback_snapshot_onsave(chips_audio_callback_t* snapshot) {
     snapshot->func = 0;
@@ -113,4 +204,133 @@ void chips_debug_snapshot_onload(chips_debug_t* snapshot, chips_debug_t* sys) {
     snapshot->stopped = sys->stopped;
 }
 
+/*
+    The band-limited step table, one row of CHIPS_BLEP_TAPS impulse values
+    per sub-sample phase. Each value is the integral of a Blackman-windowed
+    sinc (cutoff at 0.45 of the sample rate) over one output sample period,
+    normalized so that each row sums to 1.0, the running sum over a row is
+    the band-limited step response.
+
+    The table is precomputed to avoid a libm dependency and the init cost
+    on small targets, it was generated with:
+
+    ~~~python
+    import math
+    def impulse(t):
+        if abs(t) >= 8: return 0.0
+        x = 2 * math.pi * 0.45 * t
+        sinc = 1.0 if x == 0 else math.sin(x) / x
+        w = 0.42 + 0.5 * math.cos(math.pi * t / 8) + 0.08 * math.cos(2 * math.pi * t / 8)
+        return 0.9 * sinc * w
+    for p in range(32):
+        dist = 1.0 - (p + 0.5) / 32
+        row = [sum(impulse(i + dist - 9 + (j + 0.5) / 64) for j in range(64)) / 64 for i in range(16)]
+        print([v / sum(row) for v in row])
+    ~~~
+*/
+static const float _chips_blep_table[CHIPS_BLEP_PHASES][CHIPS_BLEP_TAPS] = {
+    { 0.00017331f, -0.00099006f, 0.00189683f, -0.00050461f, -0.00871525f, 0.03585491f, -0.10582215f, 0.56404464f, 0.58928313f, -0.10067440f, 0.03210535f, -0.00642313f, -0.00165096f, 0.00234389f, -0.00111162f, 0.00019012f },
+    { 0.00015671f, -0.00087044f, 0.00146332f, 0.00058385f, -0.01082836f, 0.03914176f, -0.10977391f, 0.53797824f, 0.61357833f, -0.09429496f, 0.02790260f, -0.00396310f, -0.00284816f, 0.00280115f, -0.00123395f, 0.00020692f },
+    { 0.00014052f, -0.00075382f, 0.00104637f, 0.00160823f, -0.01275335f, 0.04196047f, -0.11257095f, 0.51120199f, 0.63681820f, -0.08665412f, 0.02326042f, -0.00134828f, -0.00408828f, 0.00326493f, -0.00135579f, 0.00022346f },
+    { 0.00012491f, -0.00064113f, 0.00064865f, 0.00256323f, -0.01448312f, 0.04430961f, -0.11425976f, 0.48383591f, 0.65889475f, -0.07772853f, 0.01819688f, 0.00140622f, -0.00536260f, 0.00373127f, -0.00147574f, 0.00023946f },
+    { 0.00011004f, -0.00053318f, 0.00027249f, 0.00344443f, -0.01601255f, 0.04619155f, -0.11489157f, 0.45600132f, 0.67970467f, -0.06750152f, 0.01273438f, 0.00428335f, -0.00666158f, 0.00419590f, -0.00159233f, 0.00025460f },
+    { 0.00009603f, -0.00043066f, -0.00008015f, 0.00424831f, -0.01733841f, 0.04761231f, -0.11452187f, 0.42782011f, 0.69914995f, -0.05596335f, 0.00689972f, 0.00726417f, -0.00797498f, 0.00465429f, -0.00170401f, 0.00026854f },
+    { 0.00008295f, -0.00033416f, -0.00040765f, 0.00497219f, -0.01845936f, 0.04858135f, -0.11320998f, 0.39941405f, 0.71713850f, -0.04311152f, 0.00072403f, 0.01032794f, -0.00929183f, 0.00510171f, -0.00180912f, 0.00028090f },
+    { 0.00007089f, -0.00024413f, -0.00070872f, 0.00561427f, -0.01937585f, 0.04911133f, -0.11101851f, 0.37090405f, 0.73358468f, -0.02895091f, -0.00575724f, 0.01345221f, -0.01060059f, 0.00553319f, -0.00190598f, 0.00029129f },
+    { 0.00005988f, -0.00016093f, -0.00098241f, 0.00617354f, -0.02009003f, 0.04921789f, -0.10801288f, 0.34240957f, 0.74840988f, -0.01349394f, -0.01250443f, 0.01661294f, -0.01188915f, 0.00594363f, -0.00199282f, 0.00029927f },
+    { 0.00004995f, -0.00008479f, -0.00122811f, 0.00664979f, -0.02060566f, 0.04891939f, -0.10426081f, 0.31404785f, 0.76154292f, 0.00323926f, -0.01947376f, 0.01978461f, -0.01314497f, 0.00632782f, -0.00206788f, 0.00030439f },
+    { 0.00004109f, -0.00001585f, -0.00144550f, 0.00704356f, -0.02092799f, 0.04823663f, -0.09983181f, 0.28593334f, 0.77292056f, 0.02122086f, -0.02661751f, 0.02294044f, -0.01435512f, 0.00668044f, -0.00212936f, 0.00030622f },
+    { 0.00003329f, 0.00004584f, -0.00163455f, 0.00735607f, -0.02106367f, 0.04719261f, -0.09479665f, 0.25817707f, 0.78248786f, 0.04041530f, -0.03388420f, 0.02605248f, -0.01550642f, 0.00699618f, -0.00217548f, 0.00030427f },
+    { 0.00002650f, 0.00010032f, -0.00179552f, 0.00758922f, -0.02102063f, 0.04581223f, -0.08922688f, 0.23088603f, 0.79019852f, 0.06077931f, -0.04121879f, 0.02909188f, -0.01658554f, 0.00726973f, -0.00220447f, 0.00029810f },
+    { 0.00002068f, 0.00014771f, -0.00192890f, 0.00774550f, -0.02080792f, 0.04412202f, -0.08319433f, 0.20416264f, 0.79601515f, 0.08226203f, -0.04856297f, 0.03202902f, -0.01757911f, 0.00749588f, -0.00221462f, 0.00028722f },
+    { 0.00001578f, 0.00018821f, -0.00203543f, 0.00782794f, -0.02043561f, 0.04214984f, -0.07677062f, 0.17810423f, 0.79990953f, 0.10480512f, -0.05585544f, 0.03483380f, -0.01847383f, 0.00766955f, -0.00220428f, 0.00027121f },
+    { 0.00001171f, 0.00022208f, -0.00211606f, 0.00784007f, -0.01991463f, 0.03992459f, -0.07002671f, 0.15280258f, 0.80186278f, 0.12834301f, -0.06303220f, 0.03747584f, -0.01925661f, 0.00778583f, -0.00217191f, 0.00024962f },
+    { 0.00000841f, 0.00024962f, -0.00217192f, 0.00778586f, -0.01925667f, 0.03747597f, -0.06303241f, 0.12834343f, 0.80186542f, 0.15280308f, -0.07002694f, 0.03992472f, -0.01991469f, 0.00784010f, -0.00211607f, 0.00022208f },
+    { 0.00000579f, 0.00027121f, -0.00220431f, 0.00766962f, -0.01847401f, 0.03483415f, -0.05585600f, 0.10480617f, 0.79991752f, 0.17810601f, -0.07677139f, 0.04215026f, -0.02043581f, 0.00782802f, -0.00203545f, 0.00018821f },
+    { 0.00000377f, 0.00028723f, -0.00221466f, 0.00749601f, -0.01757941f, 0.03202956f, -0.04856379f, 0.08226342f, 0.79602861f, 0.20416609f, -0.08319574f, 0.04412277f, -0.02080827f, 0.00774563f, -0.00192893f, 0.00014771f },
+    { 0.00000226f, 0.00029810f, -0.00220452f, 0.00726991f, -0.01658595f, 0.02909258f, -0.04121979f, 0.06078079f, 0.79021767f, 0.23089162f, -0.08922904f, 0.04581334f, -0.02102114f, 0.00758940f, -0.00179556f, 0.00010032f },
+    { 0.00000119f, 0.00030428f, -0.00217555f, 0.00699640f, -0.01550692f, 0.02605332f, -0.03388528f, 0.04041660f, 0.78251298f, 0.25818536f, -0.09479969f, 0.04719412f, -0.02106435f, 0.00735631f, -0.00163461f, 0.00004584f },
+    { 0.00000046f, 0.00030623f, -0.00212945f, 0.00668071f, -0.01435570f, 0.02294137f, -0.02661859f, 0.02122172f, 0.77295197f, 0.28594496f, -0.09983586f, 0.04823859f, -0.02092884f, 0.00704384f, -0.00144556f, -0.00001585f },
+    { 0.00000001f, 0.00030441f, -0.00206799f, 0.00632813f, -0.01314563f, 0.01978560f, -0.01947473f, 0.00323942f, 0.76158095f, 0.31406353f, -0.10426602f, 0.04892183f, -0.02060669f, 0.00665013f, -0.00122818f, -0.00008479f },
+    { -0.00000022f, 0.00029928f, -0.00199294f, 0.00594399f, -0.01188987f, 0.01661394f, -0.01250518f, -0.01349476f, 0.74845487f, 0.34243015f, -0.10801937f, 0.04922085f, -0.02009124f, 0.00617391f, -0.00098247f, -0.00016094f },
+    { -0.00000031f, 0.00029131f, -0.00190611f, 0.00553358f, -0.01060134f, 0.01345317f, -0.00575765f, -0.02895297f, 0.73363692f, 0.37093047f, -0.11102641f, 0.04911483f, -0.01937723f, 0.00561467f, -0.00070877f, -0.00024415f },
+    { -0.00000031f, 0.00028093f, -0.00180927f, 0.00510213f, -0.00929260f, 0.01032880f, 0.00072409f, -0.04311511f, 0.71719821f, 0.39944730f, -0.11321940f, 0.04858540f, -0.01846090f, 0.00497261f, -0.00040768f, -0.00033419f },
+    { -0.00000025f, 0.00026857f, -0.00170417f, 0.00465474f, -0.00797574f, 0.00726487f, 0.00690038f, -0.05596874f, 0.69921726f, 0.42786130f, -0.11453290f, 0.04761689f, -0.01734008f, 0.00424872f, -0.00008016f, -0.00043070f },
+    { -0.00000017f, 0.00025463f, -0.00159251f, 0.00419636f, -0.00666232f, 0.00428382f, 0.01273578f, -0.06750896f, 0.67977959f, 0.45605158f, -0.11490423f, 0.04619664f, -0.01601431f, 0.00344481f, 0.00027252f, -0.00053324f },
+    { -0.00000009f, 0.00023949f, -0.00147592f, 0.00373174f, -0.00536327f, 0.00140639f, 0.01819915f, -0.07773825f, 0.65897713f, 0.48389640f, -0.11427405f, 0.04431515f, -0.01448494f, 0.00256355f, 0.00064874f, -0.00064121f },
+    { -0.00000004f, 0.00022349f, -0.00135598f, 0.00326539f, -0.00408886f, -0.00134847f, 0.02326369f, -0.08666630f, 0.63690772f, 0.51127385f, -0.11258677f, 0.04196637f, -0.01275514f, 0.00160846f, 0.00104652f, -0.00075393f },
+    { -0.00000001f, 0.00020695f, -0.00123415f, 0.00280159f, -0.00284861f, -0.00396372f, 0.02790697f, -0.09430974f, 0.61367450f, 0.53806257f, -0.10979111f, 0.03914790f, -0.01083006f, 0.00058394f, 0.00146355f, -0.00087058f },
+    { 0.00000000f, 0.00019016f, -0.00111181f, 0.00234429f, -0.00165125f, -0.00642424f, 0.03211091f, -0.10069185f, 0.58938528f, 0.56414241f, -0.10584050f, 0.03586113f, -0.00871676f, -0.00050469f, 0.00189716f, -0.00099023f },
+};
+
+void chips_blep_init(chips_blep_t* blep, int tick_hz, int sound_hz) {
+    CHIPS_ASSERT(blep && (tick_hz > 0) && (sound_hz > 0));
+    CHIPS_ASSERT(tick_hz >= sound_hz);
+    memset(blep, 0, sizeof(*blep));
+    blep->period = (int)(((int64_t)tick_hz * CHIPS_BLEP_FIXEDPOINT_SCALE) / sound_hz);
+    blep->counter = blep->period;
+}
+
+void chips_blep_reset(chips_blep_t* blep) {
+    CHIPS_ASSERT(blep);
+    const int period = blep->period;
+    memset(blep, 0, sizeof(*blep));
+    blep->period = period;
+    blep->counter = period;
+}
+
+void chips_blep_set(chips_blep_t* blep, float level) {
+    const float delta = level - blep->level;
+    if (delta != 0.0f) {
+        blep->level = level;
+        // sub-sample position of the step since the last output sample
+        const int64_t elapsed = blep->period - blep->counter;
+        int phase = (int)((elapsed * CHIPS_BLEP_PHASES) / blep->period);
+        if (phase < 0) {
+            phase = 0;
+        }
+        else if (phase >= CHIPS_BLEP_PHASES) {
+            phase = CHIPS_BLEP_PHASES - 1;
+        }
+        const float* row = _chips_blep_table[phase];
+        for (uint32_t i = 0; i < CHIPS_BLEP_TAPS; i++) {
+            blep->buf[(blep->pos + i) & (CHIPS_BLEP_BUFLEN-1)] += delta * row[i];
+        }
+    }
+}
+
+void chips_blep_sample(chips_blep_t* blep) {
+    blep->accum += blep->buf[blep->pos];
+    blep->buf[blep->pos] = 0.0f;
+    blep->pos = (blep->pos + 1) & (CHIPS_BLEP_BUFLEN-1);
+    // DC blocking filter, moves an 'off-center' signal back to the zero line
+    blep->dc_out = blep->accum - blep->dc_in + 0.995f * blep->dc_out;
+    blep->dc_in = blep->accum;
+    blep->sample = blep->dc_out;
+}
+
+uint32_t chips_blep_run(chips_blep_t* blep, uint32_t num_ticks, float* samples, int max_samples, int* num_samples) {
+    CHIPS_ASSERT(blep && num_samples && ((max_samples == 0) || samples));
+    uint32_t ticks = 0;
+    int n = 0;
+    while ((ticks < num_ticks) && (n < max_samples)) {
+        // skip ahead to the next output sample, or to the end
+        const int64_t remaining = (int64_t)(num_ticks - ticks) * CHIPS_BLEP_FIXEDPOINT_SCALE;
+        if (remaining < blep->counter) {
+            blep->counter -= (int)remaining;
+            ticks = num_ticks;
+        }
+        else {
+            const uint32_t skip = (uint32_t)((blep->counter + CHIPS_BLEP_FIXEDPOINT_SCALE - 1) / CHIPS_BLEP_FIXEDPOINT_SCALE);
+            blep->counter -= skip * CHIPS_BLEP_FIXEDPOINT_SCALE;
+            blep->counter += blep->period;
+            chips_blep_sample(blep);
+            samples[n++] = blep->sample;
+            ticks += skip;
+        }
+    }
+    *num_samples = n;
+    return ticks;
+}
+
 #endif // CHIPS_IMPL
@@ -18,6 +18,25 @@
     ~~~
         your own assert macro (default: assert(c))
 
+    ## Disc Images
+
+    The drive doesn't own a copy of the disc image, fdd_insert_disc() only
+    references the caller-owned image data (for instance a memory-mapped
+    file), which must remain valid until the disc is ejected. Inserting a
+    disc only sets up the track and sector index, the image data is read
+    in place.
+
+    Written sectors are copied into a copy-on-write overlay of up to
+    FDD_MAX_OVERLAY_SECTORS sectors inside fdd_t, the image data is never
+    written by the drive. Call fdd_flush_disc() to write the changed
+    sectors back into a writable image with the same layout.
+
+    Snapshots contain the track and sector index and the overlay, but not
+    the image data. An identity hash of the image data is computed when
+    the disc is inserted, fdd_snapshot_onload() only accepts the inserted
+    disc as the snapshot's disc if the size and identity hash match,
+    otherwise the disc is ejected.
+
     FIXME: DOCS
 
     ## zlib/libpng license
@@ -51,12 +70,14 @@ extern "C" {
 #define FDD_MAX_SECTOR_SIZE (512)   /* max size of a sector in bytes */
 #define FDD_MAX_TRACK_SIZE (FDD_MAX_SECTORS*FDD_MAX_SECTOR_SIZE)
 #define FDD_MAX_DISC_SIZE (FDD_MAX_SIDES*FDD_MAX_TRACKS*FDD_MAX_TRACK_SIZE)
+#define FDD_MAX_OVERLAY_SECTORS (32)    /* max number of written sectors in the copy-on-write overlay */
 
 // result bits (compatible with UPD765_RESULT_*)
 #define FDD_RESULT_SUCCESS (0)
 #define FDD_RESULT_NOT_READY (1<<0)
 #define FDD_RESULT_NOT_FOUND (1<<1)
 #define FDD_RESULT_END_OF_SECTOR (1<<2)
+#define FDD_RESULT_NOT_WRITABLE (1<<3)
 
 // UPD765 disc controller overlay of the sector info bytes
 typedef struct {
@@ -76,6 +97,7 @@ typedef struct {
     } info;
     int data_offset;    // start of sector data in disc data blob
     int data_size;      // size in bytes of sector data drive data buffer
+    int overlay;        // 1-based index of the written sector copy in fdd_t.overlay, 0 if unchanged
 } fdd_sector_t;
 
 // a track description
@@ -95,6 +117,13 @@ typedef struct {
     fdd_track_t tracks[FDD_MAX_SIDES][FDD_MAX_TRACKS];
 } fdd_disc_t;
 
+// a written sector in the copy-on-write overlay
+typedef struct {
+    int data_offset;    // offset of the sector data in the disc data blob
+    int data_size;
+    uint8_t data[FDD_MAX_SECTOR_SIZE];
+} fdd_overlay_sector_t;
+
 // a floppy disc drive description
 typedef struct {
     int cur_side;
@@ -104,15 +133,18 @@ typedef struct {
     bool has_disc;
     bool motor_on;
     fdd_disc_t disc;
+    const uint8_t* data;    // the disc data blob, owned by the caller
     int data_size;
-    uint8_t data[FDD_MAX_DISC_SIZE];
+    uint32_t data_id;       // identity hash of the disc data, checked in fdd_snapshot_onload()
+    int num_overlay_sectors;
+    fdd_overlay_sector_t overlay[FDD_MAX_OVERLAY_SECTORS];
 } fdd_t;
 
 // initialize a floppy disc drive
 void fdd_init(fdd_t* fdd);
 // drive motor on/off
 void fdd_motor(fdd_t* fdd, bool on);
-// insert a disc, the disc structure and data will be copied
+// insert a disc, the disc structure will be copied, the data must remain valid until the disc is ejected
 bool fdd_insert_disc(fdd_t* fdd, const fdd_disc_t* disc, const uint8_t* data, int data_size);
 // eject current disc
 void fdd_eject_disc(fdd_t* fdd);
@@ -125,6 +157,18 @@ int fdd_seek_track(fdd_t* fdd, int track);
 int fdd_seek_sector(fdd_t* fdd, int side, uint8_t c, uint8_t h, uint8_t r, uint8_t n);
 // read the next byte from the seeked-to sector, return FDD_RESULT_*
 int fdd_read(fdd_t* fdd, int side, uint8_t* out_data);
+// get the data of the whole seeked-to sector, return FDD_RESULT_*
+int fdd_read_sector(fdd_t* fdd, int side, const uint8_t** out_data, int* out_size);
+// get a pointer to the current data of a sector (from the overlay if the sector was written)
+const uint8_t* fdd_sector_data(const fdd_t* fdd, const fdd_sector_t* sector);
+// write the next byte to the seeked-to sector (into the overlay), return FDD_RESULT_*
+int fdd_write(fdd_t* fdd, int side, uint8_t data);
+// write the overlay sectors into a disc image with the same layout, returns number of written sectors
+int fdd_flush_disc(fdd_t* fdd, uint8_t* dst, int dst_size);
+// prepare fdd_t snapshot for saving
+void fdd_snapshot_onsave(fdd_t* snapshot);
+// fixup fdd_t snapshot after loading, ejects the disc if a different disc image is inserted
+void fdd_snapshot_onload(fdd_t* snapshot, fdd_t* sys);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -157,7 +201,19 @@ void fdd_eject_disc(fdd_t* fdd) {
     fdd->has_disc = false;
     fdd->motor_on = false;
     memset(&fdd->disc, 0, sizeof(fdd->disc));
-    memset(&fdd->data, 0, sizeof(fdd->data));
+    fdd->data = 0;
+    fdd->data_size = 0;
+    fdd->data_id = 0;
+    fdd->num_overlay_sectors = 0;
+}
+
+/* identity hash of disc data (FNV-1a, same as mem_rom_id()) */
+static uint32_t _fdd_data_id(const uint8_t* ptr, int size) {
+    uint32_t hash = 0x811C9DC5;
+    for (int i = 0; i < size; i++) {
+        hash = (hash ^ ptr[i]) * 0x01000193;
+    }
+    return hash;
 }
 
 bool fdd_disc_inserted(fdd_t* fdd) {
@@ -165,7 +221,7 @@ bool fdd_disc_inserted(fdd_t* fdd) {
     return fdd->has_disc;
 }
 
-bool _fdd_validate_disc(const fdd_disc_t* disc) {
+bool _fdd_validate_disc(const fdd_disc_t* disc, int data_size) {
     CHIPS_ASSERT(disc);
     if ((disc->num_sides < 0) || (disc->num_sides > FDD_MAX_SIDES)) {
         return false;
@@ -182,7 +238,7 @@ bool _fdd_validate_disc(const fdd_disc_t* disc) {
             if ((track->data_size < 0) || (track->data_size > FDD_MAX_TRACK_SIZE)) {
                 return false;
             }
-            if ((track->data_offset + track->data_size) > FDD_MAX_DISC_SIZE) {
+            if ((track->data_offset + track->data_size) > data_size) {
                 return false;
             }
             if ((track->num_sectors < 0) || (track->num_sectors > FDD_MAX_SECTORS)) {
@@ -196,7 +252,10 @@ bool _fdd_validate_disc(const fdd_disc_t* disc) {
                 if ((sector->data_size < 0) || (sector->data_size > FDD_MAX_SECTOR_SIZE)) {
                     return false;
                 }
-                if ((sector->data_offset + sector->data_size) > FDD_MAX_DISC_SIZE) {
+                if ((sector->data_offset + sector->data_size) > data_size) {
+                    return false;
+                }
+                if (sector->overlay != 0) {
                     return false;
                 }
             }
@@ -210,7 +269,11 @@ bool fdd_insert_disc(fdd_t* fdd, const fdd_disc_t* disc, const uint8_t* data, in
     if (fdd->has_disc) {
         fdd_eject_disc(fdd);
     }
-    if (_fdd_validate_disc(disc)) {
+    if (data && ((data_size <= 0) || (data_size > FDD_MAX_DISC_SIZE))) {
+        /* invalid data size */
+        return false;
+    }
+    if (_fdd_validate_disc(disc, data ? data_size : FDD_MAX_DISC_SIZE)) {
         fdd->disc = *disc;
     }
     else {
@@ -218,15 +281,10 @@ bool fdd_insert_disc(fdd_t* fdd, const fdd_disc_t* disc, const uint8_t* data, in
         return false;
     }
     if (data) {
-        if ((data_size > 0) && (data_size <= FDD_MAX_DISC_SIZE)) {
-            fdd->data_size = data_size;
-            memcpy(&fdd->data, data, data_size);
-            fdd->disc.formatted = true;
-        }
-        else {
-            /* invalid data size */
-            return false;
-        }
+        fdd->data = data;
+        fdd->data_size = data_size;
+        fdd->data_id = _fdd_data_id(data, data_size);
+        fdd->disc.formatted = true;
     }
     else {
         fdd->disc.formatted = false;
@@ -276,8 +334,7 @@ int fdd_read(fdd_t* fdd, int side, uint8_t* out_data) {
         fdd->cur_side = side;
         const fdd_sector_t* sector = &fdd->disc.tracks[side][fdd->cur_track_index].sectors[fdd->cur_sector_index];
         if (fdd->cur_sector_pos < sector->data_size) {
-            const int data_offset = sector->data_offset + fdd->cur_sector_pos;
-            *out_data = fdd->data[data_offset];
+            *out_data = fdd_sector_data(fdd, sector)[fdd->cur_sector_pos];
             fdd->cur_sector_pos++;
             if (fdd->cur_sector_pos < sector->data_size) {
                 return FDD_RESULT_SUCCESS;
@@ -292,4 +349,107 @@ int fdd_read(fdd_t* fdd, int side, uint8_t* out_data) {
     return FDD_RESULT_NOT_READY;
 }
 
+const uint8_t* fdd_sector_data(const fdd_t* fdd, const fdd_sector_t* sector) {
+    CHIPS_ASSERT(fdd && sector && fdd->has_disc);
+    if (sector->overlay) {
+        return fdd->overlay[sector->overlay - 1].data;
+    }
+    else {
+        return &fdd->data[sector->data_offset];
+    }
+}
+
+int fdd_read_sector(fdd_t* fdd, int side, const uint8_t** out_data, int* out_size) {
+    CHIPS_ASSERT(fdd && (side >= 0) && (side < FDD_MAX_SIDES) && out_data && out_size);
+    if (fdd->has_disc & fdd->motor_on) {
+        fdd->cur_side = side;
+        const fdd_sector_t* sector = &fdd->disc.tracks[side][fdd->cur_track_index].sectors[fdd->cur_sector_index];
+        if (sector->data_size > 0) {
+            *out_data = fdd_sector_data(fdd, sector);
+            *out_size = sector->data_size;
+            return FDD_RESULT_SUCCESS;
+        }
+        return FDD_RESULT_NOT_FOUND;
+    }
+    return FDD_RESULT_NOT_READY;
+}
+
+int fdd_write(fdd_t* fdd, int side, uint8_t data) {
+    CHIPS_ASSERT(fdd && (side >= 0) && (side < FDD_MAX_SIDES));
+    if (fdd->has_disc & fdd->motor_on) {
+        if (fdd->disc.write_protected) {
+            return FDD_RESULT_NOT_WRITABLE;
+        }
+        fdd->cur_side = side;
+        fdd_sector_t* sector = &fdd->disc.tracks[side][fdd->cur_track_index].sectors[fdd->cur_sector_index];
+        if (fdd->cur_sector_pos < sector->data_size) {
+            if (0 == sector->overlay) {
+                // first write to this sector, copy the sector into the overlay
+                if ((fdd->num_overlay_sectors >= FDD_MAX_OVERLAY_SECTORS) || (sector->data_size > FDD_MAX_SECTOR_SIZE)) {
+                    return FDD_RESULT_NOT_WRITABLE;
+                }
+                fdd_overlay_sector_t* ovl = &fdd->overlay[fdd->num_overlay_sectors++];
+                ovl->data_offset = sector->data_offset;
+                ovl->data_size = sector->data_size;
+                memcpy(ovl->data, &fdd->data[sector->data_offset], sector->data_size);
+                sector->overlay = fdd->num_overlay_sectors;
+            }
+            fdd->overlay[sector->overlay - 1].data[fdd->cur_sector_pos] = data;
+            fdd->cur_sector_pos++;
+            if (fdd->cur_sector_pos < sector->data_size) {
+                return FDD_RESULT_SUCCESS;
+            }
+            else {
+                return FDD_RESULT_END_OF_SECTOR;
+            }
+        }
+        return FDD_RESULT_NOT_FOUND;
+    }
+    return FDD_RESULT_NOT_READY;
+}
+
+int fdd_flush_disc(fdd_t* fdd, uint8_t* dst, int dst_size) {
+    CHIPS_ASSERT(fdd && dst);
+    if (!fdd->has_disc || (dst_size != fdd->data_size)) {
+        return 0;
+    }
+    const int num_sectors = fdd->num_overlay_sectors;
+    for (int i = 0; i < num_sectors; i++) {
+        const fdd_overlay_sector_t* ovl = &fdd->overlay[i];
+        memcpy(&dst[ovl->data_offset], ovl->data, ovl->data_size);
+    }
+    if (dst == fdd->data) {
+        // the inserted image now contains the written sectors, drop the overlay
+        for (int side = 0; side < fdd->disc.num_sides; side++) {
+            for (int track = 0; track < fdd->disc.num_tracks; track++) {
+                fdd_track_t* trk = &fdd->disc.tracks[side][track];
+                for (int si = 0; si < trk->num_sectors; si++) {
+                    trk->sectors[si].overlay = 0;
+                }
+            }
+        }
+        fdd->num_overlay_sectors = 0;
+        fdd->data_id = _fdd_data_id(fdd->data, fdd->data_size);
+    }
+    return num_sectors;
+}
+
+void fdd_snapshot_onsave(fdd_t* snapshot) {
+    CHIPS_ASSERT(snapshot);
+    snapshot->data = 0;
+}
+
+void fdd_snapshot_onload(fdd_t* snapshot, fdd_t* sys) {
+    CHIPS_ASSERT(snapshot && sys);
+    if (snapshot->has_disc) {
+        // the snapshot only contains the disc index and written sectors, not the disc image
+        if (sys->has_disc && (sys->data_size == snapshot->data_size) && (sys->data_id == snapshot->data_id)) {
+            snapshot->data = sys->data;
+        }
+        else {
+            fdd_eject_disc(snapshot);
+        }
+    }
+}
+
 #endif /* CHIPS_IMPL */
@@ -11,13 +11,19 @@
     ## Functions
 
     ~~~C
-    bool fdd_cpc_insert_dsk(fdd_t* fdd, const uint8_t* data, int data_size)
+    bool fdd_cpc_insert_dsk(fdd_t* fdd, chips_range_t data)
     ~~~
-        'Inserts' a CPC .dsk disk image into the floppy drive.
+        'Inserts' a CPC .dsk or extended .dsk disk image into the floppy
+        drive, returns false if the image is malformed or uses features
+        which fdd_t can't represent (for instance sectors bigger than
+        FDD_MAX_SECTOR_SIZE).
 
         fdd         - pointer to an initialized fdd_t instance
-        data        - pointer to the .dsk image data in memory
-        data_size   - size in bytes of the image data
+        data        - pointer and size of the .dsk image data in memory
+
+        The image data isn't copied but parsed in place, it is owned by the
+        caller and must remain valid until the disc is ejected (see
+        'Disc Images' in fdd.h).
 
     ## zlib/libpng license
 
@@ -41,7 +47,7 @@
 extern "C" {
 #endif
 
-/* load Amstrad CPC .dsk file format */
+/* load Amstrad CPC .dsk file format, the data is parsed in place and must remain valid until the disc is ejected */
 bool fdd_cpc_insert_dsk(fdd_t* fdd, chips_range_t data);
 
 #ifdef __cplusplus
@@ -88,10 +94,11 @@ typedef struct {
     uint8_t ext[2];         /* in extended disk format, actual sector data size in bytes */
 } _fdd_cpc_dsk_sector_info;
 
-/* parse a standard .dsk image */
+/* parse a standard .dsk image in place into the drive's track and sector index */
 static bool _fdd_cpc_parse_dsk(fdd_t* fdd, bool ext, chips_range_t data) {
     CHIPS_ASSERT(fdd);
-    const _fdd_cpc_dsk_header* hdr = (_fdd_cpc_dsk_header*)data.ptr;
+    const uint8_t* ptr = (const uint8_t*) data.ptr;
+    const _fdd_cpc_dsk_header* hdr = (const _fdd_cpc_dsk_header*)ptr;
     if (hdr->num_sides > 2) {
         return false;
     }
@@ -99,11 +106,6 @@ static bool _fdd_cpc_parse_dsk(fdd_t* fdd, bool ext, chips_range_t data) {
         return false;
     }
 
-    /* copy the data blob to the local buffer */
-    CHIPS_ASSERT(data.size <= FDD_MAX_DISC_SIZE);
-    fdd->data_size = data.size;
-    memcpy(fdd->data, data.ptr, fdd->data_size);
-
     /* setup the disc structure */
     fdd_disc_t* disc = &fdd->disc;
     disc->formatted = true;
@@ -122,11 +124,15 @@ static bool _fdd_cpc_parse_dsk(fdd_t* fdd, bool ext, chips_range_t data) {
                 track_size = (hdr->track_size_h<<8) | hdr->track_size_l;
             }
             if (track_size > 0) {
-                const _fdd_cpc_dsk_track_info* track_info = (const _fdd_cpc_dsk_track_info*) &fdd->data[data_offset];
+                /* the track must fit into the image, and has a 256 byte track info header */
+                if ((track_size < 0x100) || ((data_offset + track_size) > data.size)) {
+                    return false;
+                }
+                const _fdd_cpc_dsk_track_info* track_info = (const _fdd_cpc_dsk_track_info*) &ptr[data_offset];
                 if (0 != memcmp("Track-Info", track_info->magic, 10)) {
                     return false;
                 }
-                if ((data_offset + track_size) > data.size) {
+                if (track_info->num_sectors > FDD_MAX_SECTORS) {
                     return false;
                 }
                 track->data_offset = data_offset;
@@ -142,7 +148,11 @@ static bool _fdd_cpc_parse_dsk(fdd_t* fdd, bool ext, chips_range_t data) {
                         sector_size = (sector_info->ext[1]<<8) | sector_info->ext[0];
                     }
                     else {
-                        sector_size = 0x80 << track_info->sector_size;
+                        sector_size = (track_info->sector_size < 8) ? (0x80 << track_info->sector_size) : 0x8000;
+                    }
+                    /* the sector data must fit into the track */
+                    if ((sector_size > FDD_MAX_SECTOR_SIZE) || ((sector_data_offset + sector_size) > (data_offset + track_size))) {
+                        return false;
                     }
                     sector->info.upd765.c = sector_info->track;
                     sector->info.upd765.h = sector_info->side;
@@ -152,10 +162,10 @@ static bool _fdd_cpc_parse_dsk(fdd_t* fdd, bool ext, chips_range_t data) {
                     sector->info.upd765.st2 = sector_info->st2;
                     sector->data_offset = sector_data_offset;
                     sector->data_size = sector_size;
+                    sector->overlay = 0;
                     sector_data_offset += sector_size;
                 }
                 data_offset += track_size;
-                CHIPS_ASSERT(data_offset == sector_data_offset);
             }
             else {
                 /* unformatted / non-existing track */
@@ -165,6 +175,9 @@ static bool _fdd_cpc_parse_dsk(fdd_t* fdd, bool ext, chips_range_t data) {
             }
         }
     }
+    fdd->data = ptr;
+    fdd->data_size = data.size;
+    fdd->data_id = _fdd_data_id(ptr, data.size);
     fdd->has_disc = true;
     return true;
 }
@@ -86,6 +86,29 @@
     m6522_reset(&sys->via);
     ~~~
 
+    ## Fast-forwarding
+
+    When the VIA isn't accessed by the CPU and its input pins don't change,
+    most ticks don't do anything except decrementing the timer counters.
+    Call m6522_cycles_until_event() with the input pin mask of the next
+    tick to get the number of ticks until something might happen (a timer
+    underflow, or a change of the IRQ pin or port output pins), the event
+    happens at the earliest in the returned tick (so a return value of 1
+    means that the very next tick can't be skipped):
+
+    ~~~C
+    uint32_t n = m6522_cycles_until_event(&sys->via, pins);
+    ~~~
+
+    m6522_advance() runs a number of ticks with the same input pin mask
+    (which must not select the chip), the result is identical with calling
+    m6522_tick() num_ticks times, but ticks up to the next event are
+    fast-forwarded:
+
+    ~~~C
+    pins = m6522_advance(&sys->via, pins, n - 1);
+    ~~~
+
     ## LINKS
 
     On timer behaviour when hitting zero:
@@ -352,6 +375,10 @@ void m6522_init(m6522_t* m6522);
 void m6522_reset(m6522_t* m6522);
 // tick the m6522
 uint64_t m6522_tick(m6522_t* m6522, uint64_t pins);
+// get number of ticks until the next timer underflow, IRQ or port pin change (1 = next tick)
+uint32_t m6522_cycles_until_event(const m6522_t* m6522, uint64_t pins);
+// same as calling m6522_tick() num_ticks times with the same pins (must not select the chip)
+uint64_t m6522_advance(m6522_t* m6522, uint64_t pins, uint32_t num_ticks);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -895,4 +922,122 @@ uint64_t m6522_tick(m6522_t* c, uint64_t pins) {
     return pins;
 }
 
+/* T2 counts PB6 falling edges relative to the previous output pins, or on each tick */
+static inline bool _m6522_t2_counting(const m6522_t* c, uint64_t pins) {
+    if (M6522_ACR_T2_COUNT_PB6(c)) {
+        return 0 != (M6522_PB6 & (~pins & (pins ^ c->pins)));
+    }
+    else {
+        return true;
+    }
+}
+
+/*
+    Returns the number of ticks which only decrement the timer counters
+    when ticked with the same input pins as the previous tick (the 'idle'
+    state). This is the case when:
+
+    - the input pins don't trigger CA1/CA2/CB1/CB2 and don't change
+      the port input registers or output pins
+    - the timer count pipelines are filled, and no T1 reload is pending
+    - the interrupt pipeline has settled
+    - the next timer underflow is at least one tick away
+*/
+static uint32_t _m6522_idle_ticks(const m6522_t* c, uint64_t pins) {
+    /* same tests as _m6522_read_port_pins() */
+    const bool new_ca1 = 0 != (pins & M6522_CA1);
+    const bool new_ca2 = 0 != (pins & M6522_CA2);
+    const bool new_cb1 = 0 != (pins & M6522_CB1);
+    const bool new_cb2 = 0 != (pins & M6522_CB2);
+    if ((c->pa.c1_in != new_ca1) || (c->pa.c2_in != new_cb2) || (c->pb.c1_in != new_cb1) || (c->pb.c2_in != new_cb2)) {
+        return 0;
+    }
+    if ((c->pa.c2_in != new_ca2) && ((new_ca2 && M6522_PCR_CA2_LOW_TO_HIGH(c)) || (!new_ca2 && M6522_PCR_CA2_HIGH_TO_LOW(c)))) {
+        return 0;
+    }
+    if ((!M6522_ACR_PA_LATCH_ENABLE(c) && (c->pa.inpr != M6522_GET_PA(pins))) ||
+        (!M6522_ACR_PB_LATCH_ENABLE(c) && (c->pb.inpr != M6522_GET_PB(pins))))
+    {
+        return 0;
+    }
+
+    /* the output pins must be identical with the previous tick's output pins */
+    const uint8_t pa = (c->pa.inpr & ~c->pa.ddr) | (c->pa.outr & c->pa.ddr);
+    uint8_t pb = (c->pb.inpr & ~c->pb.ddr) | (c->pb.outr & c->pb.ddr);
+    if (M6522_ACR_T1_SET_PB7(c)) {
+        pb = (pb & 0x7F) | (c->t1.t_bit ? 0x80 : 0);
+    }
+    uint64_t out = pins & ~(M6522_IRQ|M6522_CA1|M6522_CA2|M6522_CB1|M6522_CB2);
+    M6522_SET_PAB(out, pa, pb);
+    out |= (c->intr.ifr & 0x80) ? M6522_IRQ : 0;
+    out |= (c->pa.c1_out ? M6522_CA1 : 0) | (c->pa.c2_out ? M6522_CA2 : 0);
+    out |= (c->pb.c1_out ? M6522_CB1 : 0) | (c->pb.c2_out ? M6522_CB2 : 0);
+    if ((out != c->pins) || (pa != c->pa.pins) || (pb != c->pb.pins)) {
+        return 0;
+    }
+
+    /* the interrupt pipeline must have settled */
+    if (c->intr.ifr & c->intr.ier) {
+        if ((c->intr.pip != 0x01) || !(c->intr.ifr & 0x80)) {
+            return 0;
+        }
+    }
+    else if (c->intr.pip != 0) {
+        return 0;
+    }
+
+    /* timer pipelines must be filled, T1 must not have a reload pending */
+    if ((c->t1.pip != 0x0003) || (c->t2.pip != 0x0003)) {
+        return 0;
+    }
+    uint32_t num_ticks = c->t1.counter;
+    /* once T2 has fired, its underflows don't have any side effects */
+    if (!c->t2.t_bit) {
+        if (_m6522_t2_counting(c, pins)) {
+            if (c->t2.counter < num_ticks) {
+                num_ticks = c->t2.counter;
+            }
+        }
+        else if (0xFFFF == c->t2.counter) {
+            return 0;
+        }
+    }
+    return num_ticks;
+}
+
+uint32_t m6522_cycles_until_event(const m6522_t* c, uint64_t pins) {
+    CHIPS_ASSERT(c);
+    if ((pins & (M6522_CS1|M6522_CS2)) == M6522_CS1) {
+        return 1;
+    }
+    return _m6522_idle_ticks(c, pins) + 1;
+}
+
+uint64_t m6522_advance(m6522_t* c, uint64_t pins, uint32_t num_ticks) {
+    CHIPS_ASSERT(c && ((pins & (M6522_CS1|M6522_CS2)) != M6522_CS1));
+    while (num_ticks > 0) {
+        uint32_t idle_ticks = _m6522_idle_ticks(c, pins);
+        if (idle_ticks > 0) {
+            /* only the timer counters change, the output pins stay the same */
+            if (idle_ticks > num_ticks) {
+                idle_ticks = num_ticks;
+            }
+            c->pa.c1_triggered = c->pa.c2_triggered = false;
+            c->pb.c1_triggered = c->pb.c2_triggered = false;
+            c->t1.counter -= idle_ticks;
+            c->t1.t_out = false;
+            if (_m6522_t2_counting(c, pins)) {
+                c->t2.counter -= idle_ticks;
+            }
+            c->t2.t_out = (0xFFFF == c->t2.counter);
+            num_ticks -= idle_ticks;
+        }
+        else {
+            m6522_tick(c, pins);
+            num_ticks--;
+        }
+    }
+    return c->pins;
+}
+
 #endif /* CHIPS_IMPL */
@@ -44,6 +44,28 @@
     - serial port
     - no external counter trigger via CNT pin
 
+    ## Fast-forwarding
+
+    With both timers stopped, or counting down far away from an underflow,
+    and with unchanged port and FLAG inputs, a CIA tick only decrements the
+    timer counters. m6526_cycles_until_event() returns the number of ticks
+    until the next tick which may change the IRQ or port output pins for
+    a given input pin mask (1 means the next tick, UINT32_MAX means that
+    no event is scheduled at all), and m6526_advance() runs a number of
+    ticks with the same input pins (which must not select the chip) with
+    the same result as calling m6526_tick() in a loop:
+
+    ~~~C
+    uint32_t n = m6526_cycles_until_event(&sys->cia, pins);
+    ...
+    pins = m6526_advance(&sys->cia, pins, n - 1);
+    ~~~
+
+    Timer B counting timer A underflows only changes its counter on the
+    ticks where timer A underflows, those are never skipped, so cascaded
+    timers are covered without special handling. The TOD clock isn't
+    emulated, the TOD pin is ignored.
+
     ## LINKS:
     - https://ist.uwaterloo.ca/~schepers/MJK/cia6526.html
     - https://ist.uwaterloo.ca/~schepers/MJK/cia6526.html
@@ -272,6 +294,10 @@ void m6526_init(m6526_t* c);
 void m6526_reset(m6526_t* c);
 // tick the m6526_t instance
 uint64_t m6526_tick(m6526_t* c, uint64_t pins);
+// get number of ticks until the next timer underflow, IRQ or port pin change (1 = next tick)
+uint32_t m6526_cycles_until_event(const m6526_t* c, uint64_t pins);
+// same as calling m6526_tick() num_ticks times with the same pins (must not select the chip)
+uint64_t m6526_advance(m6526_t* c, uint64_t pins, uint32_t num_ticks);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -683,4 +709,144 @@ uint64_t m6526_tick(m6526_t* c, uint64_t pins) {
     return pins;
 }
 
+/*--- fast-forwarding ---*/
+
+/* pins which are outputs of an idle tick */
+#define _M6526_IDLE_OUT_PINS (M6526_IRQ|M6526_PA_PINS|M6526_PB_PINS)
+
+/* output pins of a tick without timer underflow */
+static uint64_t _m6526_idle_out_pins(const m6526_t* c, uint64_t pins) {
+    const uint8_t pa = c->pa.reg | (M6526_GET_PA(pins) & ~c->pa.ddr);
+    uint8_t pb = c->pb.reg | (M6526_GET_PB(pins) & ~c->pb.ddr);
+    /* same as _m6526_merge_pb67() with inactive t_out */
+    if (M6526_PBON(c->ta.cr)) {
+        pb &= ~(1<<6);
+        if (M6526_OUTMODE_TOGGLE(c->ta.cr) && c->ta.t_bit) {
+            pb |= (1<<6);
+        }
+    }
+    if (M6526_PBON(c->tb.cr)) {
+        pb &= ~(1<<7);
+        if (M6526_OUTMODE_TOGGLE(c->tb.cr) && c->tb.t_bit) {
+            pb |= (1<<7);
+        }
+    }
+    M6526_SET_PAB(pins, pa, pb);
+    if (c->intr.icr & (1<<7)) {
+        pins |= M6526_IRQ;
+    }
+    else {
+        pins &= ~M6526_IRQ;
+    }
+    return pins;
+}
+
+/* check if a timer is in its idle state, and clamp the number of idle ticks */
+static bool _m6526_timer_idle(const m6526_timer_t* t, bool phi2_mode, uint32_t* inout_ticks) {
+    if (M6526_FORCE_LOAD(t->cr)) {
+        return false;
+    }
+    const bool counting = phi2_mode && M6526_TIMER_STARTED(t->cr);
+    /* filled counter pipeline, settled oneshot pipeline, no pending load */
+    uint32_t pip = M6526_RUNMODE_ONESHOT(t->cr) ? (1<<M6526_PIP_TIMER_ONESHOT) : 0;
+    if (counting) {
+        pip |= 3<<M6526_PIP_TIMER_COUNT;
+    }
+    if (t->pip != pip) {
+        return false;
+    }
+    if (counting) {
+        /* the counter underflows in the tick where it reaches zero */
+        if (t->counter < 2) {
+            return false;
+        }
+        if ((uint32_t)(t->counter - 1) < *inout_ticks) {
+            *inout_ticks = t->counter - 1;
+        }
+    }
+    return true;
+}
+
+/*
+    Returns the number of following ticks which only decrement the timer
+    counters when ticked with the given input pins: the port inputs and
+    FLAG pin must be unchanged, the output pins must already be stable,
+    the interrupt and timer pipelines must have settled, and no timer may
+    underflow.
+*/
+static uint32_t _m6526_idle_ticks(const m6526_t* c, uint64_t pins) {
+    if ((c->pa.inp != M6526_GET_PA(pins)) || (c->pb.inp != M6526_GET_PB(pins))) {
+        return 0;
+    }
+    if (c->intr.flag != (0 != (pins & M6526_FLAG))) {
+        return 0;
+    }
+    const uint64_t out_pins = _m6526_idle_out_pins(c, pins);
+    if ((M6526_GET_PA(out_pins) != c->pa.pins) || (M6526_GET_PB(out_pins) != c->pb.pins)) {
+        return 0;
+    }
+    if ((out_pins & _M6526_IDLE_OUT_PINS) != (c->pins & _M6526_IDLE_OUT_PINS)) {
+        return 0;
+    }
+    /* an IRQ request must already have been passed through the pipeline,
+       and there must be no pending interrupt mask update or ICR read
+    */
+    if (c->intr.imr != c->intr.imr1) {
+        return 0;
+    }
+    if (c->intr.icr & c->intr.imr) {
+        if ((c->intr.pip != (1<<M6526_PIP_IRQ)) || !(c->intr.icr & (1<<7))) {
+            return 0;
+        }
+    }
+    else if (c->intr.pip != 0) {
+        return 0;
+    }
+    uint32_t num_ticks = UINT32_MAX - 1;
+    if (!_m6526_timer_idle(&c->ta, M6526_TA_INMODE_PHI2(c->ta.cr), &num_ticks)) {
+        return 0;
+    }
+    /* in cascade mode, timer B only counts in ticks where timer A underflows */
+    if (!_m6526_timer_idle(&c->tb, M6526_TB_INMODE_PHI2(c->tb.cr), &num_ticks)) {
+        return 0;
+    }
+    return num_ticks;
+}
+
+uint32_t m6526_cycles_until_event(const m6526_t* c, uint64_t pins) {
+    CHIPS_ASSERT(c);
+    if (pins & M6526_CS) {
+        return 1;
+    }
+    const uint32_t num_ticks = _m6526_idle_ticks(c, pins);
+    return (num_ticks == (UINT32_MAX - 1)) ? UINT32_MAX : (num_ticks + 1);
+}
+
+uint64_t m6526_advance(m6526_t* c, uint64_t pins, uint32_t num_ticks) {
+    CHIPS_ASSERT(c && !(pins & M6526_CS));
+    while (num_ticks > 0) {
+        uint32_t idle_ticks = _m6526_idle_ticks(c, pins);
+        if (idle_ticks > 0) {
+            /* only the counters of running timers change */
+            if (idle_ticks > num_ticks) {
+                idle_ticks = num_ticks;
+            }
+            if (M6526_TA_INMODE_PHI2(c->ta.cr) && M6526_TIMER_STARTED(c->ta.cr)) {
+                c->ta.counter -= idle_ticks;
+            }
+            if (M6526_TB_INMODE_PHI2(c->tb.cr) && M6526_TIMER_STARTED(c->tb.cr)) {
+                c->tb.counter -= idle_ticks;
+            }
+            c->ta.t_out = c->tb.t_out = false;
+            c->pins = _m6526_idle_out_pins(c, pins);
+            num_ticks -= idle_ticks;
+        }
+        else {
+            m6526_tick(c, pins);
+            num_ticks--;
+        }
+    }
+    return c->pins;
+}
+
 #endif /* CHIPS_IMPL */
@@ -11,6 +11,8 @@
     before you include this file in *one* C or C++ file to create the
     implementation.
 
+    You need to include chips/chips_common.h before including m6561.h.
+
     Optionally provide the following macros with your own implementation
     ~~~C
     CHIPS_ASSERT(c)
@@ -113,9 +115,6 @@ extern "C" {
 #define M6561_NUM_REGS (16)
 #define M6561_REG_MASK (M6561_NUM_REGS-1)
 
-// sound DC adjustment buffer length
-#define M6561_DCADJ_BUFLEN (512)
-
 // extract 8-bit data bus from 64-bit pins
 #define M6561_GET_DATA(p) ((uint8_t)(((p)&0xFF0000ULL)>>16))
 // merge 8-bit data bus value into 64-bit pins
@@ -206,15 +205,9 @@ typedef struct {
     m6561_voice_t voice[3];
     m6561_noise_t noise;
     uint8_t volume;
-    int sample_period;
-    int sample_counter;
-    float sample_accum;
-    float sample_accum_count;
     float sample_mag;
     float sample;
-    float dcadj_sum;
-    uint32_t dcadj_pos;
-    float dcadj_buf[M6561_DCADJ_BUFLEN];
+    chips_blep_t blep;      // band-limited resampler, see chips_common.h
 } m6561_sound_t;
 
 // the m6561_t state struct
@@ -272,9 +265,6 @@ void m6561_snapshot_onload(m6561_t* snapshot, m6561_t* sys);
 #define _M6561_HVC_DISABLE (1<<0)
 #define _M6561_VVC_DISABLE (1<<1)
 
-// fixed point precision for audio sample period
-#define _M6561_FIXEDPOINT_SCALE (16)
-
 #define _M6561_RGBA8(r,g,b) (0xFF000000|(b<<16)|(g<<8)|(r))
 
 // see VICE sources under vice/data/vic20/mike-pal.vpl
@@ -318,8 +308,7 @@ void m6561_init(m6561_t* vic, const m6561_desc_t* desc) {
     vic->border.enabled = _M6561_HBORDER|_M6561_VBORDER;
     vic->fetch_cb = desc->fetch_cb;
     vic->user_data = desc->user_data;
-    vic->sound.sample_period = (desc->tick_hz * _M6561_FIXEDPOINT_SCALE) / desc->sound_hz;
-    vic->sound.sample_counter = vic->sound.sample_period;
+    chips_blep_init(&vic->sound.blep, desc->tick_hz, desc->sound_hz);
     vic->sound.sample_mag = desc->sound_magnitude;
     vic->sound.noise.shift = 0x7FFFFC;
 }
@@ -352,6 +341,7 @@ static void _m6561_reset_audio(m6561_t* vic) {
     memset(&vic->sound.noise, 0, sizeof(m6561_noise_t));
     vic->sound.volume = 0;
     vic->sound.noise.shift = 0x7FFFF8;
+    chips_blep_reset(&vic->sound.blep);
 }
 
 void m6561_reset(m6561_t* vic) {
@@ -562,31 +552,36 @@ static inline float _m6561_noise_ampl(uint32_t noise_shift) {
     return ((float)amp) / 256.0f;
 }
 
-/* center positive volume value around zero */
-static inline float _m6561_dcadjust(m6561_sound_t* snd, float s) {
-    snd->dcadj_sum -= snd->dcadj_buf[snd->dcadj_pos];
-    snd->dcadj_sum += s;
-    snd->dcadj_buf[snd->dcadj_pos] = s;
-    snd->dcadj_pos = (snd->dcadj_pos + 1) & (M6561_DCADJ_BUFLEN-1);
-    return s - (snd->dcadj_sum / M6561_DCADJ_BUFLEN);
+/* report the current output level to the resampler */
+static void _m6561_update_level(m6561_t* vic) {
+    m6561_sound_t* snd = &vic->sound;
+    float sm = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        if (snd->voice[i].bit && snd->voice[i].enabled) {
+            sm += 1.0f;
+        }
+    }
+    if (snd->noise.bit && snd->noise.enabled) {
+        sm += _m6561_noise_ampl(snd->noise.shift);
+    }
+    chips_blep_set(&snd->blep, sm * (snd->volume / 15.0f) * snd->sample_mag);
 }
 
 /* tick the audio engine, return true if a new sample if ready */
 static uint64_t _m6561_tick_audio(m6561_t* vic, uint64_t pins) {
     m6561_sound_t* snd = &vic->sound;
+    bool toggled = false;
     /* tick tone voices */
     for (int i = 0; i < 3; i++) {
         m6561_voice_t* voice = &snd->voice[i];
         if (voice->count == 0) {
             voice->count = voice->period;
             voice->bit = !voice->bit;
+            toggled = true;
         }
         else {
             voice->count--;
         }
-        if (voice->bit && voice->enabled) {
-            snd->sample_accum += 1.0f;
-        }
     }
     /* tick noice channel */
     {
@@ -600,24 +595,20 @@ static uint64_t _m6561_tick_audio(m6561_t* vic, uint64_t pins) {
                 uint32_t new_bit = ((s>>22)^(s>>13)) & 1;
                 noise->shift = ((s<<1)|new_bit) & 0x007FFFFF;
             }
+            toggled = true;
         }
         else {
             noise->count--;
         }
-        if (noise->bit && noise->enabled) {
-            snd->sample_accum += _m6561_noise_ampl(noise->shift);
-        }
     }
-    snd->sample_accum_count += 1.0f;
+    /* the output level only changes when a voice toggled */
+    if (toggled) {
+        _m6561_update_level(vic);
+    }
 
     /* output a new sample */
-    snd->sample_counter -= _M6561_FIXEDPOINT_SCALE;
-    if (snd->sample_counter <= 0) {
-        snd->sample_counter += snd->sample_period;
-        float sm = (snd->sample_accum / snd->sample_accum_count) * (snd->volume / 15.0f);
-        snd->sample_accum = 0.0f;
-        snd->sample_accum_count = 0.0f;
-        snd->sample = _m6561_dcadjust(snd, sm) * snd->sample_mag;
+    if (chips_blep_tick(&snd->blep)) {
+        snd->sample = snd->blep.sample;
         pins |= M6561_SAMPLE;
     }
     else {
@@ -655,6 +646,9 @@ uint64_t m6561_tick(m6561_t* vic, uint64_t pins) {
             const uint8_t data = M6561_GET_DATA(pins);
             vic->regs[addr] = data;
             _m6561_regs_dirty(vic);
+            if (addr >= 10) {
+                _m6561_update_level(vic);
+            }
         }
     }
 
@@ -734,103 +734,104 @@ static inline void _m6569_gunit_tick(m6569_t* vic, uint8_t g_data) {
 }
 
 /*
-    graphics sequencer decoding functions for 1 pixel
-
-    NOTE: the graphics sequencer decoding functions return a 16 bit value
-    with the color in the lower 8 bit values (actually: low 4 bit), and
-    a mask (either 0xFF for foreground colors or 0 for background colors)
-    in the top 8 bits. This mask is used in the color multiplexer to select
-    between the color produced by the graphics or sprite units, and for
-    sprite collision detection.
+    Get the graphics sequencer colors for a c_data value, the colors are
+    selected per pixel by the top bit of outp, or (if the function returns
+    true) by the top 2 bits of outp2, which is only updated every second
+    pixel in the multicolor modes.
+
+    NOTE: the colors are 16 bit values with the color in the lower 8 bits
+    (actually: low 4 bits), and a mask (either 0xFF for foreground colors or
+    0 for background colors) in the top 8 bits. This mask is used in the
+    color multiplexer to select between the color produced by the graphics
+    or sprite units, and for sprite collision detection.
 */
-static inline uint16_t _m6569_gunit_decode_mode0(m6569_t* vic) {
-    if (vic->gunit.outp & 0x80) {
-        // foreground color (top bits set)
-        return 0xFF00 | ((vic->gunit.c_data>>8) & 0xF);
-    }
-    else {
-        // background color (top bits clear)
-        return vic->gunit.bg[0];
-    }
-}
-
-static inline uint16_t _m6569_gunit_decode_mode1(m6569_t* vic) {
-    // only seven colors in multicolor mode
-    const uint8_t fg = (vic->gunit.c_data>>8) & 0x7;
-    if (vic->gunit.c_data & (1<<11)) {
-        // outp2 is only updated every 2 ticks
-        uint8_t bits = ((vic->gunit.outp2)>>6) & 3;
-        /* half resolution multicolor char
-            need 2 bits from the pixel sequencer
-                "00": Background color 0 ($d021) (alpha bits clear)
-                "01": Background color 1 ($d022) (alpha bits clear)
-                "10": Background color 2 ($d023) (alpha bits set)
-                "11": Color from bits 8-10 of c-data (alpha bits set)
-        */
-        if (bits == 3) {
-            // special case '11'
-            return 0xFF00 | fg;
-        }
-        else {
-            // one of the 3 background colors (top bits already pre-set)
-            return vic->gunit.bg[bits];
-        }
-    }
-    else {
-        // standard text mode char, but with only 7 foreground colors
-        if (vic->gunit.outp & 0x80) {
-            // foreground color (top bits set)
-            return 0xFF00 | fg;
-        }
-        else {
-            // background color (top bits already pre-set to 0)
-            return vic->gunit.bg[0];
-        }
-    }
-}
+static inline bool _m6569_gunit_colors(const m6569_t* vic, uint16_t c_data, uint16_t* colors) {
+    const m6569_graphics_unit_t* gu = &vic->gunit;
+    switch (gu->mode) {
+        case 0:
+            // standard text mode
+            colors[0] = gu->bg[0];
+            colors[1] = 0xFF00 | ((c_data>>8) & 0xF);
+            return false;
+        case 1:
+            // multicolor text mode, only seven foreground colors
+            if (c_data & (1<<11)) {
+                /* half resolution multicolor char
+                    "00": Background color 0 ($d021) (alpha bits clear)
+                    "01": Background color 1 ($d022) (alpha bits clear)
+                    "10": Background color 2 ($d023) (alpha bits set)
+                    "11": Color from bits 8-10 of c-data (alpha bits set)
+                */
+                colors[0] = gu->bg[0];
+                colors[1] = gu->bg[1];
+                colors[2] = gu->bg[2];
+                colors[3] = 0xFF00 | ((c_data>>8) & 0x7);
+                return true;
+            }
+            else {
+                // standard text mode char, but with only 7 foreground colors
+                colors[0] = gu->bg[0];
+                colors[1] = 0xFF00 | ((c_data>>8) & 0x7);
+                return false;
+            }
+        case 2:
+            // standard bitmap mode
+            colors[0] = c_data & 0xF;
+            colors[1] = 0xFF00 | ((c_data>>4) & 0xF);
+            return false;
+        case 3:
+            /* multicolor bitmap mode
+                "00": Background color 0 ($d021) (top bits clear)
+                "01": Color from bits 4-7 of c-data (top bits clear)
+                "10": Color from bits 0-3 of c-data (top bits set)
+                "11": Color from bits 8-11 of c-data (top bits set)
+            */
+            colors[0] = gu->bg[0];
+            colors[1] = (c_data>>4) & 0xF;
+            colors[2] = 0xFF00 | (c_data & 0xF);
+            colors[3] = 0xFF00 | ((c_data>>8) & 0xF);
+            return true;
+        case 4:
+            /* ECM text mode, bg color selected by bits 6 and 7 of c_data
 
-static inline uint16_t _m6569_gunit_decode_mode2(m6569_t* vic) {
-    if (vic->gunit.outp & 0x80) {
-        // foreground pixel (top 8 bits set)
-        return 0xFF00 | ((vic->gunit.c_data >> 4) & 0xF);
-    }
-    else {
-        // background pixel (top bits clear for multiplexer)
-        return vic->gunit.c_data & 0xF;
+                FIXME: is the foreground/background selection right?
+                values 00 and 01 would return as background color,
+                and 10 and 11 as foreground color?
+            */
+            colors[0] = gu->bg[(c_data>>6) & 3];
+            colors[1] = 0xFF00 | ((c_data>>8) & 0xF);
+            return false;
+        default:
+            // invalid modes output black background pixels
+            colors[0] = colors[1] = 0;
+            return false;
     }
 }
 
-static inline uint16_t _m6569_gunit_decode_mode3(m6569_t* vic) {
-    // shift 2 is only updated every 2 ticks
-    uint8_t bits = vic->gunit.outp2;
-    /* half resolution multicolor char
-        need 2 bits from the pixel sequencer
-            "00": Background color 0 ($d021) (top bits clear)
-            "01": Color from bits 4-7 of c-data (top bits clear)
-            "10": Color from bits 0-3 of c-data (top bits set)
-            "11": Color from bits 8-11 of c-data (top bits set)
-    */
-    switch ((bits>>6)&3) {
-        case 0:     return vic->gunit.bg[0]; break;
-        case 1:     return (vic->gunit.c_data>>4) & 0xF; break;
-        case 2:     return 0xFF00 | (vic->gunit.c_data & 0xF); break;
-        default:    return 0xFF00 | ((vic->gunit.c_data>>8) & 0xF); break;
-    }
-}
+/*
+    Tick the graphics sequencer for 8 pixels and write the pixel colors to
+    dst. Returns a mask with a bit set for each foreground pixel (bit 7
+    is the leftmost pixel), used for sprite collision and priority.
 
-static inline uint16_t _m6569_gunit_decode_mode4(m6569_t* vic) {
-    if (vic->gunit.outp & 0x80) {
-        // foreground color as usual bits 8..11 of c_data
-        return 0xFF00 | ((vic->gunit.c_data>>8) & 0xF);
-    }
-    else {
-        // bg color selected by bits 6 and 7 of c_data
-        /* FIXME: is the foreground/background selection right?
-            values 00 and 01 would return as background color,
-            and 10 and 11 as foreground color?
-        */
-        return vic->gunit.bg[(vic->gunit.c_data>>6) & 3];
+    The colors only change when the sequencer reloads c_data, so the
+    display mode is only evaluated once per reload instead of per pixel.
+*/
+static inline uint8_t _m6569_gunit_decode(m6569_t* vic, uint8_t g_data, uint8_t* dst) {
+    m6569_graphics_unit_t* gu = &vic->gunit;
+    uint16_t colors[4];
+    bool two_bits = _m6569_gunit_colors(vic, gu->c_data, colors);
+    uint8_t fg = 0;
+    for (size_t i = 0; i < 8; i++) {
+        const bool reload = (0 == gu->count);
+        _m6569_gunit_tick(vic, g_data);
+        if (reload) {
+            two_bits = _m6569_gunit_colors(vic, gu->c_data, colors);
+        }
+        const uint16_t c = colors[two_bits ? ((gu->outp2>>6) & 3) : (gu->outp>>7)];
+        dst[i] = (uint8_t) c;
+        fg |= (c >> 8) & (0x80 >> i);
     }
+    return fg;
 }
 
 /*--- sprite sequencer helper ------------------------------------------------*/
@@ -956,175 +957,183 @@ static inline uint64_t _m6569_sunit_dma_aec(m6569_t* vic, uint32_t s_index, uint
     return pins;
 }
 
-static inline uint16_t _m6569_sunit_decode(m6569_t* vic, uint8_t hpos) {
-    /* this will tick all the sprite units and return the color
-        of the highest-priority sprite color for the current pixel in
-        the lower 8 bits of the result, the high 8 bits of the result
-        have one bit set for each sprite unit that produced a color
-        (used for collision detection)
+/*
+    Tick sprite unit i for 8 pixels, this must only be called when the
+    sprite is displayed at the current horizontal position.
 
-        The function returns 0 if the sprite units didn't produce a color.
-    */
-    uint16_t c = 0;
-    bool collision = false;
+    Returns the sprite's coverage mask for the 8 pixels (bit 7 is the
+    leftmost pixel). The sprite colors are written to dst for all covered
+    pixels which are not already covered by a higher-priority sprite.
+*/
+static inline uint8_t _m6569_sunit_decode(m6569_t* vic, size_t i, uint8_t covered, uint8_t* dst) {
     m6569_sprite_unit_t* su = &vic->sunit;
-    uint8_t mxe = vic->reg.mxe;
-    uint8_t mmc = vic->reg.mmc;
-    for (size_t i = 0; i < 8; i++) {
-        if (su->disp_enabled[i] && (hpos >= su->h_first[i]) && (hpos <= su->h_last[i])) {
-            if (su->delay_count[i] == 0) {
-                if ((0 == (su->xexp_count[i]++ & 1)) || (0 == (mxe & (1<<i)))) {
-                    // bit 31 of outp is the current shifter output
-                    su->outp[i] = su->shift[i];
-                    // bits 31 and 30 of outp is half-frequency shifter output
-                    if (0 == (su->outp2_count[i]++ & 1)) {
-                        su->outp2[i] = su->shift[i];
-                    }
-                    su->shift[i] <<= 1;
-                }
-                if (mmc & (1<<i)) {
-                    // multicolor mode
-                    uint32_t ci = (su->outp2[i] & ((1<<31)|(1<<30)))>>30;
-                    if (ci != 0) {
-                        // don't overwrite higher-priority colors
-                        if (0 == c) {
-                            c = su->colors[i][ci];
-                        }
-                        else {
-                            collision = true;
-                        }
-                        c |= (1<<(8+i));
-                    }
-                }
-                else {
-                    /* standard color mode */
-                    if (su->outp[i] & (1<<31)) {
-                        /* don't overwrite higher-priority colors */
-                        if (0 == c) {
-                            c = su->colors[i][2] | (1<<(24+i));
-                        }
-                        else {
-                            collision = true;
-                        }
-                        c |= (1<<(8+i));
-                    }
+    const bool xexp = 0 != (vic->reg.mxe & (1<<i));
+    const bool multicolor = 0 != (vic->reg.mmc & (1<<i));
+    uint8_t mask = 0;
+    if ((su->delay_count[i] == 0) && !xexp && !multicolor) {
+        // common case: the next 8 shifter bits are the coverage mask
+        const uint32_t shift = su->shift[i];
+        mask = shift >> 24;
+        su->outp[i] = shift << 7;
+        su->outp2[i] = (su->outp2_count[i] & 1) ? (shift << 7) : (shift << 6);
+        su->outp2_count[i] += 8;
+        su->xexp_count[i] += 8;
+        su->shift[i] = shift << 8;
+        const uint8_t color = su->colors[i][2];
+        const uint8_t visible = mask & ~covered;
+        for (size_t p = 0; p < 8; p++) {
+            if (visible & (0x80 >> p)) {
+                dst[p] = color;
+            }
+        }
+        return mask;
+    }
+    for (size_t p = 0; p < 8; p++) {
+        if (su->delay_count[i] == 0) {
+            if ((0 == (su->xexp_count[i]++ & 1)) || !xexp) {
+                // bit 31 of outp is the current shifter output
+                su->outp[i] = su->shift[i];
+                // bits 31 and 30 of outp is half-frequency shifter output
+                if (0 == (su->outp2_count[i]++ & 1)) {
+                    su->outp2[i] = su->shift[i];
                 }
+                su->shift[i] <<= 1;
+            }
+            // color index 0 is transparent, 2 is the main color
+            uint32_t ci;
+            if (multicolor) {
+                ci = (su->outp2[i] >> 30) & 3;
             }
             else {
-                su->delay_count[i]--;
+                ci = (su->outp[i] >> 30) & 2;
+            }
+            if (ci != 0) {
+                const uint8_t bit = 0x80 >> p;
+                mask |= bit;
+                if (0 == (covered & bit)) {
+                    dst[p] = su->colors[i][ci];
+                }
             }
         }
+        else {
+            su->delay_count[i]--;
+        }
     }
-    if (collision) {
-        vic->reg.mcm |= (c>>8);
-        vic->reg.int_latch |= M6569_INT_IMMC;
-    }
-    return c;
+    return mask;
 }
 
 /*
-    Check for mob-data collision.
-
-    Takes the bitmap color bmc (top 8 bits are 0 if background color)
-    the sprite color sc (top 8 bits set for each sprite which
-    produced a non-transparant color), and sets the md
-    collision bitmask, and the IMBC interrupt bit.
+    Decode the next 8 pixels.
+
+    The graphics sequencer and each displayed sprite unit produce an
+    8-bit coverage mask for the 8 pixels of the tick (for the graphics
+    sequencer this is the foreground mask). Sprite collisions and the
+    graphics/sprite color priority are resolved on those masks:
+
+    - a sprite/sprite collision happens on pixels covered by more than
+      one sprite, all sprites covering such a pixel are flagged in the
+      MCM register
+    - a sprite/data collision happens on pixels covered by a sprite and
+      a graphics foreground pixel
+    - the sprite with the lowest index provides the sprite color
+    - the sprite color is hidden behind graphics foreground pixels if any
+      sprite covering the pixel has its MDP bit set
+
+    "...the vertical border flip flop controls the output of the graphics
+    data sequencer. The sequencer only outputs data if the flip flop is
+    not set..."
+
+    "The main border flip flop controls the border display. If it is set, the
+    VIC displays the color stored in register $d020, otherwise it displays the
+    color that the priority multiplexer switches through from the graphics or
+    sprite data sequencer. So the border overlays the text/bitmap graphics as
+    well as the sprites. It has the highest display priority."
+
+    ...otherwise it displays the background color
+
+    NOTE: the graphics and sprite units (and collision detection) keep
+    running under the border.
 */
-static inline void _m6569_test_mob_data_col(m6569_t* vic, uint16_t bmc, uint16_t sc) {
-    if ((sc & bmc & 0xFF00) != 0) {
-        vic->reg.mcd |= (sc>>8);
-        vic->reg.int_latch |= M6569_INT_IMBC;
-    }
-}
-
-/*
-    The graphics/sprite color priority multiplexer.
+static inline void _m6569_decode_pixels(m6569_t* vic, uint8_t g_data, uint8_t* dst, uint8_t hpos) {
+    const bool brd = vic->brd.vert | vic->brd.main;
+    const uint8_t brd_color = vic->brd.main ? vic->brd.bc : vic->gunit.bg[0];
+    m6569_sprite_unit_t* su = &vic->sunit;
 
-    - the sprite color is 0 if the sprite unit didn't produce a color
-    - the top 8 bits of the sprite color have a bit set for each
-      sprite unit which produced a color
-    - the top 8 bits of the bitmap color are 0 for a background
-      color, or 0xFF for a foreground color
-*/
-static inline uint8_t _m6569_color_multiplex(uint16_t bmc, uint16_t sc, uint8_t mdp) {
-    uint8_t c;
-    if (sc == 0) {
-        // sprite unit didn't produce a color, use the bitmap color
-        c = bmc;
-    }
-    else if ((sc>>8) & mdp) {
-        // data priority bit is set, sprite color is behind bitmap foreground color
-        if ((bmc & 0xFF00) == 0) {
-            // bitmap color is background, use sprite color
-            c = sc;
+    // find the sprite units which are displayed in this tick
+    uint8_t active = 0;
+    for (size_t i = 0; i < 8; i++) {
+        if (su->disp_enabled[i] && (hpos >= su->h_first[i]) && (hpos <= su->h_last[i])) {
+            active |= (1<<i);
+            if (hpos == su->h_first[i]) {
+                su->delay_count[i] = su->h_offset[i];
+                su->outp2_count[i] = 0;
+                su->xexp_count[i] = 0;
+            }
+        }
+    }
+    if (0 == active) {
+        // fast path without sprites, no collisions or priority multiplexing
+        if (brd) {
+            for (size_t i = 0; i < 8; i++) {
+                _m6569_gunit_tick(vic, g_data);
+            }
+            memset(dst, brd_color, 8);
         }
         else {
-            // bitmap color is foreground
-            c = bmc;
+            _m6569_gunit_decode(vic, g_data, dst);
         }
+        return;
     }
-    else {
-        // sprite color is in front of bitmap color
-        c = sc;
-    }
-    return c;
-}
-
-// decode the next 8 pixels
-static inline void _m6569_decode_pixels(m6569_t* vic, uint8_t g_data, uint8_t* dst, uint8_t hpos) {
 
-    m6569_sprite_unit_t* su = &vic->sunit;
+    uint8_t gfx[8];
+    uint8_t spr[8];
+    const uint8_t fg = _m6569_gunit_decode(vic, g_data, gfx);
+    const uint8_t mdp = vic->reg.mdp;
+    uint8_t mask[8] = { 0 };
+    uint8_t covered = 0;    // pixels covered by any sprite
+    uint8_t multi = 0;      // pixels covered by more than one sprite
+    uint8_t behind = 0;     // pixels covered by any sprite with MDP bit set
     for (size_t i = 0; i < 8; i++) {
-        if (su->disp_enabled[i] && (hpos == su->h_first[i])) {
-            su->delay_count[i] = su->h_offset[i];
-            su->outp2_count[i] = 0;
-            su->xexp_count[i] = 0;
+        if (active & (1<<i)) {
+            const uint8_t m = _m6569_sunit_decode(vic, i, covered, spr);
+            mask[i] = m;
+            multi |= covered & m;
+            covered |= m;
+            if (mdp & (1<<i)) {
+                behind |= m;
+            }
         }
     }
 
-    /*
-        "...the vertical border flip flop controls the output of the graphics
-        data sequencer. The sequencer only outputs data if the flip flop is
-        not set..."
-
-        NOTES about colors:
-            - if none of the sprite units produced a color the returned
-              color is 0
-            - the alpha channel of the sprite color is discarded and instead
-              used as bitmask to communicate which of the sprite units
-              produced the color, this is used to check the priority bit
-              for this sprite
-            - likewise the alpha channel bits for the graphics sequencer
-              are used to communicate whether the returned color is a
-              background or foreground colors (fg: alpha == 0xFF, bg: alpha == 0)
-
-        "The main border flip flop controls the border display. If it is set, the
-        VIC displays the color stored in register $d020, otherwise it displays the
-        color that the priority multiplexer switches through from the graphics or
-        sprite data sequencer. So the border overlays the text/bitmap graphics as
-        well as the sprites. It has the highest display priority."
-
-        ...otherwise it displays the background color
-    */
-    bool brd = vic->brd.vert | vic->brd.main;
-    uint8_t brd_color = vic->brd.main ? vic->brd.bc : vic->gunit.bg[0];
-    const uint8_t mdp = vic->reg.mdp;
-    const uint8_t mode = vic->gunit.mode;
-    uint16_t bmc = 0;
+    // sprite/sprite and sprite/data collisions
+    uint8_t mcm = 0;
+    uint8_t mcd = 0;
     for (size_t i = 0; i < 8; i++) {
-        // lower 8 bit sprite color, top 8 bit 'coverage mask'
-        uint16_t sc = _m6569_sunit_decode(vic, hpos);
-        _m6569_gunit_tick(vic, g_data);
-        // bmc: lower 8 bit color, top 8 bit set (foregreound) or cleared (background)
-        switch (mode) {
-            case 0: bmc = _m6569_gunit_decode_mode0(vic); break;
-            case 1: bmc = _m6569_gunit_decode_mode1(vic); break;
-            case 2: bmc = _m6569_gunit_decode_mode2(vic); break;
-            case 3: bmc = _m6569_gunit_decode_mode3(vic); break;
-            case 4: bmc = _m6569_gunit_decode_mode4(vic); break;
+        if (mask[i] & multi) {
+            mcm |= (1<<i);
+        }
+        if (mask[i] & fg) {
+            mcd |= (1<<i);
+        }
+    }
+    if (mcm) {
+        vic->reg.mcm |= mcm;
+        vic->reg.int_latch |= M6569_INT_IMMC;
+    }
+    if (mcd) {
+        vic->reg.mcd |= mcd;
+        vic->reg.int_latch |= M6569_INT_IMBC;
+    }
+
+    // the color priority multiplexer
+    if (brd) {
+        memset(dst, brd_color, 8);
+    }
+    else {
+        const uint8_t spr_visible = covered & ~(behind & fg);
+        for (size_t p = 0; p < 8; p++) {
+            dst[p] = (spr_visible & (0x80 >> p)) ? spr[p] : gfx[p];
         }
-        _m6569_test_mob_data_col(vic, bmc, sc);
-        dst[i] = brd ? brd_color : _m6569_color_multiplex(bmc, sc, mdp);
     }
 }
 
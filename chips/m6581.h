@@ -36,6 +36,26 @@
     The emulation has an additional "virtual pin" which is set to active
     whenever a new sample is ready (M6581_SAMPLE).
 
+    ## Block Synthesis
+
+    Between register accesses the SID doesn't need to be ticked cycle by
+    cycle. Instead the ticks can be collected and generated in one go with:
+
+    ~~~C
+    uint32_t m6581_run(m6581_t* sid, uint32_t num_ticks, float* samples, int max_samples, int* num_samples)
+    ~~~
+
+    This runs the SID for up to num_ticks ticks and writes the generated
+    samples to the samples array. It stops early right after the tick which
+    produced the max_samples-th sample. The number of samples written is
+    returned in num_samples, and the number of ticks actually run is the
+    return value. The output is identical to calling m6581_tick() with the
+    CS pin cleared for the same number of ticks.
+
+    Internally the voices are generated in blocks of up to 64 ticks, one
+    voice after another (unless hard sync or ring modulation couple the
+    voices), and the filter and mixer run over the block afterwards.
+
     ## Links
 
     - http://blog.kevtris.org/?p=13
@@ -248,6 +268,8 @@ void m6581_init(m6581_t* sid, const m6581_desc_t* desc);
 void m6581_reset(m6581_t* sid);
 // tick a m6581_t instance
 uint64_t m6581_tick(m6581_t* sid, uint64_t pins);
+// run a m6581_t instance for up to num_ticks without register access, see "Block Synthesis"
+uint32_t m6581_run(m6581_t* sid, uint32_t num_ticks, float* samples, int max_samples, int* num_samples);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -498,8 +520,7 @@ static inline uint16_t _m6581_noise(m6581_voice_t* v) {
            (M6581_BIT(s,2)<<4);
 }
 
-static inline void _m6581_voice_tick(m6581_t* sid, int voice_index) {
-    m6581_voice_t* v = &sid->voice[voice_index];
+static inline void _m6581_voice_tick(m6581_voice_t* v, m6581_voice_t* v_sync) {
 
     /* waveform generator */
     if (0 == (v->ctrl & M6581_CTRL_TEST)) {
@@ -515,7 +536,6 @@ static inline void _m6581_voice_tick(m6581_t* sid, int voice_index) {
         /* sync state */
         v->sync = (v->wav_accum & 0x00800000) && !(prev_accum & 0x00800000);
     }
-    m6581_voice_t* v_sync = &sid->voice[(voice_index+2)%3];
     uint32_t sm;
     switch ((v->ctrl>>4) & 0x0F) {
         case 0: sm = _m6581_wavnone(v); break;
@@ -644,18 +664,61 @@ static inline int _m6581_filter_output(m6581_filter_t* f, int vi) {
     return vf * (1<<7);
 }
 
-/* tick the sound generation, return true when new sample ready */
-static uint64_t _m6581_tick(m6581_t* sid, uint64_t pins) {
-    /* decay the last written register value */
+/* decay the last written register value */
+static inline void _m6581_bus_decay(m6581_t* sid, uint32_t num_ticks) {
     if (sid->bus_decay > 0) {
-        if (--sid->bus_decay == 0) {
+        if (sid->bus_decay <= num_ticks) {
+            sid->bus_decay = 0;
             sid->bus_value = 0;
         }
+        else {
+            sid->bus_decay -= num_ticks;
+        }
+    }
+}
+
+/* the output of a voice into the filter or direct mixer path, voice 3
+   can only be muted in the direct path
+*/
+static inline bool _m6581_voice_audible(const m6581_t* sid, int voice_index) {
+    return (0 != (sid->filter.voices & (1<<voice_index))) || !sid->voice[voice_index].muted;
+}
+
+static inline int _m6581_voice_output(const m6581_voice_t* v, bool audible) {
+    int wav_out = audible ? (int) v->wav_output : 0;
+    int env_out = (int) v->env_cur_level;
+    return (wav_out - M6581_DCWAVE) * env_out + M6581_DCVOICE;
+}
+
+/* filter and mix the voice outputs, return true when new sample ready */
+static inline bool _m6581_mix(m6581_t* sid, int sum_outp, int sum_filtered_outp) {
+    int accu = (sum_outp + _m6581_filter_output(&sid->filter, sum_filtered_outp) + M6581_DCMIXER) * sid->filter.volume;
+    int sample = accu / (1<<12);
+    sid->sample_accum += (sample / 16384.0f);
+    sid->sample_accum_count += 1.0f;
+
+    /* new sample? */
+    sid->sample_counter -= M6581_FIXEDPOINT_SCALE;
+    if (sid->sample_counter <= 0) {
+        sid->sample_counter += sid->sample_period;
+        float s = sid->sample_accum / sid->sample_accum_count;
+        sid->sample = sid->sample_mag * s;
+        sid->sample_accum = 0.0f;
+        sid->sample_accum_count = 0.0f;
+        return true;
     }
+    else {
+        return false;
+    }
+}
+
+/* tick the sound generation, return true when new sample ready */
+static uint64_t _m6581_tick(m6581_t* sid, uint64_t pins) {
+    _m6581_bus_decay(sid, 1);
 
     /* tick wave and envelope generators */
     for (int i = 0; i < 3; i++) {
-        _m6581_voice_tick(sid, i);
+        _m6581_voice_tick(&sid->voice[i], &sid->voice[(i+2)%3]);
     }
     /* handle voice synchronization */
     for (int i = 0; i < 3; i++) {
@@ -665,34 +728,14 @@ static uint64_t _m6581_tick(m6581_t* sid, uint64_t pins) {
     int sum_filtered_outp = 0;
     int sum_outp = 0;
     for (int i = 0; i < 3; i++) {
-        m6581_voice_t* v = &sid->voice[i];
-        int wav_out = (int) v->wav_output;
-        int env_out = (int) v->env_cur_level;
         if (sid->filter.voices & (1<<i)) {
-            sum_filtered_outp += (wav_out - M6581_DCWAVE) * env_out + M6581_DCVOICE;
+            sum_filtered_outp += _m6581_voice_output(&sid->voice[i], true);
         }
         else {
-            if (v->muted) {
-                sum_outp += (0 - M6581_DCWAVE) * env_out + M6581_DCVOICE;
-            }
-            else {
-                sum_outp += (wav_out - M6581_DCWAVE) * env_out + M6581_DCVOICE;
-            }
+            sum_outp += _m6581_voice_output(&sid->voice[i], !sid->voice[i].muted);
         }
     }
-    int accu = (sum_outp + _m6581_filter_output(&sid->filter, sum_filtered_outp) + M6581_DCMIXER) * sid->filter.volume;
-    int sample = accu / (1<<12);
-    sid->sample_accum += (sample / 16384.0f);
-    sid->sample_accum_count += 1.0f;
-
-    /* new sample? */
-    sid->sample_counter -= M6581_FIXEDPOINT_SCALE;
-    if (sid->sample_counter <= 0) {
-        sid->sample_counter += sid->sample_period;
-        float s = sid->sample_accum / sid->sample_accum_count;
-        sid->sample = sid->sample_mag * s;
-        sid->sample_accum = 0.0f;
-        sid->sample_accum_count = 0.0f;
+    if (_m6581_mix(sid, sum_outp, sum_filtered_outp)) {
         pins |= M6581_SAMPLE;
     }
     else {
@@ -701,6 +744,98 @@ static uint64_t _m6581_tick(m6581_t* sid, uint64_t pins) {
     return pins;
 }
 
+/*--- BLOCK SYNTHESIS ---------------------------------------------------------*/
+#define _M6581_BLOCK_SIZE (64)
+
+/* number of ticks (up to num_ticks) until max_samples new samples are ready */
+static uint32_t _m6581_block_ticks(const m6581_t* sid, uint32_t num_ticks, int max_samples) {
+    int counter = sid->sample_counter;
+    uint32_t i = 0;
+    while (i < num_ticks) {
+        i++;
+        counter -= M6581_FIXEDPOINT_SCALE;
+        if (counter <= 0) {
+            counter += sid->sample_period;
+            if (--max_samples == 0) {
+                break;
+            }
+        }
+    }
+    return i;
+}
+
+/*
+    Generate the voice outputs for a block of ticks.
+
+    Without hard sync and ring modulation the voices are independent
+    from each other, so each voice can be run over the whole block
+    before the next one, on a local copy of the voice state which the
+    compiler can keep in registers. Otherwise the voices must be ticked
+    in lockstep like in _m6581_tick(), since they read each other's
+    accumulator.
+*/
+static void _m6581_block_voices(m6581_t* sid, uint32_t num_ticks, int* outp, int* filtered_outp) {
+    memset(outp, 0, num_ticks * sizeof(int));
+    memset(filtered_outp, 0, num_ticks * sizeof(int));
+    const uint8_t ctrl = sid->voice[0].ctrl | sid->voice[1].ctrl | sid->voice[2].ctrl;
+    if (ctrl & (M6581_CTRL_SYNC|M6581_CTRL_RINGMOD)) {
+        for (uint32_t t = 0; t < num_ticks; t++) {
+            for (int i = 0; i < 3; i++) {
+                _m6581_voice_tick(&sid->voice[i], &sid->voice[(i+2)%3]);
+            }
+            for (int i = 0; i < 3; i++) {
+                _m6581_voice_sync(sid, i);
+            }
+            for (int i = 0; i < 3; i++) {
+                int* dst = (sid->filter.voices & (1<<i)) ? filtered_outp : outp;
+                dst[t] += _m6581_voice_output(&sid->voice[i], _m6581_voice_audible(sid, i));
+            }
+        }
+    }
+    else {
+        for (int i = 0; i < 3; i++) {
+            int* dst = (sid->filter.voices & (1<<i)) ? filtered_outp : outp;
+            const bool audible = _m6581_voice_audible(sid, i);
+            m6581_voice_t v = sid->voice[i];
+            for (uint32_t t = 0; t < num_ticks; t++) {
+                _m6581_voice_tick(&v, &v);
+                dst[t] += _m6581_voice_output(&v, audible);
+            }
+            sid->voice[i] = v;
+        }
+    }
+}
+
+uint32_t m6581_run(m6581_t* sid, uint32_t num_ticks, float* samples, int max_samples, int* num_samples) {
+    CHIPS_ASSERT(sid && num_samples && ((max_samples == 0) || samples));
+    int outp[_M6581_BLOCK_SIZE];
+    int filtered_outp[_M6581_BLOCK_SIZE];
+    uint32_t ticks = 0;
+    int n = 0;
+    bool sample_ready = false;
+    while ((ticks < num_ticks) && (n < max_samples)) {
+        uint32_t block_ticks = num_ticks - ticks;
+        if (block_ticks > _M6581_BLOCK_SIZE) {
+            block_ticks = _M6581_BLOCK_SIZE;
+        }
+        block_ticks = _m6581_block_ticks(sid, block_ticks, max_samples - n);
+        _m6581_bus_decay(sid, block_ticks);
+        _m6581_block_voices(sid, block_ticks, outp, filtered_outp);
+        for (uint32_t t = 0; t < block_ticks; t++) {
+            sample_ready = _m6581_mix(sid, outp[t], filtered_outp[t]);
+            if (sample_ready) {
+                samples[n++] = sid->sample;
+            }
+        }
+        ticks += block_ticks;
+    }
+    if (ticks > 0) {
+        sid->pins = sample_ready ? (sid->pins | M6581_SAMPLE) : (sid->pins & ~M6581_SAMPLE);
+    }
+    *num_samples = n;
+    return ticks;
+}
+
 /* read a register */
 static uint64_t _m6581_read(m6581_t* sid, uint64_t pins) {
     uint8_t reg = pins & M6581_ADDR_MASK;
@@ -18,6 +18,14 @@
     CHIPS_ASSERT(c)
     ~~~
 
+    Optionally define the following macro before including mem.h (in all
+    places, not just the implementation) to use the compact mem_t
+    representation described under 'Compact Mode' below:
+
+    ~~~C
+    CHIPS_MEM_COMPACT
+    ~~~
+
     ## Feature Overview
 
     - maps 16-bit addresses to host system addresses with 1 KByte page-size
@@ -25,6 +33,10 @@
     - memory pages can be mapped as RAM, ROM or RAM-behind-ROM (where
       read accesses are mapped to a different memory page then write accesses)
     - 4 independent page-table layers to simplify bank-switching implementations
+    - snapshot helpers which convert host pointers into offsets, optionally
+      with pointers into external (caller-owned) ROM images stored by identity
+    - reference-counted pages for copy-on-write sharing of memory between
+      emulator instances
 
     ## Usage
 
@@ -67,6 +79,73 @@
     Each page item consists of two host system pointers, one for read access,
     and one for write access.
 
+    ## Compact Mode
+
+    Compact mode is meant for targets with little RAM (for instance
+    microcontrollers), by default a mem_t is 2.5 KBytes on 32-bit targets
+    since the CPU-visible page table and each of the 4 layers have one page
+    item (two host pointers) per page.
+
+    When CHIPS_MEM_COMPACT is defined, layers are only given storage when
+    they are mapped for the first time. At most MEM_COMPACT_MAX_LAYERS
+    layers (default: 2) can be in use at the same time, a layer which has
+    been unmapped with mem_unmap_layer() gives its storage back. This
+    reduces a mem_t to 1.5 KBytes on 32-bit targets (3 KBytes on 64-bit
+    targets), the page items and mem_rd()/mem_wr() are the same as in
+    the default mode.
+
+    ## Cached bank-switching configurations
+
+    Systems which switch between a small fixed set of memory configurations
+    can build each configuration once with the regular mapping functions,
+    store the page items of the switchable address range with
+    **mem_get_pages()**, and later switch to a configuration by copying the
+    stored page items back with **mem_map_pages()**. This avoids recomputing
+    the host addresses of each page on every bank switch.
+
+    Stored page items are host pointers, they must be stored outside of snapshots or fixed up like other host
+    pointers, and they become stale when the mapped memory is moved or
+    remapped with mem_remap_page().
+
+    ## Copy-on-write page sharing
+
+    Emulator instances which are cloned from a common state can share
+    their RAM pages instead of copying them. The shared pages live in a
+    caller-owned pool of mem_shared_page_t items (a mem_page_pool_t),
+    each with a reference count:
+
+    - **mem_share_page()** copies a host memory page into an unused
+      pool page with a reference count of one
+    - **mem_remap_page()** replaces all mappings of a host memory page
+      in a mem_t with a different host memory page, this is used to
+      switch between an instance's private page and the shared page
+    - **mem_ref_page()** and **mem_unref_page()** add and drop references,
+      a page with no references is returned to the pool
+
+    mem_wr() doesn't know about shared pages, the emulator must copy a
+    shared page back into private memory and call mem_remap_page() before
+    the first write which changes the shared page's content.
+    **mem_writeptr()** and **mem_pool_contains()** can be used to find out
+    whether a write would hit a shared page. The page pool isn't thread-safe,
+    all instances sharing a pool must run on the same thread.
+
+    ## Snapshots and external ROM images
+
+    Before a system state is written to a snapshot, call
+    **mem_snapshot_onsave()** on each mem_t to convert host pointers into
+    offsets relative to a base address (usually the system state struct),
+    and call **mem_snapshot_onload()** for the reverse operation.
+
+    If ROM images are mapped directly from caller-owned memory (for instance
+    from flash memory, or shared between several emulator instances), the
+    pointers into those images can't be expressed as offsets into the system
+    state. In this case, describe the ROM images with an array of mem_ext_t
+    items and call **mem_snapshot_onsave_ext()** and **mem_snapshot_onload_ext()**
+    instead, pointers into ROM images are then stored as ROM index plus offset.
+    The snapshot itself doesn't contain the ROM data, use **mem_rom_id()** to
+    compute an identity hash of the ROM images which can be checked when
+    loading the snapshot.
+
     There are 2 internal special 'junk pages', one for write accesses to
     read-only-memory or unmapped memory, and one for read-access from unmapped
     memory. A read access from unmapped memory always returns 0xFF.
@@ -120,18 +199,49 @@ extern "C" {
 #define MEM_NUM_PAGES (MEM_ADDR_RANGE / MEM_PAGE_SIZE)
 #define MEM_NUM_LAYERS (4U)
 
+#if defined(CHIPS_MEM_COMPACT) && !defined(MEM_COMPACT_MAX_LAYERS)
+/* max number of layers per mem_t which can be mapped at the same time */
+#define MEM_COMPACT_MAX_LAYERS (2)
+#endif
+
 /* a memory page item maps a chunk of emulator memory to host memory */
 typedef struct {
     uint8_t* read_ptr;
     uint8_t* write_ptr;
 } mem_page_t;
 
+/* an external ROM image which is referenced by index in snapshots */
+typedef struct {
+    const uint8_t* ptr;
+    uint32_t size;
+} mem_ext_t;
+
+/* a reference-counted memory page, shared copy-on-write between mem_t instances */
+typedef struct {
+    uint32_t num_refs;      /* 0 if the page is unused */
+    uint8_t data[MEM_PAGE_SIZE];
+} mem_shared_page_t;
+
+/* a caller-owned pool of shared memory pages */
+typedef struct {
+    mem_shared_page_t* pages;
+    size_t num_pages;
+    size_t next;            /* where the search for an unused page starts */
+} mem_page_pool_t;
+
 /* a memory instance is a 2-dimensional table of memory pages */
 typedef struct {
     /* the pages that are actually visible to the emulated CPU */
     mem_page_t page_table[MEM_NUM_PAGES];
+    #if defined(CHIPS_MEM_COMPACT)
+    /* storage for memory-mapped layers, assigned to a layer on first use */
+    mem_page_t layer_pages[MEM_COMPACT_MAX_LAYERS][MEM_NUM_PAGES];
+    /* index+1 into layer_pages for each layer, 0 if the layer isn't used */
+    uint8_t layer_slot[MEM_NUM_LAYERS];
+    #else
     /* memory-mapped layers, layer 0 is highest priority */
     mem_page_t layers[MEM_NUM_LAYERS][MEM_NUM_PAGES];
+    #endif
 } mem_t;
 
 /* initialize a new mem instance */
@@ -148,8 +258,14 @@ void mem_unmap_layer(mem_t* mem, size_t layer);
 void mem_unmap_all(mem_t* mem);
 /* get the host-memory read-ptr of an emulator memory address */
 uint8_t* mem_readptr(mem_t* mem, uint16_t addr);
+/* get the host-memory write-ptr of an emulator memory address */
+uint8_t* mem_writeptr(mem_t* mem, uint16_t addr);
 /* copy a range of bytes into memory via mem_wr() */
 void mem_write_range(mem_t* mem, uint16_t addr, const uint8_t* src, uint32_t num_bytes);
+/* copy the page items of an address range in a layer to dst (size/MEM_PAGE_SIZE items) */
+void mem_get_pages(mem_t* mem, size_t layer, uint16_t addr, uint32_t size, mem_page_t* dst);
+/* map page items previously stored with mem_get_pages() into a layer */
+void mem_map_pages(mem_t* mem, size_t layer, uint16_t addr, uint32_t size, const mem_page_t* src);
 
 /* read a byte at 16-bit address */
 static inline uint8_t mem_rd(mem_t* mem, uint16_t addr) {
@@ -176,10 +292,27 @@ uint8_t mem_layer_rd(mem_t* mem, size_t layer, uint16_t addr);
 /* write a byte to a specific layer (slow!) */
 void mem_layer_wr(mem_t* mem, size_t layer, uint16_t addr, uint8_t data);
 
+/* replace all mappings of the host memory page at old_ptr with new_ptr in all layers */
+void mem_remap_page(mem_t* mem, const uint8_t* old_ptr, uint8_t* new_ptr);
+/* copy a host memory page into an unused pool page with one reference, returns 0 if the pool is exhausted */
+mem_shared_page_t* mem_share_page(mem_page_pool_t* pool, const uint8_t* src);
+/* add a reference to a shared page */
+void mem_ref_page(mem_shared_page_t* page);
+/* drop a reference to a shared page, the page is unused when the last reference is gone */
+void mem_unref_page(mem_shared_page_t* page);
+/* return true if a host memory pointer is inside a page pool */
+bool mem_pool_contains(const mem_page_pool_t* pool, const uint8_t* ptr);
+
 /* convert any internal pointers to offsets (helper function for serialization) */
 void mem_snapshot_onsave(mem_t* snapshot, void* base);
 /* ...and the reverse */
 void mem_snapshot_onload(mem_t* snapshot, void* base);
+/* same as mem_snapshot_onsave(), but pointers into external ROM images are stored as index and offset */
+void mem_snapshot_onsave_ext(mem_t* snapshot, void* base, const mem_ext_t* ext, size_t num_ext);
+/* ...and the reverse */
+void mem_snapshot_onload_ext(mem_t* snapshot, void* base, const mem_ext_t* ext, size_t num_ext);
+/* compute an identity hash over ROM image data, chain calls by passing the previous result as seed */
+uint32_t mem_rom_id(uint32_t seed, const uint8_t* ptr, uint32_t size);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -198,24 +331,88 @@ static uint8_t _mem_unmapped_page[MEM_PAGE_SIZE];
 // a write-only 'junk table' for writes to ROM areas
 static uint8_t _mem_junk_page[MEM_PAGE_SIZE];
 
+static inline uint8_t* _mem_page_read_ptr(const mem_page_t* page) {
+    return page->read_ptr;
+}
+
+static inline uint8_t* _mem_page_write_ptr(const mem_page_t* page) {
+    return page->write_ptr;
+}
+
+static inline void _mem_set_page(mem_page_t* page, const uint8_t* read_ptr, uint8_t* write_ptr) {
+    page->read_ptr = (uint8_t*)read_ptr;
+    page->write_ptr = write_ptr;
+}
+
+#if defined(CHIPS_MEM_COMPACT)
+// get a page item in a layer, or a null pointer if the layer isn't in use
+static inline mem_page_t* _mem_layer_page(mem_t* m, size_t layer, size_t page_index) {
+    const size_t slot = m->layer_slot[layer];
+    return slot ? &m->layer_pages[slot - 1][page_index] : 0;
+}
+
+// same as _mem_layer_page(), but assigns storage to the layer if not in use yet
+static mem_page_t* _mem_alloc_layer_page(mem_t* m, size_t layer, size_t page_index) {
+    if (0 == m->layer_slot[layer]) {
+        for (size_t slot = 0; slot < MEM_COMPACT_MAX_LAYERS; slot++) {
+            bool used = false;
+            for (size_t i = 0; i < MEM_NUM_LAYERS; i++) {
+                used |= (m->layer_slot[i] == (slot + 1));
+            }
+            if (!used) {
+                for (size_t i = 0; i < MEM_NUM_PAGES; i++) {
+                    _mem_set_page(&m->layer_pages[slot][i], 0, 0);
+                }
+                m->layer_slot[layer] = (uint8_t)(slot + 1);
+                break;
+            }
+        }
+        // too many layers in use, increase MEM_COMPACT_MAX_LAYERS
+        CHIPS_ASSERT(m->layer_slot[layer] != 0);
+    }
+    return _mem_layer_page(m, layer, page_index);
+}
+
+// give the storage of a layer back
+static void _mem_free_layer(mem_t* m, size_t layer) {
+    m->layer_slot[layer] = 0;
+}
+#else
+static inline mem_page_t* _mem_layer_page(mem_t* m, size_t layer, size_t page_index) {
+    return &m->layers[layer][page_index];
+}
+
+static inline mem_page_t* _mem_alloc_layer_page(mem_t* m, size_t layer, size_t page_index) {
+    return &m->layers[layer][page_index];
+}
+
+static void _mem_free_layer(mem_t* m, size_t layer) {
+    for (size_t page_index = 0; page_index < MEM_NUM_PAGES; page_index++) {
+        _mem_set_page(&m->layers[layer][page_index], 0, 0);
+    }
+}
+#endif
+
 void mem_init(mem_t* m) {
     CHIPS_ASSERT(m);
     *m = (mem_t){0};
-    memset(_mem_unmapped_page, 0xFF, sizeof(_mem_unmapped_page));
+    memset(_mem_unmapped_page, 0xFF, MEM_PAGE_SIZE);
     mem_unmap_all(m);
 }
 
 /* this sets the CPU-visible mapping of a page in the page-table */
 static void _mem_update_page_table(mem_t* m, size_t page_index) {
     /* find highest priority layer which maps this memory page */
-    size_t layer_index;
-    for (layer_index = 0; layer_index < MEM_NUM_LAYERS; layer_index++) {
-        if (m->layers[layer_index][page_index].read_ptr) {
+    const mem_page_t* page = 0;
+    for (size_t layer_index = 0; layer_index < MEM_NUM_LAYERS; layer_index++) {
+        const mem_page_t* layer_page = _mem_layer_page(m, layer_index, page_index);
+        if (layer_page && _mem_page_read_ptr(layer_page)) {
             /* found highest priority layer with valid mapping */
+            page = layer_page;
             break;
         }
     }
-    if (layer_index != MEM_NUM_LAYERS) {
+    if (page) {
         /* found a valid mapping */
 
         /*
@@ -245,13 +442,11 @@ static void _mem_update_page_table(mem_t* m, size_t page_index) {
         */
         // m->page_table[page_index] = m->layers[layer_index][page_index];
 
-        m->page_table[page_index].read_ptr = m->layers[layer_index][page_index].read_ptr;
-        m->page_table[page_index].write_ptr = m->layers[layer_index][page_index].write_ptr;
+        _mem_set_page(&m->page_table[page_index], _mem_page_read_ptr(page), _mem_page_write_ptr(page));
     }
     else {
         /* no mapping exists for this page, set to special 'unmapped page' */
-        m->page_table[page_index].read_ptr = _mem_unmapped_page;
-        m->page_table[page_index].write_ptr = _mem_junk_page;
+        _mem_set_page(&m->page_table[page_index], _mem_unmapped_page, _mem_junk_page);
     }
 }
 
@@ -268,13 +463,12 @@ static void _mem_map(mem_t* m, size_t layer, uint16_t addr, uint32_t size, const
         // the page_index will wrap-around
         const uint16_t page_index = ((addr+offset) & MEM_ADDR_MASK) >> MEM_PAGE_SHIFT;
         CHIPS_ASSERT(page_index <= MEM_NUM_PAGES);
-        mem_page_t* page = &m->layers[layer][page_index];
-        page->read_ptr = (uint8_t*)read_ptr + offset;
+        mem_page_t* page = _mem_alloc_layer_page(m, layer, page_index);
         if (0 != write_ptr) {
-            page->write_ptr = write_ptr + offset;
+            _mem_set_page(page, read_ptr + offset, write_ptr + offset);
         }
         else {
-            page->write_ptr = _mem_junk_page;
+            _mem_set_page(page, read_ptr + offset, _mem_junk_page);
         }
         _mem_update_page_table(m, page_index);
     }
@@ -295,24 +489,57 @@ void mem_map_rw(mem_t* m, size_t layer, uint16_t addr, uint32_t size, const uint
     _mem_map(m, layer, addr, size, read_ptr, write_ptr);
 }
 
+void mem_get_pages(mem_t* m, size_t layer, uint16_t addr, uint32_t size, mem_page_t* dst) {
+    CHIPS_ASSERT(m && dst);
+    CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
+    CHIPS_ASSERT((addr & MEM_PAGE_MASK) == 0);
+    CHIPS_ASSERT((size & MEM_PAGE_MASK) == 0);
+    CHIPS_ASSERT(size <= MEM_ADDR_RANGE);
+    const size_t num = size>>MEM_PAGE_SHIFT;
+    for (size_t i = 0; i < num; i++) {
+        const uint16_t page_index = ((addr + i * MEM_PAGE_SIZE) & MEM_ADDR_MASK) >> MEM_PAGE_SHIFT;
+        const mem_page_t* page = _mem_layer_page(m, layer, page_index);
+        if (page) {
+            memcpy(&dst[i], page, sizeof(mem_page_t));
+        }
+        else {
+            _mem_set_page(&dst[i], 0, 0);
+        }
+    }
+}
+
+void mem_map_pages(mem_t* m, size_t layer, uint16_t addr, uint32_t size, const mem_page_t* src) {
+    CHIPS_ASSERT(m && src);
+    CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
+    CHIPS_ASSERT((addr & MEM_PAGE_MASK) == 0);
+    CHIPS_ASSERT((size & MEM_PAGE_MASK) == 0);
+    CHIPS_ASSERT(size <= MEM_ADDR_RANGE);
+    const size_t num = size>>MEM_PAGE_SHIFT;
+    for (size_t i = 0; i < num; i++) {
+        const uint16_t page_index = ((addr + i * MEM_PAGE_SIZE) & MEM_ADDR_MASK) >> MEM_PAGE_SHIFT;
+        memcpy(_mem_alloc_layer_page(m, layer, page_index), &src[i], sizeof(mem_page_t));
+        if ((0 == layer) && _mem_page_read_ptr(&src[i])) {
+            // layer 0 has the highest priority, no need to look at the other layers
+            memcpy(&m->page_table[page_index], &src[i], sizeof(mem_page_t));
+        }
+        else {
+            _mem_update_page_table(m, page_index);
+        }
+    }
+}
+
 void mem_unmap_layer(mem_t* m, size_t layer) {
     CHIPS_ASSERT(m);
     CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
+    _mem_free_layer(m, layer);
     for (size_t page_index = 0; page_index < MEM_NUM_PAGES; page_index++) {
-        mem_page_t* page = &m->layers[layer][page_index];
-        page->read_ptr = 0;
-        page->write_ptr = 0;
         _mem_update_page_table(m, page_index);
     }
 }
 
 void mem_unmap_all(mem_t* m) {
     for (size_t layer_index = 0; layer_index < MEM_NUM_LAYERS; layer_index++) {
-        for (size_t page_index = 0; page_index < MEM_NUM_PAGES; page_index++) {
-            mem_page_t* page = &m->layers[layer_index][page_index];
-            page->read_ptr = 0;
-            page->write_ptr = 0;
-        }
+        _mem_free_layer(m, layer_index);
     }
     for (size_t page_index = 0; page_index < MEM_NUM_PAGES; page_index++) {
         _mem_update_page_table(m, page_index);
@@ -321,7 +548,12 @@ void mem_unmap_all(mem_t* m) {
 
 uint8_t* mem_readptr(mem_t* m, uint16_t addr) {
     CHIPS_ASSERT(m);
-    return (uint8_t*) &(m->page_table[addr>>MEM_PAGE_SHIFT].read_ptr[addr&MEM_PAGE_MASK]);
+    return &_mem_page_read_ptr(&m->page_table[addr>>MEM_PAGE_SHIFT])[addr&MEM_PAGE_MASK];
+}
+
+uint8_t* mem_writeptr(mem_t* m, uint16_t addr) {
+    CHIPS_ASSERT(m);
+    return &_mem_page_write_ptr(&m->page_table[addr>>MEM_PAGE_SHIFT])[addr&MEM_PAGE_MASK];
 }
 
 void mem_write_range(mem_t* m, uint16_t addr, const uint8_t* src, uint32_t num_bytes) {
@@ -332,8 +564,9 @@ void mem_write_range(mem_t* m, uint16_t addr, const uint8_t* src, uint32_t num_b
 
 uint8_t mem_layer_rd(mem_t* mem, size_t layer, uint16_t addr) {
     CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
-    if (mem->layers[layer][addr>>MEM_PAGE_SHIFT].read_ptr) {
-        return mem->layers[layer][addr>>MEM_PAGE_SHIFT].read_ptr[addr&MEM_PAGE_MASK];
+    const mem_page_t* page = _mem_layer_page(mem, layer, addr>>MEM_PAGE_SHIFT);
+    if (page && _mem_page_read_ptr(page)) {
+        return _mem_page_read_ptr(page)[addr&MEM_PAGE_MASK];
     }
     else {
         return 0xFF;
@@ -342,18 +575,89 @@ uint8_t mem_layer_rd(mem_t* mem, size_t layer, uint16_t addr) {
 
 void mem_layer_wr(mem_t* mem, size_t layer, uint16_t addr, uint8_t data) {
     CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
-    if (mem->layers[layer][addr>>MEM_PAGE_SHIFT].write_ptr) {
-        mem->layers[layer][addr>>MEM_PAGE_SHIFT].write_ptr[addr&MEM_PAGE_MASK] = data;
+    const mem_page_t* page = _mem_layer_page(mem, layer, addr>>MEM_PAGE_SHIFT);
+    if (page && _mem_page_write_ptr(page)) {
+        _mem_page_write_ptr(page)[addr&MEM_PAGE_MASK] = data;
     }
 }
 
+static void _mem_remap(mem_page_t* page, const uint8_t* old_ptr, uint8_t* new_ptr) {
+    uint8_t* read_ptr = _mem_page_read_ptr(page);
+    uint8_t* write_ptr = _mem_page_write_ptr(page);
+    if ((read_ptr == old_ptr) || (write_ptr == old_ptr)) {
+        _mem_set_page(page, (read_ptr == old_ptr) ? new_ptr : read_ptr, (write_ptr == old_ptr) ? new_ptr : write_ptr);
+    }
+}
+
+void mem_remap_page(mem_t* m, const uint8_t* old_ptr, uint8_t* new_ptr) {
+    CHIPS_ASSERT(m && old_ptr && new_ptr);
+    for (size_t page_index = 0; page_index < MEM_NUM_PAGES; page_index++) {
+        _mem_remap(&m->page_table[page_index], old_ptr, new_ptr);
+        for (size_t layer = 0; layer < MEM_NUM_LAYERS; layer++) {
+            mem_page_t* page = _mem_layer_page(m, layer, page_index);
+            if (page) {
+                _mem_remap(page, old_ptr, new_ptr);
+            }
+        }
+    }
+}
+
+mem_shared_page_t* mem_share_page(mem_page_pool_t* pool, const uint8_t* src) {
+    CHIPS_ASSERT(pool && pool->pages && src);
+    for (size_t i = 0; i < pool->num_pages; i++) {
+        const size_t index = (pool->next + i) % pool->num_pages;
+        mem_shared_page_t* page = &pool->pages[index];
+        if (0 == page->num_refs) {
+            page->num_refs = 1;
+            memcpy(page->data, src, MEM_PAGE_SIZE);
+            pool->next = (index + 1) % pool->num_pages;
+            return page;
+        }
+    }
+    return 0;
+}
+
+void mem_ref_page(mem_shared_page_t* page) {
+    CHIPS_ASSERT(page && (page->num_refs > 0));
+    page->num_refs++;
+}
+
+void mem_unref_page(mem_shared_page_t* page) {
+    CHIPS_ASSERT(page && (page->num_refs > 0));
+    page->num_refs--;
+}
+
+bool mem_pool_contains(const mem_page_pool_t* pool, const uint8_t* ptr) {
+    CHIPS_ASSERT(pool);
+    return (ptr >= (const uint8_t*)pool->pages) && (ptr < (const uint8_t*)(pool->pages + pool->num_pages));
+}
+
 #define MEM_SPECIAL_OFFSET_NULLPTR (-1)
 #define MEM_SPECIAL_OFFSET_UNMAPPED_PAGE (-2)
 #define MEM_SPECIAL_OFFSET_JUNK_PAGE (-3)
 
-static void mem_ptr_to_offset(uint8_t** ptr_ptr, uint8_t* base) {
+/* pointers into external ROM images are stored as -((index+1)<<24 | offset) */
+#define MEM_EXT_OFFSET_SHIFT (24)
+#define MEM_EXT_OFFSET_MASK ((1<<MEM_EXT_OFFSET_SHIFT)-1)
+
+static bool mem_ptr_to_ext_offset(uint8_t** ptr_ptr, const mem_ext_t* ext, size_t num_ext) {
+    const uint8_t* ptr = *ptr_ptr;
+    for (size_t i = 0; i < num_ext; i++) {
+        if ((ptr >= ext[i].ptr) && (ptr < (ext[i].ptr + ext[i].size))) {
+            CHIPS_ASSERT(ext[i].size <= MEM_EXT_OFFSET_MASK);
+            *ptr_ptr = (uint8_t*)(-((intptr_t)((i+1)<<MEM_EXT_OFFSET_SHIFT) | (ptr - ext[i].ptr)));
+            return true;
+        }
+    }
+    return false;
+}
+
+static void mem_ptr_to_offset(uint8_t** ptr_ptr, uint8_t* base, const mem_ext_t* ext, size_t num_ext) {
     uint8_t* ptr = *ptr_ptr;
-    if (ptr == 0) {
+    if (mem_ptr_to_ext_offset(ptr_ptr, ext, num_ext)) {
+        return;
+    }
+    else if (ptr == 0) {
         *ptr_ptr = (uint8_t*)(intptr_t)MEM_SPECIAL_OFFSET_NULLPTR;
     }
     else if (ptr == _mem_unmapped_page) {
@@ -368,8 +672,15 @@ static void mem_ptr_to_offset(uint8_t** ptr_ptr, uint8_t* base) {
     }
 }
 
-static void mem_offset_to_ptr(uint8_t** ptr_ptr, uint8_t* base) {
+static void mem_offset_to_ptr(uint8_t** ptr_ptr, uint8_t* base, const mem_ext_t* ext, size_t num_ext) {
     intptr_t offset = (intptr_t)*ptr_ptr;
+    if (offset <= -(1<<MEM_EXT_OFFSET_SHIFT)) {
+        const size_t index = (size_t)((-offset) >> MEM_EXT_OFFSET_SHIFT) - 1;
+        CHIPS_ASSERT(ext && (index < num_ext));
+        (void)num_ext;
+        *ptr_ptr = (uint8_t*)ext[index].ptr + ((-offset) & MEM_EXT_OFFSET_MASK);
+        return;
+    }
     switch (offset) {
         case MEM_SPECIAL_OFFSET_NULLPTR:
             *ptr_ptr = 0;
@@ -386,32 +697,68 @@ static void mem_offset_to_ptr(uint8_t** ptr_ptr, uint8_t* base) {
     }
 }
 
-void mem_snapshot_onsave(mem_t* snapshot, void* base) {
+void mem_snapshot_onsave_ext(mem_t* snapshot, void* base, const mem_ext_t* ext, size_t num_ext) {
     uint8_t* base8 = (uint8_t*)base;
     for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
-        mem_ptr_to_offset(&snapshot->page_table[page].read_ptr, base8);
-        mem_ptr_to_offset(&snapshot->page_table[page].write_ptr, base8);
+        mem_ptr_to_offset(&snapshot->page_table[page].read_ptr, base8, ext, num_ext);
+        mem_ptr_to_offset(&snapshot->page_table[page].write_ptr, base8, ext, num_ext);
     }
+    #if defined(CHIPS_MEM_COMPACT)
+    for (size_t slot = 0; slot < MEM_COMPACT_MAX_LAYERS; slot++) {
+        for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
+            mem_ptr_to_offset(&snapshot->layer_pages[slot][page].read_ptr, base8, ext, num_ext);
+            mem_ptr_to_offset(&snapshot->layer_pages[slot][page].write_ptr, base8, ext, num_ext);
+        }
+    }
+    #else
     for (size_t layer = 0; layer < MEM_NUM_LAYERS; layer++) {
         for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
-            mem_ptr_to_offset(&snapshot->layers[layer][page].read_ptr, base8);
-            mem_ptr_to_offset(&snapshot->layers[layer][page].write_ptr, base8);
+            mem_ptr_to_offset(&snapshot->layers[layer][page].read_ptr, base8, ext, num_ext);
+            mem_ptr_to_offset(&snapshot->layers[layer][page].write_ptr, base8, ext, num_ext);
         }
     }
+    #endif
 }
 
-void mem_snapshot_onload(mem_t* snapshot, void* base) {
+void mem_snapshot_onload_ext(mem_t* snapshot, void* base, const mem_ext_t* ext, size_t num_ext) {
     uint8_t* base8 = (uint8_t*)base;
     for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
-        mem_offset_to_ptr(&snapshot->page_table[page].read_ptr, base8);
-        mem_offset_to_ptr(&snapshot->page_table[page].write_ptr, base8);
+        mem_offset_to_ptr(&snapshot->page_table[page].read_ptr, base8, ext, num_ext);
+        mem_offset_to_ptr(&snapshot->page_table[page].write_ptr, base8, ext, num_ext);
     }
+    #if defined(CHIPS_MEM_COMPACT)
+    for (size_t slot = 0; slot < MEM_COMPACT_MAX_LAYERS; slot++) {
+        for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
+            mem_offset_to_ptr(&snapshot->layer_pages[slot][page].read_ptr, base8, ext, num_ext);
+            mem_offset_to_ptr(&snapshot->layer_pages[slot][page].write_ptr, base8, ext, num_ext);
+        }
+    }
+    #else
     for (size_t layer = 0; layer < MEM_NUM_LAYERS; layer++) {
         for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
-            mem_offset_to_ptr(&snapshot->layers[layer][page].read_ptr, base8);
-            mem_offset_to_ptr(&snapshot->layers[layer][page].write_ptr, base8);
+            mem_offset_to_ptr(&snapshot->layers[layer][page].read_ptr, base8, ext, num_ext);
+            mem_offset_to_ptr(&snapshot->layers[layer][page].write_ptr, base8, ext, num_ext);
         }
     }
+    #endif
+}
+
+void mem_snapshot_onsave(mem_t* snapshot, void* base) {
+    mem_snapshot_onsave_ext(snapshot, base, 0, 0);
+}
+
+void mem_snapshot_onload(mem_t* snapshot, void* base) {
+    mem_snapshot_onload_ext(snapshot, base, 0, 0);
+}
+
+/* 32-bit FNV-1a */
+uint32_t mem_rom_id(uint32_t seed, const uint8_t* ptr, uint32_t size) {
+    CHIPS_ASSERT(ptr);
+    uint32_t hash = seed ? seed : 0x811C9DC5;
+    for (uint32_t i = 0; i < size; i++) {
+        hash = (hash ^ ptr[i]) * 0x01000193;
+    }
+    return hash;
 }
 
 #endif /* CHIPS_IMPL */
@@ -209,6 +209,8 @@ typedef int (*upd765_seektrack_cb)(int drive, int track, void* user_data);
 typedef int (*upd765_seeksector_cb)(int drive, int side, upd765_sectorinfo_t* inout_info, void* user_data);
 /* callback to read the next sector data byte */
 typedef int (*upd765_read_cb)(int drive, int side, void* user_data, uint8_t* out_data);
+/* optional callback to get the data of the whole seeked-to sector, for bulk sector reads */
+typedef int (*upd765_sector_cb)(int drive, int side, void* user_data, const uint8_t** out_data, int* out_size);
 /* callback to read info about first sector on current reack */
 typedef int (*upd765_trackinfo_cb)(int drive, int side, void* user_data, upd765_sectorinfo_t* out_info);
 /* callback to get info about disk drive (called on SENSE_DRIVE_STATUS command) */
@@ -219,6 +221,7 @@ typedef struct {
     upd765_seektrack_cb seektrack_cb;
     upd765_seeksector_cb seeksector_cb;
     upd765_read_cb read_cb;
+    upd765_sector_cb sector_cb;     /* optional */
     upd765_trackinfo_cb trackinfo_cb;
     upd765_driveinfo_cb driveinfo_cb;
     void* user_data;
@@ -238,10 +241,18 @@ typedef struct {
     upd765_driveinfo_t drive_info;      /* only valid after SENSE_DRIVE_CMD */
     uint8_t st[4];
 
+    /* the sector data in bulk sector reads (size > 0 if active), see _upd765_exec_rd() */
+    struct {
+        const uint8_t* ptr;
+        int size;
+        int pos;
+    } sector;
+
     /* callback functions */
     upd765_seektrack_cb seektrack_cb;
     upd765_seeksector_cb seeksector_cb;
     upd765_read_cb read_cb;
+    upd765_sector_cb sector_cb;
     upd765_trackinfo_cb trackinfo_cb;
     upd765_driveinfo_cb driveinfo_cb;
     void* user_data;
@@ -345,6 +356,8 @@ static void _upd765_to_phase_idle(upd765_t* upd) {
 static void _upd765_to_phase_result(upd765_t* upd) {
     CHIPS_ASSERT((upd->phase == UPD765_PHASE_COMMAND) || (upd->phase == UPD765_PHASE_EXEC));
     upd->phase = UPD765_PHASE_RESULT;
+    upd->sector.ptr = 0;
+    upd->sector.size = 0;
     switch (upd->cmd) {
         case UPD765_CMD_READ_DATA:
         case UPD765_CMD_READ_DELETED_DATA:
@@ -411,6 +424,16 @@ static void _upd765_cmd(upd765_t* upd) {
                 const int side = (upd->st[0] & 4) >> 2;
                 const int res = upd->seeksector_cb(fdd_index, side, &upd->sector_info, upd->user_data);
                 if (UPD765_RESULT_SUCCESS == res) {
+                    /* if possible, get the whole sector at once instead of reading byte by byte */
+                    upd->sector.ptr = 0;
+                    upd->sector.size = 0;
+                    upd->sector.pos = 0;
+                    if (upd->sector_cb) {
+                        if (UPD765_RESULT_SUCCESS != upd->sector_cb(fdd_index, side, upd->user_data, &upd->sector.ptr, &upd->sector.size)) {
+                            upd->sector.ptr = 0;
+                            upd->sector.size = 0;
+                        }
+                    }
                     _upd765_to_phase_exec(upd);
                 }
                 else {
@@ -552,7 +575,23 @@ static uint8_t _upd765_exec_rd(upd765_t* upd) {
     uint8_t data = 0xFF;
     switch (upd->cmd) {
         case UPD765_CMD_READ_DATA:
-            {
+            if (upd->sector.size > 0) {
+                /* bulk sector read, the sector pointer isn't part of snapshots and must be fetched again */
+                if (0 == upd->sector.ptr) {
+                    const int fdd_index = upd->st[0] & 3;
+                    const int side = (upd->st[0] & 4) >> 2;
+                    if (UPD765_RESULT_SUCCESS != upd->sector_cb(fdd_index, side, upd->user_data, &upd->sector.ptr, &upd->sector.size)) {
+                        upd->st[0] |= UPD765_ST0_NR;
+                        _upd765_to_phase_result(upd);
+                        break;
+                    }
+                }
+                data = upd->sector.ptr[upd->sector.pos++];
+                if (upd->sector.pos >= upd->sector.size) {
+                    _upd765_to_phase_result(upd);
+                }
+            }
+            else {
                 /* read next sector data byte from FDD */
                 const int fdd_index = upd->st[0] & 3;
                 const int side = (upd->st[0] & 4) >> 2;
@@ -658,6 +697,7 @@ void upd765_init(upd765_t* upd, const upd765_desc_t* desc) {
     upd->seektrack_cb = desc->seektrack_cb;
     upd->seeksector_cb = desc->seeksector_cb;
     upd->read_cb = desc->read_cb;
+    upd->sector_cb = desc->sector_cb;
     upd->trackinfo_cb = desc->trackinfo_cb;
     upd->driveinfo_cb = desc->driveinfo_cb;
     upd->user_data = desc->user_data;
@@ -697,6 +737,8 @@ void upd765_snapshot_onsave(upd765_t* snapshot) {
     snapshot->seektrack_cb = 0;
     snapshot->seeksector_cb = 0;
     snapshot->read_cb = 0;
+    snapshot->sector_cb = 0;
+    snapshot->sector.ptr = 0;
     snapshot->trackinfo_cb = 0;
     snapshot->driveinfo_cb = 0;
     snapshot->user_data = 0;
@@ -707,6 +749,7 @@ void upd765_snapshot_onload(upd765_t* snapshot, upd765_t* sys) {
     snapshot->seektrack_cb = sys->seektrack_cb;
     snapshot->seeksector_cb = sys->seeksector_cb;
     snapshot->read_cb = sys->read_cb;
+    snapshot->sector_cb = sys->sector_cb;
     snapshot->trackinfo_cb = sys->trackinfo_cb;
     snapshot->driveinfo_cb = sys->driveinfo_cb;
     snapshot->user_data = sys->user_data;
@@ -67,7 +67,7 @@ extern "C" {
 #endif
 
 // bump snapshot version when memory layout of atom_t changes
-#define ATOM_SNAPSHOT_VERSION (1)
+#define ATOM_SNAPSHOT_VERSION (3)
 
 #define ATOM_FREQUENCY (1000000)
 #define ATOM_MAX_AUDIO_SAMPLES (1024)       // max number of audio samples in internal sample buffer
@@ -106,6 +106,7 @@ typedef struct {
     i8255_t ppi;
     m6522_t via;
     beeper_t beeper;
+    uint32_t beeper_num_deferred;   // ticks since the last beeper_run(), see _atom_sync_beeper()
     chips_debug_t debug;
     uint64_t pins;
     bool valid;
@@ -245,9 +246,33 @@ void atom_reset(atom_t* sys) {
     m6522_reset(&sys->via);
     mc6847_reset(&sys->vdg);
     beeper_reset(&sys->beeper);
+    sys->beeper_num_deferred = 0;
     sys->state_2_4khz = false;
 }
 
+/* The beeper runs in event mode, output changes are recorded with their
+   tick offset, and the samples are generated in one go when the change
+   buffer is full, and at the end of atom_exec().
+*/
+static void _atom_sync_beeper(atom_t* sys) {
+    uint32_t num_ticks = sys->beeper_num_deferred;
+    while (num_ticks > 0) {
+        int num_samples = 0;
+        num_ticks -= beeper_run(&sys->beeper, num_ticks,
+            &sys->audio.sample_buffer[sys->audio.sample_pos],
+            sys->audio.num_samples - sys->audio.sample_pos,
+            &num_samples);
+        sys->audio.sample_pos += num_samples;
+        if (sys->audio.sample_pos == sys->audio.num_samples) {
+            if (sys->audio.callback.func) {
+                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
+            }
+            sys->audio.sample_pos = 0;
+        }
+    }
+    sys->beeper_num_deferred = 0;
+}
+
 uint64_t _atom_tick(atom_t* sys, uint64_t cpu_pins) {
     // tick the CPU
     cpu_pins = m6502_tick(&sys->cpu, cpu_pins);
@@ -259,17 +284,8 @@ uint64_t _atom_tick(atom_t* sys, uint64_t cpu_pins) {
         sys->counter_2_4khz -= sys->period_2_4khz;
     }
 
-    // update beeper
-    if (beeper_tick(&sys->beeper)) {
-        // new audio sample ready
-        sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->beeper.sample;
-        if (sys->audio.sample_pos == sys->audio.num_samples) {
-            if (sys->audio.callback.func) {
-                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
-            }
-            sys->audio.sample_pos = 0;
-        }
-    }
+    // update beeper (deferred, see _atom_sync_beeper())
+    sys->beeper_num_deferred++;
 
     // address decoding
     const uint16_t addr = M6502_GET_ADDR(cpu_pins);
@@ -369,7 +385,10 @@ uint64_t _atom_tick(atom_t* sys, uint64_t cpu_pins) {
         if (ppi_pins & I8255_PA5) { vdg_pins |= MC6847_GM0; }
         if (ppi_pins & I8255_PA6) { vdg_pins |= MC6847_GM1; }
         if (ppi_pins & I8255_PA7) { vdg_pins |= MC6847_GM2; }
-        beeper_set(&sys->beeper, 0 == (ppi_pins & I8255_PC2));
+        if (beeper_events_full(&sys->beeper)) {
+            _atom_sync_beeper(sys);
+        }
+        beeper_set_at(&sys->beeper, sys->beeper_num_deferred, 0 == (ppi_pins & I8255_PC2));
         if (ppi_pins & I8255_PC3) {
             vdg_pins |= MC6847_CSS;
         }
@@ -423,6 +442,7 @@ uint32_t atom_exec(atom_t* sys, uint32_t micro_seconds) {
             sys->debug.callback.func(sys->debug.callback.user_data, pins);
         }
     }
+    _atom_sync_beeper(sys);
     sys->pins = pins;
     kbd_update(&sys->kbd, micro_seconds);
     return num_ticks;
@@ -33,6 +33,36 @@
         - https://floooh.github.io/2018/10/06/bombjack.html
         - https://github.com/floooh/emu-info/blob/master/misc/bombjack-schematics.pdf
 
+    ## Running the main and sound board on separate threads
+
+    The main board only talks to the sound board through the sound command
+    latch, and the sound board never talks back. Latch writes are put into a
+    small lock-free queue together with the sound board tick at which they
+    happen, and the sound board applies them exactly at that tick.
+
+    bombjack_exec() runs the main board and then the sound board for the
+    same time slice. Alternatively, bombjack_exec_mainboard() and
+    bombjack_exec_soundboard() may be called from two different threads,
+    as long as the sound board never runs ahead of the main board. For
+    instance in each host frame, run the main board for the current frame
+    on one thread and the sound board for the previous frame on another
+    thread, and join both threads before the next frame:
+
+    ~~~C
+    // thread 1:
+    bombjack_exec_mainboard(sys, frame_time_us);
+    // thread 2 (the audio callback will be called on this thread):
+    bombjack_exec_soundboard(sys, prev_frame_time_us);
+    ~~~
+
+    Running the boards on separate threads needs GCC, Clang or MSVC (for the
+    memory ordering of the queue), with other compilers both boards must run
+    on the same thread.
+
+    All other functions must only be called while no board is running.
+    The queue holds up to BOMBJACK_SOUND_LATCH_QUEUE_SIZE writes, further
+    writes are dropped until the sound board catches up.
+
     ## zlib/libpng license
 
     Copyright (c) 2018 Andre Weissflog
@@ -61,9 +91,10 @@ extern "C" {
 #endif
 
 // increase when bombjack_t memory layout changes
-#define BOMBJACK_SNAPSHOT_VERSION (2)
+#define BOMBJACK_SNAPSHOT_VERSION (7)
 
 #define BOMBJACK_MAX_AUDIO_SAMPLES (1024)
+#define BOMBJACK_SOUND_LATCH_QUEUE_SIZE (32) // must be a power of 2
 #define BOMBJACK_DEFAULT_AUDIO_SAMPLES (128)
 #define BOMBJACK_FRAMEBUFFER_WIDTH (256)
 #define BOMBJACK_FRAMEBUFFER_HEIGHT (288) // save space for sprites
@@ -162,6 +193,12 @@ typedef struct {
     } roms;
 } bombjack_desc_t;
 
+// a sound latch write by the main board, timestamped in sound board ticks
+typedef struct {
+    uint64_t tick;
+    uint8_t data;
+} bombjack_sound_latch_write_t;
+
 // the whole Bomb Jack arcade machine state
 typedef struct {
     struct {
@@ -173,6 +210,7 @@ typedef struct {
         uint8_t dsw2;           // dip-switches 2
         uint8_t nmi_mask;       // if 0, no NMIs are generated
         uint8_t bg_image;       // current background image
+        uint64_t tick_count;    // for timestamping sound latch writes
         int vsync_count;
         int vblank_count;
         mem_t mem;
@@ -182,12 +220,20 @@ typedef struct {
     struct {
         z80_t cpu;
         ay38910_t psg[3];
-        uint32_t tick_count;
+        uint32_t psg_num_deferred;  // number of deferred PSG ticks, see _bombjack_sync_psgs()
+        uint64_t tick_count;
         int vsync_count;
         mem_t mem;
         uint64_t pins;
     } soundboard;
-    uint8_t sound_latch;        // shared latch, written by main board, read by sound board
+    // shared latch, written by main board, read by sound board (see _bombjack_sound_latch_write())
+    struct {
+        uint8_t value;          // current latch content as seen by the sound board
+        uint32_t head;          // next queue slot to write, only written by the main board
+        uint32_t tail;          // next queue slot to read, only written by the sound board
+        uint64_t next_tick;     // sound board tick of the next queued write
+        bombjack_sound_latch_write_t queue[BOMBJACK_SOUND_LATCH_QUEUE_SIZE];
+    } sound_latch;
 
     bool valid;
 
@@ -195,10 +241,13 @@ typedef struct {
     uint8_t sound_ram[0x0400];
     uint8_t rom_main[5][0x2000];
     uint8_t rom_sound[1][0x2000];
-    uint8_t rom_chars[3][0x1000];
-    uint8_t rom_tiles[3][0x2000];
-    uint8_t rom_sprites[3][0x2000];
     uint8_t rom_maps[1][0x1000];
+    // char, tile and sprite ROMs decoded to one byte per pixel (see _bombjack_unpack_gfx())
+    struct {
+        alignas(64) uint8_t chars[512][8*8];
+        alignas(64) uint8_t tiles[256][16*16];
+        alignas(64) uint8_t sprites[256][16*16];
+    } gfx;
 
     struct {
         chips_audio_callback_t callback;
@@ -216,6 +265,12 @@ typedef struct {
         bool clear_background_layer;
     } dbg;
 
+    // 8x8 screen cells which need to be redrawn (see _bombjack_decode_video())
+    struct {
+        uint32_t dirty[32];     // one bit per cell, one 32-bit mask per row of cells
+        uint8_t layers;         // debug layer flags used for the last frame
+    } video;
+
     alignas(64) uint32_t fb[BOMBJACK_FRAMEBUFFER_WIDTH * BOMBJACK_FRAMEBUFFER_HEIGHT];
 } bombjack_t;
 
@@ -229,6 +284,10 @@ void bombjack_reset(bombjack_t* sys);
 chips_display_info_t bombjack_display_info(bombjack_t* sys);
 // run bombjack instance for given amount of microseconds
 uint32_t bombjack_exec(bombjack_t* sys, uint32_t micro_seconds);
+// only run the main board (see "Running the main and sound board on separate threads")
+uint32_t bombjack_exec_mainboard(bombjack_t* sys, uint32_t micro_seconds);
+// only run the sound board, must not run ahead of the main board
+uint32_t bombjack_exec_soundboard(bombjack_t* sys, uint32_t micro_seconds);
 // take a snapshot, patches any pointers to zero, returns a snapshot version
 uint32_t bombjack_save_snapshot(bombjack_t* sys, bombjack_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
@@ -246,6 +305,20 @@ bool bombjack_load_snapshot(bombjack_t* sys, uint32_t version, bombjack_t* src);
     #define CHIPS_ASSERT(c) assert(c)
 #endif
 
+#if defined(__GNUC__)
+#define _BOMBJACK_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define _BOMBJACK_STORE_RELEASE(p,v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#elif defined(_MSC_VER)
+// interlocked operations are full barriers on all MSVC targets (including ARM64)
+#include <intrin.h>
+#define _BOMBJACK_LOAD_ACQUIRE(p) ((uint32_t)_InterlockedOr((volatile long*)(p), 0))
+#define _BOMBJACK_STORE_RELEASE(p,v) ((void)_InterlockedExchange((volatile long*)(p), (long)(v)))
+#else
+// no memory ordering, the boards must run on the same thread (see header)
+#define _BOMBJACK_LOAD_ACQUIRE(p) (*(p))
+#define _BOMBJACK_STORE_RELEASE(p,v) (*(p) = (v))
+#endif
+
 #define _BOMBJACK_MAINBOARD_FREQUENCY (4000000)
 #define _BOMBJACK_SOUNDBOARD_FREQUENCY (3000000)
 #define _BOMBJACK_VSYNC_PERIOD_4MHZ (4000000/60)
@@ -254,6 +327,8 @@ bool bombjack_load_snapshot(bombjack_t* sys, uint32_t version, bombjack_t* src);
 
 #define _bombjack_def(val, def) (val == 0 ? def : val)
 
+static void _bombjack_unpack_gfx(bombjack_t* sys, const bombjack_desc_t* desc);
+
 void bombjack_init(bombjack_t* sys, const bombjack_desc_t* desc) {
     CHIPS_ASSERT(sys && desc);
     if (desc->debug.mainboard.callback.func) { CHIPS_ASSERT(desc->debug.mainboard.stopped); }
@@ -266,6 +341,7 @@ void bombjack_init(bombjack_t* sys, const bombjack_desc_t* desc) {
     sys->dbg.draw_foreground_layer = true;
     sys->dbg.draw_sprite_layer = true;
     sys->dbg.clear_background_layer = true;
+    memset(sys->video.dirty, 0xFF, sizeof(sys->video.dirty));
 
     /* copy over ROM images */
     CHIPS_ASSERT(desc->roms.main_0000_1FFF.ptr && (desc->roms.main_0000_1FFF.size == sizeof(sys->rom_main[0])));
@@ -274,15 +350,15 @@ void bombjack_init(bombjack_t* sys, const bombjack_desc_t* desc) {
     CHIPS_ASSERT(desc->roms.main_6000_7FFF.ptr && (desc->roms.main_6000_7FFF.size == sizeof(sys->rom_main[3])));
     CHIPS_ASSERT(desc->roms.main_C000_DFFF.ptr && (desc->roms.main_C000_DFFF.size == sizeof(sys->rom_main[4])));
     CHIPS_ASSERT(desc->roms.sound_0000_1FFF.ptr && (desc->roms.sound_0000_1FFF.size == sizeof(sys->rom_sound[0])));
-    CHIPS_ASSERT(desc->roms.chars_0000_0FFF.ptr && (desc->roms.chars_0000_0FFF.size == sizeof(sys->rom_chars[0])));
-    CHIPS_ASSERT(desc->roms.chars_1000_1FFF.ptr && (desc->roms.chars_1000_1FFF.size == sizeof(sys->rom_chars[1])));
-    CHIPS_ASSERT(desc->roms.chars_2000_2FFF.ptr && (desc->roms.chars_2000_2FFF.size == sizeof(sys->rom_chars[2])));
-    CHIPS_ASSERT(desc->roms.tiles_0000_1FFF.ptr && (desc->roms.tiles_0000_1FFF.size == sizeof(sys->rom_tiles[0])));
-    CHIPS_ASSERT(desc->roms.tiles_2000_3FFF.ptr && (desc->roms.tiles_2000_3FFF.size == sizeof(sys->rom_tiles[1])));
-    CHIPS_ASSERT(desc->roms.tiles_4000_5FFF.ptr && (desc->roms.tiles_4000_5FFF.size == sizeof(sys->rom_tiles[2])));
-    CHIPS_ASSERT(desc->roms.sprites_0000_1FFF.ptr && (desc->roms.sprites_0000_1FFF.size == sizeof(sys->rom_sprites[0])));
-    CHIPS_ASSERT(desc->roms.sprites_2000_3FFF.ptr && (desc->roms.sprites_2000_3FFF.size == sizeof(sys->rom_sprites[1])));
-    CHIPS_ASSERT(desc->roms.sprites_4000_5FFF.ptr && (desc->roms.sprites_4000_5FFF.size == sizeof(sys->rom_sprites[2])));
+    CHIPS_ASSERT(desc->roms.chars_0000_0FFF.ptr && (desc->roms.chars_0000_0FFF.size == 0x1000));
+    CHIPS_ASSERT(desc->roms.chars_1000_1FFF.ptr && (desc->roms.chars_1000_1FFF.size == 0x1000));
+    CHIPS_ASSERT(desc->roms.chars_2000_2FFF.ptr && (desc->roms.chars_2000_2FFF.size == 0x1000));
+    CHIPS_ASSERT(desc->roms.tiles_0000_1FFF.ptr && (desc->roms.tiles_0000_1FFF.size == 0x2000));
+    CHIPS_ASSERT(desc->roms.tiles_2000_3FFF.ptr && (desc->roms.tiles_2000_3FFF.size == 0x2000));
+    CHIPS_ASSERT(desc->roms.tiles_4000_5FFF.ptr && (desc->roms.tiles_4000_5FFF.size == 0x2000));
+    CHIPS_ASSERT(desc->roms.sprites_0000_1FFF.ptr && (desc->roms.sprites_0000_1FFF.size == 0x2000));
+    CHIPS_ASSERT(desc->roms.sprites_2000_3FFF.ptr && (desc->roms.sprites_2000_3FFF.size == 0x2000));
+    CHIPS_ASSERT(desc->roms.sprites_4000_5FFF.ptr && (desc->roms.sprites_4000_5FFF.size == 0x2000));
     CHIPS_ASSERT(desc->roms.maps_0000_0FFF.ptr && (desc->roms.maps_0000_0FFF.size == sizeof(sys->rom_maps[0])));
     memcpy(sys->rom_main[0], desc->roms.main_0000_1FFF.ptr, sizeof(sys->rom_main[0]));
     memcpy(sys->rom_main[1], desc->roms.main_2000_3FFF.ptr, sizeof(sys->rom_main[1]));
@@ -290,15 +366,7 @@ void bombjack_init(bombjack_t* sys, const bombjack_desc_t* desc) {
     memcpy(sys->rom_main[3], desc->roms.main_6000_7FFF.ptr, sizeof(sys->rom_main[3]));
     memcpy(sys->rom_main[4], desc->roms.main_C000_DFFF.ptr, sizeof(sys->rom_main[4]));
     memcpy(sys->rom_sound[0], desc->roms.sound_0000_1FFF.ptr, sizeof(sys->rom_sound[0]));
-    memcpy(sys->rom_chars[0], desc->roms.chars_0000_0FFF.ptr, sizeof(sys->rom_chars[0]));
-    memcpy(sys->rom_chars[1], desc->roms.chars_1000_1FFF.ptr, sizeof(sys->rom_chars[1]));
-    memcpy(sys->rom_chars[2], desc->roms.chars_2000_2FFF.ptr, sizeof(sys->rom_chars[2]));
-    memcpy(sys->rom_tiles[0], desc->roms.tiles_0000_1FFF.ptr, sizeof(sys->rom_tiles[0]));
-    memcpy(sys->rom_tiles[1], desc->roms.tiles_2000_3FFF.ptr, sizeof(sys->rom_tiles[1]));
-    memcpy(sys->rom_tiles[2], desc->roms.tiles_4000_5FFF.ptr, sizeof(sys->rom_tiles[2]));
-    memcpy(sys->rom_sprites[0], desc->roms.sprites_0000_1FFF.ptr, sizeof(sys->rom_sprites[0]));
-    memcpy(sys->rom_sprites[1], desc->roms.sprites_2000_3FFF.ptr, sizeof(sys->rom_sprites[1]));
-    memcpy(sys->rom_sprites[2], desc->roms.sprites_4000_5FFF.ptr, sizeof(sys->rom_sprites[2]));
+    _bombjack_unpack_gfx(sys, desc);
     memcpy(sys->rom_maps[0], desc->roms.maps_0000_0FFF.ptr, sizeof(sys->rom_maps[0]));
 
     /* The VSYNC/VBLANK mainly controls the interrupts (Bombjack generally
@@ -391,6 +459,11 @@ void bombjack_reset(bombjack_t* sys) {
     for (size_t i = 0; i < 3; i++) {
         ay38910_reset(&sys->soundboard.psg[i]);
     }
+    sys->soundboard.psg_num_deferred = 0;
+    sys->mainboard.tick_count = 0;
+    sys->soundboard.tick_count = 0;
+    memset(&sys->sound_latch, 0, sizeof(sys->sound_latch));
+    memset(sys->video.dirty, 0xFF, sizeof(sys->video.dirty));
 }
 
 /* Maintain a color palette cache with 32-bit colors, this is called for
@@ -415,9 +488,21 @@ static inline void _bombjack_update_palette_cache(bombjack_t* sys, uint16_t addr
         uint8_t r = (data & 0x0F) | ((data<<4)&0xF0);
         c = 0xFF000000 | (c & 0x00FF0000) | (g<<8) | r;
     }
+    if (c != sys->mainboard.palette[pal_index]) {
+        // a palette change may affect any screen cell
+        memset(sys->video.dirty, 0xFF, sizeof(sys->video.dirty));
+    }
     sys->mainboard.palette[pal_index] = c;
 }
 
+// track writes to the foreground char and color RAM (0x9000..0x97FF) for the video decoder
+static inline void _bombjack_video_ram_wr(bombjack_t* sys, uint16_t addr, uint8_t data) {
+    if (sys->main_ram[addr - 0x8000] != data) {
+        const uint16_t cell = addr & 0x3FF;
+        sys->video.dirty[cell>>5] |= 1u<<(cell & 31);
+    }
+}
+
 /* main board tick function
 
     Bomb Jack uses memory mapped IO (the Z80's IORQ pin isn't connected).
@@ -481,6 +566,22 @@ static inline void _bombjack_update_palette_cache(bombjack_t* sys, uint16_t addr
     B800:       sound command latch,
 
 */
+/* Queue a sound latch write with the sound board tick at which it
+    happens, the sound board applies the write at exactly that tick
+    (see _bombjack_sound_latch_update()). This is a single-producer
+    single-consumer queue, so that the main and sound board may run on
+    different threads.
+*/
+static void _bombjack_sound_latch_write(bombjack_t* sys, uint8_t data) {
+    const uint32_t head = sys->sound_latch.head;
+    if ((head - _BOMBJACK_LOAD_ACQUIRE(&sys->sound_latch.tail)) < BOMBJACK_SOUND_LATCH_QUEUE_SIZE) {
+        bombjack_sound_latch_write_t* item = &sys->sound_latch.queue[head & (BOMBJACK_SOUND_LATCH_QUEUE_SIZE-1)];
+        item->tick = (sys->mainboard.tick_count * _BOMBJACK_SOUNDBOARD_FREQUENCY) / _BOMBJACK_MAINBOARD_FREQUENCY;
+        item->data = data;
+        _BOMBJACK_STORE_RELEASE(&sys->sound_latch.head, head + 1);
+    }
+}
+
 static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
     // activate NMI pin during VBLANK
     sys->mainboard.vsync_count--;
@@ -517,6 +618,9 @@ static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
             uint8_t data = Z80_GET_DATA(pins);
             if ((addr >= 0x8000) && (addr < 0x9900)) {
                 // regular RAM, video/color RAM, sprite RAM
+                if ((addr >= 0x9000) && (addr < 0x9800)) {
+                    _bombjack_video_ram_wr(sys, addr, data);
+                }
                 mem_wr(&sys->mainboard.mem, addr, data);
             }
             else if ((addr >= 0x9C00) && (addr < 0x9D00)) {
@@ -525,6 +629,9 @@ static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
             }
             else if (addr == 0x9E00) {
                 // background image selection
+                if (sys->mainboard.bg_image != data) {
+                    memset(sys->video.dirty, 0xFF, sizeof(sys->video.dirty));
+                }
                 sys->mainboard.bg_image = data;
             }
             else if (addr == 0xB000) {
@@ -534,7 +641,7 @@ static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
             // FIXME: 0xB004: flip screen
             else if (addr == 0xB800) {
                 // shared sound latch
-                sys->sound_latch = data;
+                _bombjack_sound_latch_write(sys, data);
             }
         }
         else if (pins & Z80_RD) {
@@ -556,6 +663,7 @@ static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
         }
     }
     // the Z80 IORQ pin isn't connected, so no IO instructions need to be handled
+    sys->mainboard.tick_count++;
     return pins;
 }
 
@@ -590,7 +698,65 @@ static uint64_t _bombjack_tick_mainboard(bombjack_t* sys, uint64_t pins) {
     10 .. 11:       2nd AY-3-8910
     80 .. 81:       3rd AY-3-8910
 */
+/*  The PSG outputs only depend on their register state, so the PSG ticks
+    are only counted and rendered in one go before the next PSG access,
+    and at the end of each sound board time slice. All 3 PSGs are ticked
+    in lockstep, so they produce their samples on the same ticks.
+*/
+static void _bombjack_sync_psgs(bombjack_t* sys) {
+    uint32_t num_ticks = sys->soundboard.psg_num_deferred;
+    while (num_ticks > 0) {
+        float samples[3][64];
+        int max_samples = sys->audio.num_samples - sys->audio.sample_pos;
+        if (max_samples > 64) {
+            max_samples = 64;
+        }
+        uint32_t ticks = 0;
+        int num_samples = 0;
+        for (size_t i = 0; i < 3; i++) {
+            ticks = ay38910_render(&sys->soundboard.psg[i], num_ticks, samples[i], max_samples, &num_samples);
+        }
+        num_ticks -= ticks;
+        for (int i = 0; i < num_samples; i++) {
+            float s = samples[0][i] + samples[1][i] + samples[2][i];
+            sys->audio.sample_buffer[sys->audio.sample_pos++] = s * sys->audio.volume;
+        }
+        if (sys->audio.sample_pos == sys->audio.num_samples) {
+            if (sys->audio.callback.func) {
+                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
+            }
+            sys->audio.sample_pos = 0;
+        }
+    }
+    sys->soundboard.psg_num_deferred = 0;
+}
+
+/* Apply all queued sound latch writes up to the current sound board tick,
+    and remember the tick of the next queued write. This is called when
+    the next write is due, and at the start of each sound board time slice
+    (new writes may have been queued in the meantime).
+*/
+static void _bombjack_sound_latch_update(bombjack_t* sys) {
+    uint32_t tail = sys->sound_latch.tail;
+    const uint32_t head = _BOMBJACK_LOAD_ACQUIRE(&sys->sound_latch.head);
+    sys->sound_latch.next_tick = UINT64_MAX;
+    while (tail != head) {
+        const bombjack_sound_latch_write_t* item = &sys->sound_latch.queue[tail & (BOMBJACK_SOUND_LATCH_QUEUE_SIZE-1)];
+        if (item->tick > sys->soundboard.tick_count) {
+            sys->sound_latch.next_tick = item->tick;
+            break;
+        }
+        sys->sound_latch.value = item->data;
+        tail++;
+    }
+    _BOMBJACK_STORE_RELEASE(&sys->sound_latch.tail, tail);
+}
+
 static uint64_t _bombjack_tick_soundboard(bombjack_t* sys, uint64_t pins) {
+    // apply sound latch writes from the main board at their exact tick
+    if (sys->soundboard.tick_count >= sys->sound_latch.next_tick) {
+        _bombjack_sound_latch_update(sys);
+    }
     /* vsync triggers a flip-flop connected to the CPU's NMI, the flip-flop
        is reset on a read from address 0x6000 (this read happens in the
        interrupt service routine
@@ -611,8 +777,8 @@ static uint64_t _bombjack_tick_soundboard(bombjack_t* sys, uint64_t pins) {
         if (pins & Z80_RD) {
             // special case: read and clear sound latch and NMI flip-flop
             if (addr == 0x6000) {
-                Z80_SET_DATA(pins, sys->sound_latch);
-                sys->sound_latch = 0;
+                Z80_SET_DATA(pins, sys->sound_latch.value);
+                sys->sound_latch.value = 0;
                 pins &= ~Z80_NMI;
             }
             else {
@@ -645,26 +811,14 @@ static uint64_t _bombjack_tick_soundboard(bombjack_t* sys, uint64_t pins) {
         if (psg_index < 3) {
             if (pins & Z80_WR) { pins |= AY38910_BDIR; }
             if (0 == (pins & Z80_A0)) { pins |= AY38910_BC1; }
+            _bombjack_sync_psgs(sys);
             pins = ay38910_iorq(&sys->soundboard.psg[psg_index], pins) & Z80_PIN_MASK;
         }
     }
 
-    // tick the AY chips at half CPU frequency
+    // tick the AY chips at half CPU frequency (deferred, see _bombjack_sync_psgs())
     if (sys->soundboard.tick_count++ & 1) {
-        ay38910_tick(&sys->soundboard.psg[2]);
-        ay38910_tick(&sys->soundboard.psg[1]);
-        if (ay38910_tick(&sys->soundboard.psg[0])) {
-            float s = sys->soundboard.psg[0].sample +
-                      sys->soundboard.psg[1].sample +
-                      sys->soundboard.psg[2].sample;
-            sys->audio.sample_buffer[sys->audio.sample_pos++] = s * sys->audio.volume;
-            if (sys->audio.sample_pos == sys->audio.num_samples) {
-                if (sys->audio.callback.func) {
-                    sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
-                }
-                sys->audio.sample_pos = 0;
-            }
-        }
+        sys->soundboard.psg_num_deferred++;
     }
     return pins;
 }
@@ -729,47 +883,30 @@ static uint64_t _bombjack_tick_soundboard(bombjack_t* sys, uint64_t pins) {
 #define BOMBJACK_GATHER16(rom,off) \
     ((uint16_t)rom[0+off]<<8)|((uint16_t)rom[8+off])
 
-static void _bombjack_decode_background(bombjack_t* sys) {
-    uint32_t* ptr = sys->fb;
+// render the 8x8 screen cell at cx,cy of the background layer
+static void _bombjack_decode_background_cell(bombjack_t* sys, size_t cx, size_t cy) {
+    uint32_t* ptr = &sys->fb[(cy * 8) * BOMBJACK_FRAMEBUFFER_WIDTH + (cx * 8)];
     uint16_t img_base_addr = (sys->mainboard.bg_image & 7) * 0x0200;
     bool img_valid = (sys->mainboard.bg_image & 0x10) != 0;
-    for (size_t y = 0; y < 16; y++) {
-        for (size_t x = 0; x < 16; x++) {
-            size_t addr = img_base_addr + (y * 16 + x);
-            // 256 tiles
-            uint8_t tile_code = img_valid ? sys->rom_maps[0][addr] : 0;
-            uint8_t attr = sys->rom_maps[0][addr + 0x0100];
-            uint8_t color_block = (attr & 0x0F)<<3;
-            bool flip_y = (attr & 0x80) != 0;
-            if (flip_y) {
-                ptr += 15*BOMBJACK_FRAMEBUFFER_WIDTH;
-            }
-            // every tile is 32 bytes
-            size_t off = tile_code * 32;
-            for (size_t yy = 0; yy < 16; yy++) {
-                uint16_t bm0 = BOMBJACK_GATHER16(sys->rom_tiles[0], off);
-                uint16_t bm1 = BOMBJACK_GATHER16(sys->rom_tiles[1], off);
-                uint16_t bm2 = BOMBJACK_GATHER16(sys->rom_tiles[2], off);
-                off++;
-                if (yy == 7) {
-                    off += 8;
-                }
-                for (int xx = 15; xx >= 0; xx--) {
-                    uint8_t pen = ((bm2>>xx)&1) | (((bm1>>xx)&1)<<1) | (((bm0>>xx)&1)<<2);
-                    *ptr++ = sys->mainboard.palette[color_block | pen];
-                }
-                ptr += flip_y ? -272 : 240;
-            }
-            if (flip_y) {
-                ptr += BOMBJACK_FRAMEBUFFER_WIDTH + 16;
-            }
-            else {
-                ptr -= (16 * BOMBJACK_FRAMEBUFFER_WIDTH) - 16;
-            }
+    // each 16x16 background tile covers 2x2 screen cells
+    size_t addr = img_base_addr + ((cy>>1) * 16 + (cx>>1));
+    uint8_t tile_code = img_valid ? sys->rom_maps[0][addr] : 0;
+    uint8_t attr = sys->rom_maps[0][addr + 0x0100];
+    uint8_t color_block = (attr & 0x0F)<<3;
+    bool flip_y = (attr & 0x80) != 0;
+    const uint32_t* colors = &sys->mainboard.palette[color_block];
+    for (size_t yy = 0; yy < 8; yy++, ptr += BOMBJACK_FRAMEBUFFER_WIDTH) {
+        // pixel row in the tile
+        size_t ty = (cy & 1) * 8 + yy;
+        if (flip_y) {
+            ty = 15 - ty;
+        }
+        // left or right half of the tile
+        const uint8_t* src = &sys->gfx.tiles[tile_code][ty * 16 + (cx & 1) * 8];
+        for (size_t xx = 0; xx < 8; xx++) {
+            ptr[xx] = colors[src[xx]];
         }
-        ptr += (15 * BOMBJACK_FRAMEBUFFER_WIDTH);
     }
-    CHIPS_ASSERT(ptr == &sys->fb[BOMBJACK_FRAMEBUFFER_WIDTH * BOMBJACK_DISPLAY_HEIGHT]);
 }
 
 /* render foreground tiles
@@ -790,43 +927,27 @@ static void _bombjack_decode_background(bombjack_t* sys) {
     Only 7 foreground colors are possible, since 0 defines a transparent
     pixel.
 */
-static void _bombjack_decode_foreground(bombjack_t* sys) {
-    uint32_t* ptr = sys->fb;
-    // 32x32 tiles, each 8x8
-    for (size_t y = 0; y < 32; y++) {
-        for (size_t x = 0; x < 32; x++) {
-            size_t addr = y * 32 + x;
-            // char codes are at 0x9000, color codes at 0x9400, RAM starts at 0x8000
-            uint8_t chr = sys->main_ram[(0x9000-0x8000) + addr];
-            uint8_t clr = sys->main_ram[(0x9400-0x8000) + addr];
-            // 512 foreground tiles, take 9th bit from color code
-            size_t tile_code = chr | ((clr & 0x10)<<4);
-            // 16 color blocks a 8 colors
-            size_t color_block = (clr & 0x0F)<<3;
-            // 8 bytes per char bitmap
-            size_t off = tile_code * 8;
-            for (size_t yy = 0; yy < 8; yy++) {
-                /* 3 bit planes per char (8 colors per pixel within
-                   the palette color block of the char
-                */
-                uint8_t bm0 = sys->rom_chars[0][off];
-                uint8_t bm1 = sys->rom_chars[1][off];
-                uint8_t bm2 = sys->rom_chars[2][off];
-                off++;
-                for (int xx = 7; xx >= 0; xx--) {
-                    uint8_t pen = ((bm2>>xx)&1) | (((bm1>>xx)&1)<<1) | (((bm0>>xx)&1)<<2);
-                    if (pen) {
-                        *ptr = sys->mainboard.palette[color_block | pen];
-                    }
-                    ptr++;
-                }
-                ptr += 248;
+// render the 8x8 screen cell at cx,cy of the foreground layer
+static void _bombjack_decode_foreground_cell(bombjack_t* sys, size_t cx, size_t cy) {
+    uint32_t* ptr = &sys->fb[(cy * 8) * BOMBJACK_FRAMEBUFFER_WIDTH + (cx * 8)];
+    size_t addr = cy * 32 + cx;
+    // char codes are at 0x9000, color codes at 0x9400, RAM starts at 0x8000
+    uint8_t chr = sys->main_ram[(0x9000-0x8000) + addr];
+    uint8_t clr = sys->main_ram[(0x9400-0x8000) + addr];
+    // 512 foreground tiles, take 9th bit from color code
+    size_t tile_code = chr | ((clr & 0x10)<<4);
+    // 16 color blocks a 8 colors
+    const uint32_t* colors = &sys->mainboard.palette[(clr & 0x0F)<<3];
+    const uint8_t* src = sys->gfx.chars[tile_code];
+    for (size_t yy = 0; yy < 8; yy++, src += 8, ptr += BOMBJACK_FRAMEBUFFER_WIDTH) {
+        for (size_t xx = 0; xx < 8; xx++) {
+            // pen 0 is transparent
+            const uint8_t pen = src[xx];
+            if (pen) {
+                ptr[xx] = colors[pen];
             }
-            ptr -= (8 * BOMBJACK_FRAMEBUFFER_WIDTH) - 8;
         }
-        ptr += (7 * BOMBJACK_FRAMEBUFFER_WIDTH);
     }
-    CHIPS_ASSERT(ptr == &sys->fb[BOMBJACK_FRAMEBUFFER_WIDTH * BOMBJACK_DISPLAY_HEIGHT]);
 }
 
 /*  render sprites
@@ -846,11 +967,78 @@ static void _bombjack_decode_foreground(bombjack_t* sys) {
     X:  x pos
     Y:  y pos
 */
-#define BOMBJACK_GATHER32(rom,off) \
-    ((uint32_t)rom[0+off]<<24)|\
-    ((uint32_t)rom[8+off]<<16)|\
-    ((uint32_t)rom[32+off]<<8)|\
-    ((uint32_t)rom[40+off])
+
+/* Decode the char, tile and sprite ROMs into one byte per pixel, so
+    that the video decoder doesn't need to combine the 3 bitmaps of each
+    pixel in every frame. Each byte holds the 3-bit pen, 0 is transparent
+    for foreground chars and sprites.
+
+    The sprite ROM is decoded as 256 16x16 sprites (same layout as the
+    background tiles), the 32x32 sprites are made of 4 consecutive
+    16x16 sprites (top-left, top-right, bottom-left, bottom-right).
+*/
+static void _bombjack_unpack_gfx(bombjack_t* sys, const bombjack_desc_t* desc) {
+    const uint8_t* chars[3] = {
+        (const uint8_t*) desc->roms.chars_0000_0FFF.ptr,
+        (const uint8_t*) desc->roms.chars_1000_1FFF.ptr,
+        (const uint8_t*) desc->roms.chars_2000_2FFF.ptr,
+    };
+    const uint8_t* tiles[3] = {
+        (const uint8_t*) desc->roms.tiles_0000_1FFF.ptr,
+        (const uint8_t*) desc->roms.tiles_2000_3FFF.ptr,
+        (const uint8_t*) desc->roms.tiles_4000_5FFF.ptr,
+    };
+    const uint8_t* sprites[3] = {
+        (const uint8_t*) desc->roms.sprites_0000_1FFF.ptr,
+        (const uint8_t*) desc->roms.sprites_2000_3FFF.ptr,
+        (const uint8_t*) desc->roms.sprites_4000_5FFF.ptr,
+    };
+    // 512 chars with 8x8 pixels, 8 bytes per bitmap
+    for (size_t i = 0; i < 512; i++) {
+        for (size_t y = 0; y < 8; y++) {
+            const size_t off = i * 8 + y;
+            for (size_t x = 0; x < 8; x++) {
+                const int b = 7 - (int)x;
+                sys->gfx.chars[i][y * 8 + x] = ((chars[2][off]>>b)&1) | (((chars[1][off]>>b)&1)<<1) | (((chars[0][off]>>b)&1)<<2);
+            }
+        }
+    }
+    // 256 tiles and sprites with 16x16 pixels, 32 bytes per bitmap
+    for (size_t i = 0; i < 256; i++) {
+        for (size_t y = 0; y < 16; y++) {
+            const size_t off = i * 32 + y + ((y >= 8) ? 8 : 0);
+            const uint16_t tbm0 = BOMBJACK_GATHER16(tiles[0], off);
+            const uint16_t tbm1 = BOMBJACK_GATHER16(tiles[1], off);
+            const uint16_t tbm2 = BOMBJACK_GATHER16(tiles[2], off);
+            const uint16_t sbm0 = BOMBJACK_GATHER16(sprites[0], off);
+            const uint16_t sbm1 = BOMBJACK_GATHER16(sprites[1], off);
+            const uint16_t sbm2 = BOMBJACK_GATHER16(sprites[2], off);
+            for (size_t x = 0; x < 16; x++) {
+                const int b = 15 - (int)x;
+                sys->gfx.tiles[i][y * 16 + x] = ((tbm2>>b)&1) | (((tbm1>>b)&1)<<1) | (((tbm0>>b)&1)<<2);
+                sys->gfx.sprites[i][y * 16 + x] = ((sbm2>>b)&1) | (((sbm1>>b)&1)<<1) | (((sbm0>>b)&1)<<2);
+            }
+        }
+    }
+}
+
+/* Mark the screen cells covered by a sprite as dirty, so that the
+    background and foreground layers are restored there in the next frame.
+    Sprites wrap around into the next framebuffer line at the right border,
+    and 16x16 sprites with flip-x start one line lower, so this may mark
+    a few more cells than necessary.
+*/
+static void _bombjack_sprite_dirty(bombjack_t* sys, size_t px, size_t py, size_t size) {
+    for (size_t x = px & ~7; x < (px + size); x += 8) {
+        const size_t wrap = x >> 8;
+        const uint32_t mask = 1u << ((x>>3) & 31);
+        for (size_t y = (py + wrap) & ~7; y <= (py + size + wrap); y += 8) {
+            if (y < BOMBJACK_DISPLAY_HEIGHT) {
+                sys->video.dirty[y>>3] |= mask;
+            }
+        }
+    }
+}
 
 static void _bombjack_decode_sprites(bombjack_t* sys) {
     uint32_t* dst = sys->fb;
@@ -862,165 +1050,164 @@ static void _bombjack_decode_sprites(bombjack_t* sys) {
         uint8_t b1 = sys->main_ram[addr + 1];
         uint8_t b2 = sys->main_ram[addr + 2];
         uint8_t b3 = sys->main_ram[addr + 3];
-        uint8_t color_block = (b1 & 0x0F)<<3;
+        const uint32_t* colors = &sys->mainboard.palette[(b1 & 0x0F)<<3];
 
         // screen is 90 degree rotated, so x and y are switched
         uint8_t px = b3;
         uint8_t sprite_code = b0 & 0x7F;
         if (b0 & 0x80) {
-            // 32x32 'large' sprites (no flip-x/y needed)
+            // 32x32 'large' sprites (no flip-x/y needed), made of 4 16x16 sprites
             uint8_t py = 225 - b2;
+            _bombjack_sprite_dirty(sys, px, py, 32);
             uint32_t* ptr = dst + py*BOMBJACK_FRAMEBUFFER_WIDTH + px;
-            // offset into sprite ROM to gather sprite bitmap pixels
-            size_t off = sprite_code * 128;
-            for (size_t y = 0; y < 32; y++) {
-                uint32_t bm0 = BOMBJACK_GATHER32(sys->rom_sprites[0], off);
-                uint32_t bm1 = BOMBJACK_GATHER32(sys->rom_sprites[1], off);
-                uint32_t bm2 = BOMBJACK_GATHER32(sys->rom_sprites[2], off);
-                off++;
-                if ((y & 7) == 7) {
-                    off += 8;
-                }
-                if ((y & 15) == 15) {
-                    off += 32;
-                }
-                for (int x = 31; x >= 0; x--) {
-                    uint8_t pen = ((bm2>>x)&1) | (((bm1>>x)&1)<<1) | (((bm0>>x)&1)<<2);
+            const uint8_t* src = sys->gfx.sprites[(sprite_code & 0x3F) * 4];
+            for (size_t y = 0; y < 32; y++, ptr += BOMBJACK_FRAMEBUFFER_WIDTH) {
+                for (size_t x = 0; x < 32; x++) {
+                    const uint8_t pen = src[(((y>>4)*2 + (x>>4)) * 256) + (y & 15) * 16 + (x & 15)];
                     if (0 != pen) {
-                        CHIPS_ASSERT((ptr >= &sys->fb[0]) && (ptr < &sys->fb[BOMBJACK_FRAMEBUFFER_WIDTH*BOMBJACK_FRAMEBUFFER_HEIGHT]));
-                        *ptr = sys->mainboard.palette[color_block | pen];
+                        CHIPS_ASSERT((&ptr[x] >= &sys->fb[0]) && (&ptr[x] < &sys->fb[BOMBJACK_FRAMEBUFFER_WIDTH*BOMBJACK_FRAMEBUFFER_HEIGHT]));
+                        ptr[x] = colors[pen];
                     }
-                    ptr++;
                 }
-                ptr += 224;
             }
         }
         else {
             // 16*16 sprites are decoded like 16x16 background tiles
             uint8_t py = 241 - b2;
+            _bombjack_sprite_dirty(sys, px, py, 16);
             uint32_t* ptr = dst + py*BOMBJACK_FRAMEBUFFER_WIDTH + px;
             bool flip_x = (b1 & 0x80) != 0;
             bool flip_y = (b1 & 0x40) != 0;
             if (flip_x) {
                 ptr += 16*BOMBJACK_FRAMEBUFFER_WIDTH;
             }
-            // offset into sprite ROM to gather sprite bitmap pixels
-            size_t off = sprite_code * 32;
-            for (size_t y = 0; y < 16; y++) {
-                uint16_t bm0 = BOMBJACK_GATHER16(sys->rom_sprites[0], off);
-                uint16_t bm1 = BOMBJACK_GATHER16(sys->rom_sprites[1], off);
-                uint16_t bm2 = BOMBJACK_GATHER16(sys->rom_sprites[2], off);
-                off++;
-                if (y == 7) {
-                    off += 8;
-                }
-                if (flip_y) {
-                    for (size_t x=0; x<=15; x++) {
-                        uint8_t pen = ((bm2>>x)&1) | (((bm1>>x)&1)<<1) | (((bm0>>x)&1)<<2);
-                        if (0 != pen) {
-                            CHIPS_ASSERT((ptr >= &sys->fb[0]) && (ptr < &sys->fb[BOMBJACK_FRAMEBUFFER_WIDTH*BOMBJACK_FRAMEBUFFER_HEIGHT]));
-                            *ptr = sys->mainboard.palette[color_block | pen];
-                        }
-                        ptr++;
+            const uint8_t* src = sys->gfx.sprites[sprite_code];
+            for (size_t y = 0; y < 16; y++, src += 16) {
+                for (size_t x = 0; x < 16; x++) {
+                    const uint8_t pen = src[flip_y ? (15 - x) : x];
+                    if (0 != pen) {
+                        CHIPS_ASSERT((&ptr[x] >= &sys->fb[0]) && (&ptr[x] < &sys->fb[BOMBJACK_FRAMEBUFFER_WIDTH*BOMBJACK_FRAMEBUFFER_HEIGHT]));
+                        ptr[x] = colors[pen];
                     }
                 }
+                if (flip_x) {
+                    ptr -= BOMBJACK_FRAMEBUFFER_WIDTH;
+                }
                 else {
-                    for (int x=15; x>=0; x--) {
-                        uint8_t pen = ((bm2>>x)&1) | (((bm1>>x)&1)<<1) | (((bm0>>x)&1)<<2);
-                        if (0 != pen) {
-                            CHIPS_ASSERT((ptr >= &sys->fb[0]) && (ptr < &sys->fb[BOMBJACK_FRAMEBUFFER_WIDTH*BOMBJACK_FRAMEBUFFER_HEIGHT]));
-                            *ptr = sys->mainboard.palette[color_block | pen];
-                        }
-                        ptr++;
-                    }
+                    ptr += BOMBJACK_FRAMEBUFFER_WIDTH;
                 }
-                ptr += flip_x ? -272 : 240;
             }
         }
     }
 }
 
+/* decode the video frame
+
+    The background and foreground layers are only decoded for 8x8 screen
+    cells which may have changed since the last frame. A cell is dirty
+    when its foreground char or color byte has been written with a new
+    value, or when it has been overdrawn by a sprite in the last frame.
+    A palette change, a new background image or changed debug layer
+    flags redraw all cells. Sprites are drawn on top each frame.
+*/
 static void _bombjack_decode_video(bombjack_t* sys) {
-    if (sys->dbg.draw_background_layer) {
-        _bombjack_decode_background(sys);
+    const uint8_t layers = (sys->dbg.draw_background_layer ? 1 : 0) |
+                           (sys->dbg.draw_foreground_layer ? 2 : 0) |
+                           (sys->dbg.draw_sprite_layer ? 4 : 0) |
+                           (sys->dbg.clear_background_layer ? 8 : 0);
+    if (layers != sys->video.layers) {
+        sys->video.layers = layers;
+        memset(sys->video.dirty, 0xFF, sizeof(sys->video.dirty));
     }
-    else {
-        if (sys->dbg.clear_background_layer) {
-            for (size_t i = 0; i < BOMBJACK_FRAMEBUFFER_WIDTH*BOMBJACK_DISPLAY_HEIGHT; i++) {
-                sys->fb[i] = 0xFF000000;
+    for (size_t cy = 0; cy < 32; cy++) {
+        const uint32_t dirty = sys->video.dirty[cy];
+        if (0 == dirty) {
+            continue;
+        }
+        for (size_t cx = 0; cx < 32; cx++) {
+            if (0 == (dirty & (1u<<cx))) {
+                continue;
+            }
+            if (sys->dbg.draw_background_layer) {
+                _bombjack_decode_background_cell(sys, cx, cy);
+            }
+            else if (sys->dbg.clear_background_layer) {
+                uint32_t* ptr = &sys->fb[(cy * 8) * BOMBJACK_FRAMEBUFFER_WIDTH + (cx * 8)];
+                for (size_t yy = 0; yy < 8; yy++, ptr += BOMBJACK_FRAMEBUFFER_WIDTH) {
+                    for (size_t xx = 0; xx < 8; xx++) {
+                        ptr[xx] = 0xFF000000;
+                    }
+                }
+            }
+            if (sys->dbg.draw_foreground_layer) {
+                _bombjack_decode_foreground_cell(sys, cx, cy);
             }
         }
-    }
-    if (sys->dbg.draw_foreground_layer) {
-        _bombjack_decode_foreground(sys);
+        sys->video.dirty[cy] = 0;
     }
     if (sys->dbg.draw_sprite_layer) {
         _bombjack_decode_sprites(sys);
     }
 }
 
-uint32_t bombjack_exec(bombjack_t* sys, uint32_t micro_seconds) {
+uint32_t bombjack_exec_mainboard(bombjack_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
-    /* Run the main board and sound board interleaved for half a frame.
-       This simplifies the communication via the sound latch (the main CPU
-       writes a command byte to the sound latch, the sound board reads
-       the command latch in its interrupt service routine.
-
-       The main board issues at most one command per 60Hz frame, but since the
-       host machine is also running at roughly 60 Hz it may happen that the
-       main board writes 2 sound commands per host frame. For this reason
-       run the 2 boards interleaved for half a frame, so it is guaranteed
-       that at most one sound command can be written by the main board
-       before the sound board is ticked (that way we don't need to implement
-       a complicated command queue.
-
-       NOTE: with the new cycle-stepped Z80 we could just as well do
-       a much more finer grained interleaving (e.g. per tick), but this
-       turns out to be quite a bit slower.
-    */
-    const uint32_t slice_us = micro_seconds/2;
-    const uint32_t mb_num_ticks = clk_us_to_ticks(_BOMBJACK_MAINBOARD_FREQUENCY, slice_us);
-    const uint32_t sb_num_ticks = clk_us_to_ticks(_BOMBJACK_SOUNDBOARD_FREQUENCY, slice_us);
-    for (size_t i = 0; i < 2; i++) {
-        // tick the main board for one half frame
-        {
-            uint64_t pins = sys->mainboard.pins;
-            if (0 == sys->dbg.debug.mainboard.callback.func) {
-                // run without debug callback
-                for (uint32_t tick = 0; tick < mb_num_ticks; tick++) {
-                    pins = _bombjack_tick_mainboard(sys, pins);
-                }
-            }
-            else {
-                // run with debug callback
-                for (uint32_t tick = 0; (tick < mb_num_ticks) && !(*sys->dbg.debug.mainboard.stopped); tick++) {
-                    pins = _bombjack_tick_mainboard(sys, pins);
-                    sys->dbg.debug.mainboard.callback.func(sys->dbg.debug.mainboard.callback.user_data, pins);
-                }
-            }
-            sys->mainboard.pins = pins;
+    const uint32_t num_ticks = clk_us_to_ticks(_BOMBJACK_MAINBOARD_FREQUENCY, micro_seconds);
+    uint64_t pins = sys->mainboard.pins;
+    if (0 == sys->dbg.debug.mainboard.callback.func) {
+        // run without debug callback
+        for (uint32_t tick = 0; tick < num_ticks; tick++) {
+            pins = _bombjack_tick_mainboard(sys, pins);
         }
-        // tick the sound board for one half frame
-        {
-            uint64_t pins = sys->soundboard.pins;
-            if (0 == sys->dbg.debug.soundboard.callback.func) {
-                // run without debug callback
-                for (uint32_t tick = 0; tick < sb_num_ticks; tick++) {
-                    pins = _bombjack_tick_soundboard(sys, pins);
-                }
-            }
-            else {
-                // run with debug callback
-                for (uint32_t tick = 0; (tick < sb_num_ticks) && !(*sys->dbg.debug.soundboard.stopped); tick++) {
-                    pins = _bombjack_tick_soundboard(sys, pins);
-                    sys->dbg.debug.soundboard.callback.func(sys->dbg.debug.soundboard.callback.user_data, pins);
-                }
-            }
-            sys->soundboard.pins = pins;
+    }
+    else {
+        // run with debug callback
+        for (uint32_t tick = 0; (tick < num_ticks) && !(*sys->dbg.debug.mainboard.stopped); tick++) {
+            pins = _bombjack_tick_mainboard(sys, pins);
+            sys->dbg.debug.mainboard.callback.func(sys->dbg.debug.mainboard.callback.user_data, pins);
         }
     }
+    sys->mainboard.pins = pins;
     _bombjack_decode_video(sys);
-    return 2 * (mb_num_ticks + sb_num_ticks);
+    return num_ticks;
+}
+
+uint32_t bombjack_exec_soundboard(bombjack_t* sys, uint32_t micro_seconds) {
+    CHIPS_ASSERT(sys && sys->valid);
+    const uint32_t num_ticks = clk_us_to_ticks(_BOMBJACK_SOUNDBOARD_FREQUENCY, micro_seconds);
+    // pick up the sound latch writes queued since the last time slice
+    _bombjack_sound_latch_update(sys);
+    uint64_t pins = sys->soundboard.pins;
+    if (0 == sys->dbg.debug.soundboard.callback.func) {
+        // run without debug callback
+        for (uint32_t tick = 0; tick < num_ticks; tick++) {
+            pins = _bombjack_tick_soundboard(sys, pins);
+        }
+    }
+    else {
+        // run with debug callback
+        for (uint32_t tick = 0; (tick < num_ticks) && !(*sys->dbg.debug.soundboard.stopped); tick++) {
+            pins = _bombjack_tick_soundboard(sys, pins);
+            // the debugger may inspect the PSGs
+            _bombjack_sync_psgs(sys);
+            sys->dbg.debug.soundboard.callback.func(sys->dbg.debug.soundboard.callback.user_data, pins);
+        }
+    }
+    _bombjack_sync_psgs(sys);
+    sys->soundboard.pins = pins;
+    return num_ticks;
+}
+
+uint32_t bombjack_exec(bombjack_t* sys, uint32_t micro_seconds) {
+    CHIPS_ASSERT(sys && sys->valid);
+    /* The main board only communicates with the sound board through the
+       sound latch, and latch writes are applied on the sound board at
+       their exact tick, so the main board can run first for the whole
+       time slice, followed by the sound board.
+    */
+    uint32_t num_ticks = bombjack_exec_mainboard(sys, micro_seconds);
+    num_ticks += bombjack_exec_soundboard(sys, micro_seconds);
+    return num_ticks;
 }
 
 chips_display_info_t bombjack_display_info(bombjack_t* sys) {
@@ -1077,6 +1264,7 @@ bool bombjack_load_snapshot(bombjack_t* sys, uint32_t version, bombjack_t* src)
     }
     mem_snapshot_onload(&im.mainboard.mem, sys);
     mem_snapshot_onload(&im.soundboard.mem, sys);
+    memset(im.video.dirty, 0xFF, sizeof(im.video.dirty));
     *sys = im;
     return true;
 }
@@ -18,6 +18,22 @@
     ~~~
         your own assert macro (default: assert(c))
 
+    ~~~C
+    CHIPS_SHARED_ROMS
+    ~~~
+        if defined, the ROM images in c64_desc_t.roms are mapped directly
+        instead of being copied into c64_t, the ROM data must outlive the
+        emulator instance, snapshots only contain an identity hash of the
+        ROM images (NOTE: the C1541 ROM is still copied)
+
+    ~~~C
+    C64_SID_PER_TICK
+    ~~~
+        if defined, the SID is ticked together with the CPU on every tick,
+        otherwise SID ticks are deferred until the SID is accessed (or
+        until the end of c64_exec()) and then generated in one go with
+        m6581_run(), the audio output is identical in both cases
+
     You need to include the following headers before including c64.h:
 
     - chips/chips_common.h
@@ -252,7 +268,7 @@ extern "C" {
 #endif
 
 // bump snapshot version when c64_t memory layout changes
-#define C64_SNAPSHOT_VERSION (1)
+#define C64_SNAPSHOT_VERSION (6)
 
 #define C64_FREQUENCY (985248)              // clock frequency in Hz
 #define C64_MAX_AUDIO_SAMPLES (1024)        // max number of audio samples in internal sample buffer
@@ -339,13 +355,24 @@ typedef struct {
     } roms;
 } c64_desc_t;
 
+// deferred CIA ticks, see _c64_tick_cia()
+typedef struct {
+    uint64_t in_pins;           // input pins of the last executed tick
+    uint64_t out_pins;          // output pins of the last executed tick
+    uint32_t idle_ticks;        // number of following ticks which can be deferred
+    uint32_t num_deferred;      // number of currently deferred ticks
+} c64_cia_idle_t;
+
 // C64 emulator state
 typedef struct {
     m6502_t cpu;
     m6526_t cia_1;
     m6526_t cia_2;
+    c64_cia_idle_t cia_1_idle;
+    c64_cia_idle_t cia_2_idle;
     m6569_t vic;
     m6581_t sid;
+    uint32_t sid_num_deferred;  // number of deferred SID ticks, see _c64_sync_sid()
     uint64_t pins;
 
     c64_joystick_type_t joystick_type;
@@ -362,6 +389,11 @@ typedef struct {
     kbd_t kbd;                  // keyboard matrix state
     mem_t mem_cpu;              // CPU-visible memory mapping
     mem_t mem_vic;              // VIC-visible memory mapping
+    // precomputed CPU memory mapping of A000..FFFF for each LORAM/HIRAM/CHAREN combination
+    struct {
+        mem_page_t pages[0x6000 / MEM_PAGE_SIZE];
+        bool io_mapped;
+    } mem_configs[8];
     bool valid;
     chips_debug_t debug;
 
@@ -374,9 +406,16 @@ typedef struct {
 
     uint8_t color_ram[1024];        // special static color ram
     uint8_t ram[1<<16];             // general ram
+    #if defined(CHIPS_SHARED_ROMS)
+    const uint8_t* rom_char;        // 4 KB character ROM image
+    const uint8_t* rom_basic;       // 8 KB BASIC ROM image
+    const uint8_t* rom_kernal;      // 8 KB KERNAL V3 ROM image
+    uint32_t rom_id;                // identity hash of ROM images, checked in c64_load_snapshot()
+    #else
     uint8_t rom_char[0x1000];       // 4 KB character ROM image
     uint8_t rom_basic[0x2000];      // 8 KB BASIC ROM image
     uint8_t rom_kernal[0x2000];     // 8 KB KERNAL V3 ROM image
+    #endif
     alignas(64) uint8_t fb[M6569_FRAMEBUFFER_SIZE_BYTES];
 
     c1530_t c1530;      // optional datassette
@@ -459,12 +498,21 @@ void c64_init(c64_t* sys, const c64_desc_t* desc) {
     sys->audio.callback = desc->audio.callback;
     sys->audio.num_samples = _C64_DEFAULT(desc->audio.num_samples, C64_DEFAULT_AUDIO_SAMPLES);
     CHIPS_ASSERT(sys->audio.num_samples <= C64_MAX_AUDIO_SAMPLES);
-    CHIPS_ASSERT(desc->roms.chars.ptr && (desc->roms.chars.size == sizeof(sys->rom_char)));
-    CHIPS_ASSERT(desc->roms.basic.ptr && (desc->roms.basic.size == sizeof(sys->rom_basic)));
-    CHIPS_ASSERT(desc->roms.kernal.ptr && (desc->roms.kernal.size == sizeof(sys->rom_kernal)));
+    CHIPS_ASSERT(desc->roms.chars.ptr && (desc->roms.chars.size == 0x1000));
+    CHIPS_ASSERT(desc->roms.basic.ptr && (desc->roms.basic.size == 0x2000));
+    CHIPS_ASSERT(desc->roms.kernal.ptr && (desc->roms.kernal.size == 0x2000));
+    #if defined(CHIPS_SHARED_ROMS)
+    sys->rom_char = (const uint8_t*) desc->roms.chars.ptr;
+    sys->rom_basic = (const uint8_t*) desc->roms.basic.ptr;
+    sys->rom_kernal = (const uint8_t*) desc->roms.kernal.ptr;
+    sys->rom_id = mem_rom_id(0, sys->rom_char, 0x1000);
+    sys->rom_id = mem_rom_id(sys->rom_id, sys->rom_basic, 0x2000);
+    sys->rom_id = mem_rom_id(sys->rom_id, sys->rom_kernal, 0x2000);
+    #else
     memcpy(sys->rom_char, desc->roms.chars.ptr, sizeof(sys->rom_char));
     memcpy(sys->rom_basic, desc->roms.basic.ptr, sizeof(sys->rom_basic));
     memcpy(sys->rom_kernal, desc->roms.kernal.ptr, sizeof(sys->rom_kernal));
+    #endif
 
     // initialize the hardware
     sys->cpu_port = 0xF7;       // for initial memory mapping
@@ -539,8 +587,84 @@ void c64_reset(c64_t* sys) {
     sys->pins |= M6502_RES;
     m6526_reset(&sys->cia_1);
     m6526_reset(&sys->cia_2);
+    memset(&sys->cia_1_idle, 0, sizeof(sys->cia_1_idle));
+    memset(&sys->cia_2_idle, 0, sizeof(sys->cia_2_idle));
     m6569_reset(&sys->vic);
     m6581_reset(&sys->sid);
+    sys->sid_num_deferred = 0;
+}
+
+/*
+    Deferred CIA ticks:
+
+    Most of the time both CIAs only count down their timers (or do nothing
+    at all when the timers are stopped). After each executed CIA tick, the
+    number of following ticks which can't change the CIA output pins is
+    queried with m6526_cycles_until_event(). As long as the CIA isn't
+    accessed and its port and FLAG inputs don't change, the following ticks
+    are only counted and the previous output pins are reused. The deferred
+    ticks are caught up with m6526_advance() before the next executed tick,
+    and at the end of c64_exec().
+*/
+#define _C64_CIA_IN_PINS (M6526_CS|M6526_FLAG|M6526_PA_PINS|M6526_PB_PINS)
+#define _C64_CIA_OUT_PINS (M6526_IRQ|M6526_PA_PINS|M6526_PB_PINS)
+
+static void _c64_sync_cia(m6526_t* cia, c64_cia_idle_t* idle) {
+    if (idle->num_deferred > 0) {
+        m6526_advance(cia, idle->in_pins, idle->num_deferred);
+        idle->num_deferred = 0;
+    }
+}
+
+static void _c64_sync_cias(c64_t* sys) {
+    _c64_sync_cia(&sys->cia_1, &sys->cia_1_idle);
+    _c64_sync_cia(&sys->cia_2, &sys->cia_2_idle);
+}
+
+static inline uint64_t _c64_tick_cia(m6526_t* cia, c64_cia_idle_t* idle, uint64_t pins) {
+    if ((idle->idle_ticks > 0) && (0 == ((pins ^ idle->in_pins) & _C64_CIA_IN_PINS))) {
+        idle->idle_ticks--;
+        idle->num_deferred++;
+        return (pins & ~_C64_CIA_OUT_PINS) | (idle->out_pins & _C64_CIA_OUT_PINS);
+    }
+    _c64_sync_cia(cia, idle);
+    const uint64_t in_pins = pins & ~M6526_CS;
+    pins = m6526_tick(cia, pins);
+    idle->in_pins = in_pins;
+    idle->out_pins = pins;
+    idle->idle_ticks = m6526_cycles_until_event(cia, in_pins) - 1;
+    return pins;
+}
+
+/*
+    Deferred SID ticks:
+
+    The SID output only depends on its register state, so SID ticks without
+    register access are only counted and generated in one go by
+    m6581_run() before the next register access, and at the end of
+    c64_exec().
+*/
+static void _c64_push_audio(c64_t* sys, int num_samples) {
+    sys->audio.sample_pos += num_samples;
+    if (sys->audio.sample_pos == sys->audio.num_samples) {
+        if (sys->audio.callback.func) {
+            sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
+        }
+        sys->audio.sample_pos = 0;
+    }
+}
+
+static void _c64_sync_sid(c64_t* sys) {
+    uint32_t num_ticks = sys->sid_num_deferred;
+    while (num_ticks > 0) {
+        int num_samples = 0;
+        num_ticks -= m6581_run(&sys->sid, num_ticks,
+            &sys->audio.sample_buffer[sys->audio.sample_pos],
+            sys->audio.num_samples - sys->audio.sample_pos,
+            &num_samples);
+        _c64_push_audio(sys, num_samples);
+    }
+    sys->sid_num_deferred = 0;
 }
 
 static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
@@ -605,17 +729,21 @@ static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
     }
 
     // tick the SID
-    {
+    #if defined(C64_SID_PER_TICK)
+    const bool sid_deferred = false;
+    #else
+    const bool sid_deferred = 0 == (sid_pins & M6581_CS);
+    #endif
+    if (sid_deferred) {
+        sys->sid_num_deferred++;
+    }
+    else {
+        _c64_sync_sid(sys);
         sid_pins = m6581_tick(&sys->sid, sid_pins);
         if (sid_pins & M6581_SAMPLE) {
             // new audio sample ready
-            sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->sid.sample;
-            if (sys->audio.sample_pos == sys->audio.num_samples) {
-                if (sys->audio.callback.func) {
-                    sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
-                }
-                sys->audio.sample_pos = 0;
-            }
+            sys->audio.sample_buffer[sys->audio.sample_pos] = sys->sid.sample;
+            _c64_push_audio(sys, 1);
         }
         if ((sid_pins & (M6581_CS|M6581_RW)) == (M6581_CS|M6581_RW)) {
             pins = M6502_COPY_DATA(pins, sid_pins);
@@ -643,7 +771,7 @@ static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
         if (sys->cas_port & C64_CASPORT_READ) {
             cia1_pins |= M6526_FLAG;
         }
-        cia1_pins = m6526_tick(&sys->cia_1, cia1_pins);
+        cia1_pins = _c64_tick_cia(&sys->cia_1, &sys->cia_1_idle, cia1_pins);
         const uint8_t kbd_lines = ~M6526_GET_PA(cia1_pins);
         kbd_set_active_lines(&sys->kbd, kbd_lines);
         if (cia1_pins & M6502_IRQ) {
@@ -677,7 +805,7 @@ static uint64_t _c64_tick(c64_t* sys, uint64_t pins) {
     */
     {
         M6526_SET_PAB(cia2_pins, 0xFF, 0xFF);
-        cia2_pins = m6526_tick(&sys->cia_2, cia2_pins);
+        cia2_pins = _c64_tick_cia(&sys->cia_2, &sys->cia_2_idle, cia2_pins);
         sys->vic_bank_select = ((~M6526_GET_PA(cia2_pins))&3)<<14;
         if (cia2_pins & M6502_IRQ) {
             pins |= M6502_NMI;
@@ -797,16 +925,21 @@ static uint16_t _c64_vic_fetch(uint16_t addr, void* user_data) {
     return data;
 }
 
-static void _c64_update_memory_map(c64_t* sys) {
-    sys->io_mapped = false;
-    uint8_t* read_ptr;
+/*
+    Map the A000..FFFF area for a LORAM/HIRAM/CHAREN combination, this is
+    only called at initialization to fill the sys->mem_configs cache, the
+    memory mapping is switched with _c64_update_memory_map()
+*/
+static bool _c64_map_config(c64_t* sys, uint8_t cpu_port) {
+    bool io_mapped = false;
+    const uint8_t* read_ptr;
     // shortcut if HIRAM and LORAM is 0, everything is RAM
-    if ((sys->cpu_port & (C64_CPUPORT_HIRAM|C64_CPUPORT_LORAM)) == 0) {
+    if ((cpu_port & (C64_CPUPORT_HIRAM|C64_CPUPORT_LORAM)) == 0) {
         mem_map_ram(&sys->mem_cpu, 0, 0xA000, 0x6000, sys->ram+0xA000);
     }
     else {
         // A000..BFFF is either RAM-behind-BASIC-ROM or RAM
-        if ((sys->cpu_port & (C64_CPUPORT_HIRAM|C64_CPUPORT_LORAM)) == (C64_CPUPORT_HIRAM|C64_CPUPORT_LORAM)) {
+        if ((cpu_port & (C64_CPUPORT_HIRAM|C64_CPUPORT_LORAM)) == (C64_CPUPORT_HIRAM|C64_CPUPORT_LORAM)) {
             read_ptr = sys->rom_basic;
         }
         else {
@@ -815,7 +948,7 @@ static void _c64_update_memory_map(c64_t* sys) {
         mem_map_rw(&sys->mem_cpu, 0, 0xA000, 0x2000, read_ptr, sys->ram+0xA000);
 
         // E000..FFFF is either RAM-behind-KERNAL-ROM or RAM
-        if (sys->cpu_port & C64_CPUPORT_HIRAM) {
+        if (cpu_port & C64_CPUPORT_HIRAM) {
             read_ptr = sys->rom_kernal;
         }
         else {
@@ -823,14 +956,29 @@ static void _c64_update_memory_map(c64_t* sys) {
         }
         mem_map_rw(&sys->mem_cpu, 0, 0xE000, 0x2000, read_ptr, sys->ram+0xE000);
 
-        // D000..DFFF can be Char-ROM or I/O
-        if  (sys->cpu_port & C64_CPUPORT_CHAREN) {
-            sys->io_mapped = true;
+        // D000..DFFF can be Char-ROM or I/O (with the RAM mapped behind the I/O area)
+        if  (cpu_port & C64_CPUPORT_CHAREN) {
+            io_mapped = true;
+            mem_map_ram(&sys->mem_cpu, 0, 0xD000, 0x1000, sys->ram+0xD000);
         }
         else {
             mem_map_rw(&sys->mem_cpu, 0, 0xD000, 0x1000, sys->rom_char, sys->ram+0xD000);
         }
     }
+    return io_mapped;
+}
+
+static void _c64_init_memory_configs(c64_t* sys) {
+    for (uint8_t i = 0; i < 8; i++) {
+        sys->mem_configs[i].io_mapped = _c64_map_config(sys, i);
+        mem_get_pages(&sys->mem_cpu, 0, 0xA000, 0x6000, sys->mem_configs[i].pages);
+    }
+}
+
+static void _c64_update_memory_map(c64_t* sys) {
+    const uint8_t i = sys->cpu_port & (C64_CPUPORT_CHAREN|C64_CPUPORT_HIRAM|C64_CPUPORT_LORAM);
+    mem_map_pages(&sys->mem_cpu, 0, 0xA000, 0x6000, sys->mem_configs[i].pages);
+    sys->io_mapped = sys->mem_configs[i].io_mapped;
 }
 
 static void _c64_init_memory_map(c64_t* sys) {
@@ -862,6 +1010,7 @@ static void _c64_init_memory_map(c64_t* sys) {
     mem_map_ram(&sys->mem_cpu, 0, 0x0000, 0xA000, sys->ram);
     mem_map_ram(&sys->mem_cpu, 0, 0xC000, 0x1000, sys->ram+0xC000);
     // A000..BFFF, D000..DFFF and E000..FFFF are configurable
+    _c64_init_memory_configs(sys);
     _c64_update_memory_map(sys);
 
     /* setup the separate VIC-II memory map (64 KByte RAM) overlayed with
@@ -956,9 +1105,14 @@ uint32_t c64_exec(c64_t* sys, uint32_t micro_seconds) {
         // run with debug callback
         for (uint32_t ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped); ticks++) {
             pins = _c64_tick(sys, pins);
+            // the debugger may inspect the CIAs and SID
+            _c64_sync_cias(sys);
+            _c64_sync_sid(sys);
             sys->debug.callback.func(sys->debug.callback.user_data, pins);
         }
     }
+    _c64_sync_cias(sys);
+    _c64_sync_sid(sys);
     sys->pins = pins;
     kbd_update(&sys->kbd, micro_seconds);
     return num_ticks;
@@ -1130,17 +1284,39 @@ chips_display_info_t c64_display_info(c64_t* sys) {
     return res;
 }
 
+// get the ROM images referenced by snapshots, returns number of ROM images
+static size_t _c64_shared_roms(c64_t* sys, mem_ext_t* roms) {
+    #if defined(CHIPS_SHARED_ROMS)
+    roms[0] = (mem_ext_t){ .ptr = sys->rom_char, .size = 0x1000 };
+    roms[1] = (mem_ext_t){ .ptr = sys->rom_basic, .size = 0x2000 };
+    roms[2] = (mem_ext_t){ .ptr = sys->rom_kernal, .size = 0x2000 };
+    return 3;
+    #else
+    (void)sys; (void)roms;
+    return 0;
+    #endif
+}
+
 uint32_t c64_save_snapshot(c64_t* sys, c64_t* dst) {
     CHIPS_ASSERT(sys && dst);
+    mem_ext_t roms[3] = {{0}};
+    const size_t num_roms = _c64_shared_roms(sys, roms);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     m6502_snapshot_onsave(&dst->cpu);
     m6569_snapshot_onsave(&dst->vic);
-    mem_snapshot_onsave(&dst->mem_cpu, sys);
-    mem_snapshot_onsave(&dst->mem_vic, sys);
+    mem_snapshot_onsave_ext(&dst->mem_cpu, sys, roms, num_roms);
+    mem_snapshot_onsave_ext(&dst->mem_vic, sys, roms, num_roms);
+    // the memory configuration cache has host pointers, it is taken from the running system on load
+    memset(dst->mem_configs, 0, sizeof(dst->mem_configs));
     c1530_snapshot_onsave(&dst->c1530);
     c1541_snapshot_onsave(&dst->c1541, sys);
+    #if defined(CHIPS_SHARED_ROMS)
+    dst->rom_char = 0;
+    dst->rom_basic = 0;
+    dst->rom_kernal = 0;
+    #endif
     return C64_SNAPSHOT_VERSION;
 }
 
@@ -1149,16 +1325,30 @@ bool c64_load_snapshot(c64_t* sys, uint32_t version, c64_t* src) {
     if (version != C64_SNAPSHOT_VERSION) {
         return false;
     }
+    #if defined(CHIPS_SHARED_ROMS)
+    // the snapshot only references the ROM images, these must be identical
+    if (src->rom_id != sys->rom_id) {
+        return false;
+    }
+    #endif
+    mem_ext_t roms[3] = {{0}};
+    const size_t num_roms = _c64_shared_roms(sys, roms);
     static c64_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     m6502_snapshot_onload(&im.cpu, &sys->cpu);
     m6569_snapshot_onload(&im.vic, &sys->vic);
-    mem_snapshot_onload(&im.mem_cpu, sys);
-    mem_snapshot_onload(&im.mem_vic, sys);
+    mem_snapshot_onload_ext(&im.mem_cpu, sys, roms, num_roms);
+    mem_snapshot_onload_ext(&im.mem_vic, sys, roms, num_roms);
+    memcpy(im.mem_configs, sys->mem_configs, sizeof(im.mem_configs));
     c1530_snapshot_onload(&im.c1530, &sys->c1530);
     c1541_snapshot_onload(&im.c1541, &sys->c1541, sys);
+    #if defined(CHIPS_SHARED_ROMS)
+    im.rom_char = sys->rom_char;
+    im.rom_basic = sys->rom_basic;
+    im.rom_kernal = sys->rom_kernal;
+    #endif
     *sys = im;
     return true;
 }
@@ -18,6 +18,14 @@
     ~~~
         your own assert macro (default: assert(c))
 
+    ~~~C
+    CHIPS_SHARED_ROMS
+    ~~~
+        if defined, the ROM images in cpc_desc_t.roms are mapped directly
+        instead of being copied into cpc_t, the ROM data must outlive the
+        emulator instance, snapshots only contain an identity hash of the
+        ROM images
+
     You need to include the following headers before including cpc.h:
 
     - chips/chips_common.h
@@ -45,6 +53,25 @@
 
     FIXME!
 
+    ## Fast Disc Mode
+
+    Normally the FDC transfers sector data byte by byte, with the CPU polling
+    the FDC status register between the bytes. In fast disc mode (enabled
+    with cpc_desc_t.fast_disc or cpc_set_fast_disc()), calls to the AMSDOS
+    READ SECTOR routine are trapped on the CPC 6128, and the sector is
+    copied from the disc image straight into RAM:
+
+    - Entry: HL = buffer address, E = drive, D = track, C = sector id
+    - Exit:  A = 0 and carry set
+
+    The routine address is looked up in the AMSDOS ROM's jumpblock (the
+    hidden ^D command). Reads from other drives and from missing sectors
+    run through the ROM code, and the drive's head position and motor
+    aren't changed, so the AMSDOS state stays consistent with the drive.
+    Sectors with error status bits (CRC errors, deleted data) or with
+    stored data which doesn't match the sector size are also read through
+    the ROM code, so copy-protected discs behave like in accurate mode.
+
     ## TODO
 
     - improve CRTC emulation, some graphics demos don't work yet
@@ -78,7 +105,7 @@ extern "C" {
 #endif
 
 // bump when cpc_t memory layout changes
-#define CPC_SNAPSHOT_VERSION (0x0001)
+#define CPC_SNAPSHOT_VERSION (0x0009)
 
 #define CPC_MAX_AUDIO_SAMPLES (1024)        // max number of audio samples in internal sample buffer
 #define CPC_DEFAULT_AUDIO_SAMPLES (128)     // default number of samples in internal sample buffer
@@ -110,6 +137,7 @@ typedef enum {
 typedef struct {
     cpc_type_t type;                // default is the CPC 6128
     cpc_joystick_type_t joystick_type;
+    bool fast_disc;                 // trap the AMSDOS READ SECTOR routine (CPC 6128 only)
     chips_debug_t debug;
     chips_audio_desc_t audio;
 
@@ -138,6 +166,7 @@ typedef struct {
 typedef struct {
     z80_t cpu;
     ay38910_t psg;
+    uint32_t psg_num_deferred;  // number of deferred PSG ticks, see _cpc_sync_psg()
     mc6845_t crtc;
     i8255_t ppi;
     upd765_t fdc;
@@ -153,6 +182,10 @@ typedef struct {
 
     uint64_t pins;
     bool valid;
+    struct {
+        bool enabled;
+        uint16_t read_sector_addr;  // address of the AMSDOS READ SECTOR routine, 0 if not found
+    } fast_disc;
     chips_debug_t debug;
 
     struct {
@@ -162,9 +195,16 @@ typedef struct {
         float sample_buffer[CPC_MAX_AUDIO_SAMPLES];
     } audio;
     uint8_t ram[8][0x4000];
+    #if defined(CHIPS_SHARED_ROMS)
+    const uint8_t* rom_os;
+    const uint8_t* rom_basic;
+    const uint8_t* rom_amsdos;
+    uint32_t rom_id;        // identity hash of ROM images, checked in cpc_load_snapshot()
+    #else
     uint8_t rom_os[0x4000];
     uint8_t rom_basic[0x4000];
     uint8_t rom_amsdos[0x4000];
+    #endif
     alignas(64) uint8_t fb[AM40010_FRAMEBUFFER_SIZE_BYTES];
     fdd_t fdd;
 } cpc_t;
@@ -193,12 +233,16 @@ void cpc_joystick(cpc_t* sys, uint8_t mask);
 uint8_t cpc_joystick_mask(cpc_t* sys);
 // load a snapshot file (.sna or .bin) into the emulator
 bool cpc_quickload(cpc_t* cpc, chips_range_t data);
-// insert a disk image file (.dsk)
+// insert a disk image file (.dsk), the data is not copied and must remain valid until the disc is removed
 bool cpc_insert_disc(cpc_t* cpc, chips_range_t data);
 // remove current disc
 void cpc_remove_disc(cpc_t* cpc);
 // return true if a floppy disc is currently inserted
 bool cpc_disc_inserted(cpc_t* cpc);
+// enable/disable fast disc mode (trapped AMSDOS sector reads), returns false if not supported
+bool cpc_set_fast_disc(cpc_t* cpc, bool enabled);
+// return true if fast disc mode is active
+bool cpc_fast_disc(cpc_t* cpc);
 // if enabled, start calling the video-debugging-callback
 void cpc_enable_video_debugging(cpc_t* cpc, bool enabled);
 // get current display debug visualization enabled/disabled state
@@ -225,12 +269,16 @@ bool cpc_load_snapshot(cpc_t* sys, uint32_t version, cpc_t* src);
 static uint64_t _cpc_cclk(void* user_data);
 static void _cpc_psg_out(int port_id, uint8_t data, void* user_data);
 static uint8_t _cpc_psg_in(int port_id, void* user_data);
+static void _cpc_sync_psg(cpc_t* sys);
 static void _cpc_init_keymap(cpc_t* sys);
 static void _cpc_bankswitch(uint8_t ram_config, uint8_t rom_enable, uint8_t rom_select, void* user_data);
+static uint16_t _cpc_find_amsdos_read_sector(const uint8_t* rom);
+static uint64_t _cpc_fast_disc_read_sector(cpc_t* sys, uint64_t cpu_pins);
 static int _cpc_fdc_seektrack(int drive, int track, void* user_data);
 static int _cpc_fdc_seeksector(int drive, int side, upd765_sectorinfo_t* inout_info, void* user_data);
 static int _cpc_fdc_read(int drive, int side, void* user_data, uint8_t* out_data);
 static int _cpc_fdc_trackinfo(int drive, int side, void* user_data, upd765_sectorinfo_t* out_info);
+static int _cpc_fdc_sector(int drive, int side, void* user_data, const uint8_t** out_data, int* out_size);
 static void _cpc_fdc_driveinfo(int drive, void* user_data, upd765_driveinfo_t* out_info);
 
 #define _CPC_DEFAULT(val,def) (((val) != 0) ? (val) : (def))
@@ -250,23 +298,45 @@ void cpc_init(cpc_t* sys, const cpc_desc_t* desc) {
     if (CPC_TYPE_464 == desc->type) {
         CHIPS_ASSERT(desc->roms.cpc464.os.ptr && (desc->roms.cpc464.os.size == 0x4000));
         CHIPS_ASSERT(desc->roms.cpc464.basic.ptr && (desc->roms.cpc464.basic.size == 0x4000));
+        #if defined(CHIPS_SHARED_ROMS)
+        sys->rom_os = (const uint8_t*) desc->roms.cpc464.os.ptr;
+        sys->rom_basic = (const uint8_t*) desc->roms.cpc464.basic.ptr;
+        #else
         memcpy(sys->rom_os, desc->roms.cpc464.os.ptr, 0x4000);
         memcpy(sys->rom_basic, desc->roms.cpc464.basic.ptr, 0x4000);
+        #endif
     }
     else if (CPC_TYPE_6128 == desc->type) {
         CHIPS_ASSERT(desc->roms.cpc6128.os.ptr && (desc->roms.cpc6128.os.size == 0x4000));
         CHIPS_ASSERT(desc->roms.cpc6128.basic.ptr && (desc->roms.cpc6128.basic.size == 0x4000));
         CHIPS_ASSERT(desc->roms.cpc6128.amsdos.ptr && (desc->roms.cpc6128.amsdos.size == 0x4000));
+        #if defined(CHIPS_SHARED_ROMS)
+        sys->rom_os = (const uint8_t*) desc->roms.cpc6128.os.ptr;
+        sys->rom_basic = (const uint8_t*) desc->roms.cpc6128.basic.ptr;
+        sys->rom_amsdos = (const uint8_t*) desc->roms.cpc6128.amsdos.ptr;
+        #else
         memcpy(sys->rom_os, desc->roms.cpc6128.os.ptr, 0x4000);
         memcpy(sys->rom_basic, desc->roms.cpc6128.basic.ptr, 0x4000);
         memcpy(sys->rom_amsdos, desc->roms.cpc6128.amsdos.ptr, 0x4000);
+        #endif
     }
     else { // KC Compact
         CHIPS_ASSERT(desc->roms.kcc.os.ptr && (desc->roms.kcc.os.size == 0x4000));
         CHIPS_ASSERT(desc->roms.kcc.basic.ptr && (desc->roms.kcc.basic.size == 0x4000));
+        #if defined(CHIPS_SHARED_ROMS)
+        sys->rom_os = (const uint8_t*) desc->roms.kcc.os.ptr;
+        sys->rom_basic = (const uint8_t*) desc->roms.kcc.basic.ptr;
+        #else
         memcpy(sys->rom_os, desc->roms.kcc.os.ptr, 0x4000);
         memcpy(sys->rom_basic, desc->roms.kcc.basic.ptr, 0x4000);
+        #endif
+    }
+    #if defined(CHIPS_SHARED_ROMS)
+    sys->rom_id = mem_rom_id(mem_rom_id(0, sys->rom_os, 0x4000), sys->rom_basic, 0x4000);
+    if (sys->rom_amsdos) {
+        sys->rom_id = mem_rom_id(sys->rom_id, sys->rom_amsdos, 0x4000);
     }
+    #endif
 
     // initialize the hardware
     sys->pins = z80_init(&sys->cpu);
@@ -300,11 +370,16 @@ void cpc_init(cpc_t* sys, const cpc_desc_t* desc) {
         .seektrack_cb = _cpc_fdc_seektrack,
         .seeksector_cb = _cpc_fdc_seeksector,
         .read_cb = _cpc_fdc_read,
+        .sector_cb = _cpc_fdc_sector,
         .trackinfo_cb = _cpc_fdc_trackinfo,
         .driveinfo_cb = _cpc_fdc_driveinfo,
         .user_data = sys,
     });
     fdd_init(&sys->fdd);
+    if (CPC_TYPE_6128 == sys->type) {
+        sys->fast_disc.read_sector_addr = _cpc_find_amsdos_read_sector(sys->rom_amsdos);
+    }
+    cpc_set_fast_disc(sys, desc->fast_disc);
 
     _cpc_init_keymap(sys);
 }
@@ -319,6 +394,7 @@ void cpc_reset(cpc_t* sys) {
     mem_unmap_all(&sys->mem);
     mc6845_reset(&sys->crtc);
     ay38910_reset(&sys->psg);
+    sys->psg_num_deferred = 0;
     i8255_reset(&sys->ppi);
     am40010_reset(&sys->ga);
     sys->pins = z80_reset(&sys->cpu);
@@ -326,9 +402,30 @@ void cpc_reset(cpc_t* sys) {
     sys->joy_joymask = 0;
 }
 
+// CPC6128 RAM block indices
+static const int _cpc_ram_config[8][4] = {
+    { 0, 1, 2, 3 },
+    { 0, 1, 2, 7 },
+    { 4, 5, 6, 7 },
+    { 0, 3, 2, 7 },
+    { 0, 4, 2, 3 },
+    { 0, 5, 2, 3 },
+    { 0, 6, 2, 3 },
+    { 0, 7, 2, 3 }
+};
+
 static uint64_t _cpc_tick(cpc_t* sys, uint64_t cpu_pins) {
     cpu_pins = z80_tick(&sys->cpu, cpu_pins);
 
+    // trap the opcode fetch at the AMSDOS READ SECTOR routine in fast disc mode
+    if (sys->fast_disc.enabled) {
+        const uint64_t trap_mask = Z80_M1|Z80_MREQ|Z80_RD|0xFFFF;
+        const uint64_t trap_val = Z80_M1|Z80_MREQ|Z80_RD|sys->fast_disc.read_sector_addr;
+        if ((cpu_pins & trap_mask) == trap_val) {
+            cpu_pins = _cpc_fast_disc_read_sector(sys, cpu_pins);
+        }
+    }
+
     // memory and IO requests
     if (cpu_pins & Z80_MREQ) {
         const uint16_t addr = Z80_GET_ADDR(cpu_pins);
@@ -336,6 +433,12 @@ static uint64_t _cpc_tick(cpc_t* sys, uint64_t cpu_pins) {
             Z80_SET_DATA(cpu_pins, mem_rd(&sys->mem, addr));
         }
         else if (cpu_pins & Z80_WR) {
+            // the gate array may need to render pending video output first
+            // (on the 464 and KC Compact, the RAM config is always 0)
+            const int bank = _cpc_ram_config[sys->ga.ram_config & 7][addr >> 14];
+            if (bank < 4) {
+                am40010_ram_write(&sys->ga, (uint16_t)((bank << 14) | (addr & 0x3FFF)));
+            }
             mem_wr(&sys->mem, addr, Z80_GET_DATA(cpu_pins));
         }
     }
@@ -390,6 +493,7 @@ static uint64_t _cpc_tick(cpc_t* sys, uint64_t cpu_pins) {
                 if (sys->ppi.pins & I8255_PC6) { ay_pins |= AY38910_BC1; }
                 const uint8_t ay_data = I8255_GET_PA(sys->ppi.pins);
                 AY38910_SET_DATA(ay_pins, ay_data);
+                _cpc_sync_psg(sys);
                 ay_pins = ay38910_iorq(&sys->psg, ay_pins);
                 I8255_SET_PA(ppi_pins, AY38910_GET_DATA(ay_pins));
             }
@@ -410,6 +514,7 @@ static uint64_t _cpc_tick(cpc_t* sys, uint64_t cpu_pins) {
                 if (ppi_pins & I8255_PC6) { ay_pins |= AY38910_BC1; }
                 const uint8_t ay_data = I8255_GET_PA(ppi_pins);
                 AY38910_SET_DATA(ay_pins, ay_data);
+                _cpc_sync_psg(sys);
                 ay38910_iorq(&sys->psg, ay_pins);
             }
             // PC0..PC3: select keyboard matrix line
@@ -474,10 +579,26 @@ static uint64_t _cpc_tick(cpc_t* sys, uint64_t cpu_pins) {
 */
 static uint64_t _cpc_cclk(void* user_data) {
     cpc_t* sys = (cpc_t*) user_data;
-    // tick the sound chip...
-    if (ay38910_tick(&sys->psg)) {
-        // new sound sample ready
-        sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->psg.sample;
+    // the sound chip is only ticked in bulk before it is accessed, see _cpc_sync_psg()
+    sys->psg_num_deferred++;
+    // tick the CRTC and return its pin mask
+    uint64_t crtc_pins = mc6845_tick(&sys->crtc);
+    return crtc_pins;
+}
+
+/* The PSG output only depends on its register state, so the 1 MHz PSG
+   ticks are only counted in _cpc_cclk() and rendered in one go before
+   the next PSG access, and at the end of cpc_exec().
+*/
+static void _cpc_sync_psg(cpc_t* sys) {
+    uint32_t num_ticks = sys->psg_num_deferred;
+    while (num_ticks > 0) {
+        int num_samples = 0;
+        num_ticks -= ay38910_render(&sys->psg, num_ticks,
+            &sys->audio.sample_buffer[sys->audio.sample_pos],
+            sys->audio.num_samples - sys->audio.sample_pos,
+            &num_samples);
+        sys->audio.sample_pos += num_samples;
         if (sys->audio.sample_pos == sys->audio.num_samples) {
             if (sys->audio.callback.func) {
                 // new sample packet is ready
@@ -486,9 +607,7 @@ static uint64_t _cpc_cclk(void* user_data) {
             sys->audio.sample_pos = 0;
         }
     }
-    // tick the CRTC and return its pin mask
-    uint64_t crtc_pins = mc6845_tick(&sys->crtc);
-    return crtc_pins;
+    sys->psg_num_deferred = 0;
 }
 
 // PSG OUT callback (nothing to do here)
@@ -527,18 +646,6 @@ static uint8_t _cpc_psg_in(int port_id, void* user_data) {
     }
 }
 
-// CPC6128 RAM block indices
-static const int _cpc_ram_config[8][4] = {
-    { 0, 1, 2, 3 },
-    { 0, 1, 2, 7 },
-    { 4, 5, 6, 7 },
-    { 0, 3, 2, 7 },
-    { 0, 4, 2, 3 },
-    { 0, 5, 2, 3 },
-    { 0, 6, 2, 3 },
-    { 0, 7, 2, 3 }
-};
-
 // memory bankswitch callback, invoked by gate array (am40010)
 static void _cpc_bankswitch(uint8_t ram_config, uint8_t rom_enable, uint8_t rom_select, void* user_data) {
     cpc_t* sys = (cpc_t*) user_data;
@@ -598,9 +705,13 @@ uint32_t cpc_exec(cpc_t* sys, uint32_t micro_seconds) {
         // run with debug hook
         for (uint32_t tick = 0; (tick < num_ticks) && !(*sys->debug.stopped); tick++) {
             pins = _cpc_tick(sys, pins);
+            // the debugger may inspect the PSG
+            _cpc_sync_psg(sys);
             sys->debug.callback.func(sys->debug.callback.user_data, pins);
         }
     }
+    _cpc_sync_psg(sys);
+    am40010_flush_video(&sys->ga);
     sys->pins = pins;
     kbd_update(&sys->kbd, micro_seconds);
     return num_ticks;
@@ -821,12 +932,15 @@ static bool _cpc_load_sna(cpc_t* sys, chips_range_t data) {
     sys->cpu.de2 = (hdr->D_<<8) | hdr->E_;
     sys->cpu.hl2 = (hdr->H_<<8) | hdr->L_;
 
+    am40010_registers_t ga_regs = {
+        .inksel = hdr->selected_pen,
+        .config = hdr->gate_array_config,
+        .border = hdr->pens[16],
+    };
     for (int i = 0; i < 16; i++) {
-        sys->ga.regs.ink[i] = hdr->pens[i] & 0x1F;
+        ga_regs.ink[i] = hdr->pens[i];
     }
-    sys->ga.regs.border = hdr->pens[16] & 0x1F;
-    sys->ga.regs.inksel = hdr->selected_pen & 0x1F;
-    sys->ga.regs.config = hdr->gate_array_config & 0x3F;
+    am40010_set_registers(&sys->ga, &ga_regs);
     sys->ga.ram_config = hdr->ram_config & 0x3F;
     sys->ga.rom_select = hdr->rom_config;
     _cpc_bankswitch(sys->ga.ram_config, sys->ga.regs.config, sys->ga.rom_select, sys);
@@ -951,6 +1065,16 @@ static int _cpc_fdc_read(int drive, int side, void* user_data, uint8_t* out_data
     }
 }
 
+static int _cpc_fdc_sector(int drive, int side, void* user_data, const uint8_t** out_data, int* out_size) {
+    if (0 == drive) {
+        cpc_t* sys = (cpc_t*) user_data;
+        return fdd_read_sector(&sys->fdd, side, out_data, out_size);
+    }
+    else {
+        return UPD765_RESULT_NOT_READY;
+    }
+}
+
 static int _cpc_fdc_trackinfo(int drive, int side, void* user_data, upd765_sectorinfo_t* out_info) {
     CHIPS_ASSERT((side >= 0) && (side < 2));
     if (0 == drive) {
@@ -993,11 +1117,14 @@ static void _cpc_fdc_driveinfo(int drive, void* user_data, upd765_driveinfo_t* o
 
 bool cpc_insert_disc(cpc_t* sys, chips_range_t data) {
     CHIPS_ASSERT(sys && sys->valid);
+    // the FDC must fetch the sector data of a running bulk sector read again
+    sys->fdc.sector.ptr = 0;
     return fdd_cpc_insert_dsk(&sys->fdd, data);
 }
 
 void cpc_remove_disc(cpc_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
+    sys->fdc.sector.ptr = 0;
     fdd_eject_disc(&sys->fdd);
 }
 
@@ -1006,6 +1133,90 @@ bool cpc_disc_inserted(cpc_t* sys) {
     return fdd_disc_inserted(&sys->fdd);
 }
 
+bool cpc_set_fast_disc(cpc_t* sys, bool enabled) {
+    CHIPS_ASSERT(sys && sys->valid);
+    sys->fast_disc.enabled = enabled && (0 != sys->fast_disc.read_sector_addr);
+    return sys->fast_disc.enabled == enabled;
+}
+
+bool cpc_fast_disc(cpc_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    return sys->fast_disc.enabled;
+}
+
+/*  Find the READ SECTOR routine in the AMSDOS ROM, this is the hidden
+    command ^D (a single character name 0x84) in the ROM's name table,
+    the jumpblock at 0xC006 has a JP instruction for each name.
+*/
+static uint16_t _cpc_find_amsdos_read_sector(const uint8_t* rom) {
+    if (0 == rom) {
+        return 0;
+    }
+    uint32_t pos = ((rom[5]<<8) | rom[4]) - 0xC000;
+    int index = 0;
+    while ((pos < 0x4000) && (rom[pos] != 0)) {
+        if (rom[pos] == 0x84) {
+            const uint32_t jp = 6 + index * 3;
+            if ((jp + 2) < 0x4000 && (rom[jp] == 0xC3)) {
+                return (rom[jp+2]<<8) | rom[jp+1];
+            }
+            return 0;
+        }
+        // skip to the end of the name, the last character has bit 7 set
+        while ((pos < 0x4000) && !(rom[pos] & 0x80)) {
+            pos++;
+        }
+        pos++;
+        index++;
+    }
+    return 0;
+}
+
+// trapped AMSDOS READ SECTOR routine, see "Fast Disc Mode" in the header
+static uint64_t _cpc_fast_disc_read_sector(cpc_t* sys, uint64_t cpu_pins) {
+    // AMSDOS must be mapped as upper ROM
+    if ((sys->ga.regs.config & AM40010_CONFIG_HROMEN) || (sys->ga.rom_select != 7)) {
+        return cpu_pins;
+    }
+    z80_t* cpu = &sys->cpu;
+    const fdd_t* fdd = &sys->fdd;
+    if ((cpu->e != 0) || !fdd->has_disc || (cpu->d >= fdd->disc.num_tracks)) {
+        return cpu_pins;
+    }
+    const fdd_track_t* track = &fdd->disc.tracks[0][cpu->d];
+    for (int si = 0; si < track->num_sectors; si++) {
+        const fdd_sector_t* sector = &track->sectors[si];
+        if (sector->info.upd765.r == cpu->c) {
+            // let the ROM code handle sectors with error status (CRC errors, deleted
+            // data) and sectors where the stored data doesn't match the sector size
+            // (for instance EDSK weak sectors)
+            const fdd_upd765_sectorinfo_t* info = &sector->info.upd765;
+            const int size = (info->n < 8) ? (0x80 << info->n) : 0;
+            if ((info->st1 != 0) || (info->st2 != 0) || (size != sector->data_size)) {
+                return cpu_pins;
+            }
+            const uint8_t* src = fdd_sector_data(fdd, sector);
+            uint16_t addr = cpu->hl;
+            for (int i = 0; i < size; i++, addr++) {
+                // same as a CPU memory write in _cpc_tick()
+                const int bank = _cpc_ram_config[sys->ga.ram_config & 7][addr >> 14];
+                if (bank < 4) {
+                    am40010_ram_write(&sys->ga, (uint16_t)((bank << 14) | (addr & 0x3FFF)));
+                }
+                mem_wr(&sys->mem, addr, src[i]);
+            }
+            cpu->a = 0;
+            cpu->f |= Z80_CF;
+            // return to the caller
+            const uint16_t ret_addr = mem_rd16(&sys->mem, cpu->sp);
+            cpu->sp += 2;
+            return z80_prefetch(cpu, ret_addr);
+        }
+    }
+    // sector not found, let the ROM code report the error
+    return cpu_pins;
+}
+
 chips_display_info_t cpc_display_info(cpc_t* sys) {
     const chips_display_info_t res = {
         .frame = {
@@ -1035,15 +1246,39 @@ chips_display_info_t cpc_display_info(cpc_t* sys) {
     return res;
 }
 
+// get the ROM images referenced by snapshots, returns number of ROM images
+static size_t _cpc_shared_roms(cpc_t* sys, mem_ext_t* roms) {
+    #if defined(CHIPS_SHARED_ROMS)
+    roms[0] = (mem_ext_t){ .ptr = sys->rom_os, .size = 0x4000 };
+    roms[1] = (mem_ext_t){ .ptr = sys->rom_basic, .size = 0x4000 };
+    if (sys->rom_amsdos) {
+        roms[2] = (mem_ext_t){ .ptr = sys->rom_amsdos, .size = 0x4000 };
+        return 3;
+    }
+    return 2;
+    #else
+    (void)sys; (void)roms;
+    return 0;
+    #endif
+}
+
 uint32_t cpc_save_snapshot(cpc_t* sys, cpc_t* dst) {
     CHIPS_ASSERT(sys && dst);
+    mem_ext_t roms[3] = {{0}};
+    const size_t num_roms = _cpc_shared_roms(sys, roms);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     ay38910_snapshot_onsave(&dst->psg);
     upd765_snapshot_onsave(&dst->fdc);
+    fdd_snapshot_onsave(&dst->fdd);
     am40010_snapshot_onsave(&dst->ga);
-    mem_snapshot_onsave(&dst->mem, sys);
+    mem_snapshot_onsave_ext(&dst->mem, sys, roms, num_roms);
+    #if defined(CHIPS_SHARED_ROMS)
+    dst->rom_os = 0;
+    dst->rom_basic = 0;
+    dst->rom_amsdos = 0;
+    #endif
     return CPC_SNAPSHOT_VERSION;
 }
 
@@ -1052,14 +1287,28 @@ bool cpc_load_snapshot(cpc_t* sys, uint32_t version, cpc_t* src) {
     if (version != CPC_SNAPSHOT_VERSION) {
         return false;
     }
+    #if defined(CHIPS_SHARED_ROMS)
+    // the snapshot only references the ROM images, these must be identical
+    if (src->rom_id != sys->rom_id) {
+        return false;
+    }
+    #endif
+    mem_ext_t roms[3] = {{0}};
+    const size_t num_roms = _cpc_shared_roms(sys, roms);
     static cpc_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     ay38910_snapshot_onload(&im.psg, &sys->psg);
     upd765_snapshot_onload(&im.fdc, &sys->fdc);
+    fdd_snapshot_onload(&im.fdd, &sys->fdd);
     am40010_snapshot_onload(&im.ga, &sys->ga);
-    mem_snapshot_onload(&im.mem, sys);
+    mem_snapshot_onload_ext(&im.mem, sys, roms, num_roms);
+    #if defined(CHIPS_SHARED_ROMS)
+    im.rom_os = sys->rom_os;
+    im.rom_basic = sys->rom_basic;
+    im.rom_amsdos = sys->rom_amsdos;
+    #endif
     *sys = im;
     return true;
 }
@@ -21,6 +21,12 @@
     CHIPS_ASSERT(c)
         your own assert macro (default: assert(c))
 
+    CHIPS_SHARED_ROMS
+        if defined, the ROM images in kc85_desc_t.roms are mapped directly
+        instead of being copied into kc85_t, the ROM data must outlive the
+        emulator instance, snapshots only contain an identity hash of the
+        ROM images
+
     You need to include the following headers before including kc85.h:
 
     - chips/chips_common.h
@@ -275,13 +281,17 @@ extern "C" {
 #endif
 
 // bump this whenever the kc85_t struct layout changes
-#define KC85_SNAPSHOT_VERSION (KC85_TYPE_ID | 0x0002)
+#define KC85_SNAPSHOT_VERSION (KC85_TYPE_ID | 0x0004)
 
 #define KC85_MAX_AUDIO_SAMPLES (1024U)      // max number of audio samples in internal sample buffer
 #define KC85_DEFAULT_AUDIO_SAMPLES (128)    // default number of samples in internal sample buffer
 #define KC85_EXP_NUM_SLOTS (2U)             // 2 expansion slots in main unit, each needs one mem_t layer!
 #define KC85_EXP_BUFSIZE (KC85_EXP_NUM_SLOTS*64U*1024U) // expansion system buffer size (64 KB per slot)
 
+#if defined(CHIPS_MEM_COMPACT) && (MEM_COMPACT_MAX_LAYERS < (KC85_EXP_NUM_SLOTS + 1))
+#error "kc85.h needs one mem_t layer per expansion slot plus one, please define MEM_COMPACT_MAX_LAYERS as 3"
+#endif
+
 #define KC85_FRAMEBUFFER_WIDTH (512)   // multiple of 256
 #define KC85_FRAMEBUFFER_HEIGHT (256)  // FIXME: allow border?
 #define KC85_FRAMEBUFFER_SIZE_BYTES (KC85_FRAMEBUFFER_WIDTH * KC85_FRAMEBUFFER_HEIGHT)
@@ -408,6 +418,7 @@ typedef struct {
     uint64_t flip_flops;    // audio and blink flip flop bits controlled by CTC
     beeper_t beeper_1;
     beeper_t beeper_2;
+    uint32_t beeper_num_deferred;   // ticks since the last beeper_run(), see _kc85_sync_beepers()
     z80pio_t pio;
     kc85_exp_t exp;         // expansion module system
 
@@ -427,13 +438,24 @@ typedef struct {
     kc85_patch_callback_t patch_callback;
 
     uint8_t ram[8][0x4000];             // up to 8 16-KByte RAM banks
-    #if defined(CHIPS_KC85_TYPE_3) || defined(CHIPS_KC85_TYPE_4)
-        uint8_t rom_basic[0x2000];          // 8 KByte BASIC ROM (KC85/3 and /4 only)
-    #endif
-    #if defined(CHIPS_KC85_TYPE_4)
-        uint8_t rom_caos_c[0x1000];         // 4 KByte CAOS ROM at 0xC000 (KC85/4 only)
+    #if defined(CHIPS_SHARED_ROMS)
+        #if defined(CHIPS_KC85_TYPE_3) || defined(CHIPS_KC85_TYPE_4)
+            const uint8_t* rom_basic;       // 8 KByte BASIC ROM (KC85/3 and /4 only)
+        #endif
+        #if defined(CHIPS_KC85_TYPE_4)
+            const uint8_t* rom_caos_c;      // 4 KByte CAOS ROM at 0xC000 (KC85/4 only)
+        #endif
+        const uint8_t* rom_caos_e;      // 8 KByte CAOS ROM at 0xE000
+        uint32_t rom_id;                // identity hash of ROM images, checked in kc85_load_snapshot()
+    #else
+        #if defined(CHIPS_KC85_TYPE_3) || defined(CHIPS_KC85_TYPE_4)
+            uint8_t rom_basic[0x2000];      // 8 KByte BASIC ROM (KC85/3 and /4 only)
+        #endif
+        #if defined(CHIPS_KC85_TYPE_4)
+            uint8_t rom_caos_c[0x1000];     // 4 KByte CAOS ROM at 0xC000 (KC85/4 only)
+        #endif
+        uint8_t rom_caos_e[0x2000];     // 8 KByte CAOS ROM at 0xE000
     #endif
-    uint8_t rom_caos_e[0x2000];         // 8 KByte CAOS ROM at 0xE000
     uint8_t exp_buf[KC85_EXP_BUFSIZE];  // expansion system RAM/ROM
     alignas(64) uint8_t fb[KC85_FRAMEBUFFER_SIZE_BYTES];
 } kc85_t;
@@ -564,6 +586,7 @@ static void _kc85_exp_reset(kc85_t* sys);
 static bool _kc85_exp_write_ctrl(kc85_t* sys, uint8_t slot_addr, uint8_t ctrl_byte);
 static uint8_t _kc85_exp_module_id(kc85_t* sys, uint8_t slot_addr);
 static void _kc85_exp_update_memory_mapping(kc85_t* sys);
+static size_t _kc85_shared_roms(kc85_t* sys, mem_ext_t* roms);
 
 // xorshift randomness for memory initialization
 static inline uint32_t _kc85_xorshift32(uint32_t x) {
@@ -585,25 +608,41 @@ void kc85_init(kc85_t* sys, const kc85_desc_t* desc) {
     sys->patch_callback = desc->patch_callback;
     sys->debug = desc->debug;
 
-    // copy ROM images
+    // copy or reference ROM images
+    #if defined(CHIPS_SHARED_ROMS)
+        #define _KC85_INIT_ROM(dst, src) { dst = (const uint8_t*)(src).ptr; }
+    #else
+        #define _KC85_INIT_ROM(dst, src) { memcpy(dst, (src).ptr, sizeof(dst)); }
+    #endif
     #if defined(CHIPS_KC85_TYPE_2)
         // KC85/2 only has an 8 KByte OS ROM
-        CHIPS_ASSERT(desc->roms.caos22.ptr && (desc->roms.caos22.size == sizeof(sys->rom_caos_e)));
-        memcpy(sys->rom_caos_e, desc->roms.caos22.ptr, sizeof(sys->rom_caos_e));
+        CHIPS_ASSERT(desc->roms.caos22.ptr && (desc->roms.caos22.size == 0x2000));
+        _KC85_INIT_ROM(sys->rom_caos_e, desc->roms.caos22);
     #elif defined(CHIPS_KC85_TYPE_3)
         // KC85/3 has 8 KByte BASIC ROM and 8 KByte OS ROM
-        CHIPS_ASSERT(desc->roms.kcbasic.ptr && (desc->roms.kcbasic.size == sizeof(sys->rom_basic)));
-        memcpy(sys->rom_basic, desc->roms.kcbasic.ptr, sizeof(sys->rom_basic));
-        CHIPS_ASSERT(desc->roms.caos31.ptr && (desc->roms.caos31.size == sizeof(sys->rom_caos_e)));
-        memcpy(sys->rom_caos_e, desc->roms.caos31.ptr, sizeof(sys->rom_caos_e));
+        CHIPS_ASSERT(desc->roms.kcbasic.ptr && (desc->roms.kcbasic.size == 0x2000));
+        _KC85_INIT_ROM(sys->rom_basic, desc->roms.kcbasic);
+        CHIPS_ASSERT(desc->roms.caos31.ptr && (desc->roms.caos31.size == 0x2000));
+        _KC85_INIT_ROM(sys->rom_caos_e, desc->roms.caos31);
     #else
         // KC85/4 has 8 KByte BASIC ROM, and 2 OS ROMs (4 KB and 8 KB)
-        CHIPS_ASSERT(desc->roms.kcbasic.ptr && (desc->roms.kcbasic.size == sizeof(sys->rom_basic)));
-        memcpy(sys->rom_basic, desc->roms.kcbasic.ptr, sizeof(sys->rom_basic));
-        CHIPS_ASSERT(desc->roms.caos42c.ptr && (desc->roms.caos42c.size == sizeof(sys->rom_caos_c)));
-        memcpy(sys->rom_caos_c, desc->roms.caos42c.ptr, sizeof(sys->rom_caos_c));
-        CHIPS_ASSERT(desc->roms.caos42e.ptr && (desc->roms.caos42e.size == sizeof(sys->rom_caos_e)));
-        memcpy(sys->rom_caos_e, desc->roms.caos42e.ptr, sizeof(sys->rom_caos_e));
+        CHIPS_ASSERT(desc->roms.kcbasic.ptr && (desc->roms.kcbasic.size == 0x2000));
+        _KC85_INIT_ROM(sys->rom_basic, desc->roms.kcbasic);
+        CHIPS_ASSERT(desc->roms.caos42c.ptr && (desc->roms.caos42c.size == 0x1000));
+        _KC85_INIT_ROM(sys->rom_caos_c, desc->roms.caos42c);
+        CHIPS_ASSERT(desc->roms.caos42e.ptr && (desc->roms.caos42e.size == 0x2000));
+        _KC85_INIT_ROM(sys->rom_caos_e, desc->roms.caos42e);
+    #endif
+    #undef _KC85_INIT_ROM
+    #if defined(CHIPS_SHARED_ROMS)
+    {
+        mem_ext_t roms[3];
+        const size_t num_roms = _kc85_shared_roms(sys, roms);
+        sys->rom_id = 0;
+        for (size_t i = 0; i < num_roms; i++) {
+            sys->rom_id = mem_rom_id(sys->rom_id, roms[i].ptr, roms[i].size);
+        }
+    }
     #endif
 
     // fill RAM with noise (only KC85/2 and /3)
@@ -665,6 +704,7 @@ void kc85_reset(kc85_t* sys) {
     z80pio_reset(&sys->pio);
     beeper_reset(&sys->beeper_1);
     beeper_reset(&sys->beeper_2);
+    sys->beeper_num_deferred = 0;
     #if defined(CHIPS_KC85_TYPE_4)
         sys->io84 = 0;
         sys->io86 = 0;
@@ -902,6 +942,40 @@ static void _kc85_update_memory_map(kc85_t* sys) {
     _kc85_exp_update_memory_mapping(sys);
 }
 
+/* The two beepers run in event mode, output changes are recorded with
+   their tick offset, and the samples are generated in one go when a
+   change buffer is full, and at the end of kc85_exec(). Both beepers
+   are initialized and reset together, so they produce their samples
+   on the same ticks.
+*/
+static void _kc85_sync_beepers(kc85_t* sys) {
+    uint32_t num_ticks = sys->beeper_num_deferred;
+    while (num_ticks > 0) {
+        float samples_1[64];
+        float samples_2[64];
+        int max_samples = sys->audio.num_samples - sys->audio.sample_pos;
+        if (max_samples > 64) {
+            max_samples = 64;
+        }
+        int num_samples_1 = 0;
+        int num_samples_2 = 0;
+        const uint32_t ticks = beeper_run(&sys->beeper_1, num_ticks, samples_1, max_samples, &num_samples_1);
+        beeper_run(&sys->beeper_2, ticks, samples_2, max_samples, &num_samples_2);
+        CHIPS_ASSERT(num_samples_1 == num_samples_2);
+        num_ticks -= ticks;
+        for (int i = 0; i < num_samples_1; i++) {
+            sys->audio.sample_buffer[sys->audio.sample_pos++] = samples_1[i] + samples_2[i];
+        }
+        if (sys->audio.sample_pos == sys->audio.num_samples) {
+            if (sys->audio.callback.func) {
+                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
+            }
+            sys->audio.sample_pos = 0;
+        }
+    }
+    sys->beeper_num_deferred = 0;
+}
+
 static uint64_t _kc85_tick(kc85_t* sys, uint64_t pins) {
     // tick the CPU
     pins = z80_tick(&sys->cpu, pins) & Z80_PIN_MASK;
@@ -950,8 +1024,11 @@ static uint64_t _kc85_tick(kc85_t* sys, uint64_t pins) {
             if (((pins ^ sys->pio_pins)>>Z80PIO_PIN_PB1) & 0x0F) {
                 // volume has changed
                 float vol = ((~pins >> Z80PIO_PIN_PB1) & 0x0F) / 15.0f;
-                beeper_set_volume(&sys->beeper_1, vol);
-                beeper_set_volume(&sys->beeper_2, vol);
+                if (beeper_events_full(&sys->beeper_1) || beeper_events_full(&sys->beeper_2)) {
+                    _kc85_sync_beepers(sys);
+                }
+                beeper_set_volume_at(&sys->beeper_1, sys->beeper_num_deferred, vol);
+                beeper_set_volume_at(&sys->beeper_2, sys->beeper_num_deferred, vol);
             }
             // PIO-B bit 0 cleared forces the audio beeper flip flop to low
             if (0 == (pins & Z80PIO_PB0)) {
@@ -967,20 +1044,13 @@ static uint64_t _kc85_tick(kc85_t* sys, uint64_t pins) {
         pins &= Z80_PIN_MASK;
     }
 
-    // tick the audio beepers
-    beeper_set(&sys->beeper_1, sys->flip_flops & KC85_FLIPFLOP_BEEPER_1);
-    beeper_set(&sys->beeper_2, sys->flip_flops & KC85_FLIPFLOP_BEEPER_2);
-    beeper_tick(&sys->beeper_1);
-    if (beeper_tick(&sys->beeper_2)) {
-        // new audio sample ready
-        sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->beeper_1.sample + sys->beeper_2.sample;
-        if (sys->audio.sample_pos == sys->audio.num_samples) {
-            if (sys->audio.callback.func) {
-                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
-            }
-            sys->audio.sample_pos = 0;
-        }
+    // tick the audio beepers (deferred, see _kc85_sync_beepers())
+    if (beeper_events_full(&sys->beeper_1) || beeper_events_full(&sys->beeper_2)) {
+        _kc85_sync_beepers(sys);
     }
+    beeper_set_at(&sys->beeper_1, sys->beeper_num_deferred, sys->flip_flops & KC85_FLIPFLOP_BEEPER_1);
+    beeper_set_at(&sys->beeper_2, sys->beeper_num_deferred, sys->flip_flops & KC85_FLIPFLOP_BEEPER_2);
+    sys->beeper_num_deferred++;
 
     // IO port 0x80: expansion module control, high byte of
     // port address contains module slot address
@@ -1038,6 +1108,7 @@ uint32_t kc85_exec(kc85_t* sys, uint32_t micro_seconds) {
             sys->debug.callback.func(sys->debug.callback.user_data, pins);
         }
     }
+    _kc85_sync_beepers(sys);
     sys->pins = pins;
     kbd_update(&sys->kbd, micro_seconds);
     _kc85_handle_keyboard(sys);
@@ -1712,14 +1783,43 @@ chips_display_info_t kc85_display_info(kc85_t* sys) {
     return res;
 }
 
+// get the ROM images referenced by snapshots, returns number of ROM images
+static size_t _kc85_shared_roms(kc85_t* sys, mem_ext_t* roms) {
+    #if defined(CHIPS_SHARED_ROMS)
+        size_t num_roms = 0;
+        roms[num_roms++] = (mem_ext_t){ .ptr = sys->rom_caos_e, .size = 0x2000 };
+        #if defined(CHIPS_KC85_TYPE_3) || defined(CHIPS_KC85_TYPE_4)
+            roms[num_roms++] = (mem_ext_t){ .ptr = sys->rom_basic, .size = 0x2000 };
+        #endif
+        #if defined(CHIPS_KC85_TYPE_4)
+            roms[num_roms++] = (mem_ext_t){ .ptr = sys->rom_caos_c, .size = 0x1000 };
+        #endif
+        return num_roms;
+    #else
+        (void)sys; (void)roms;
+        return 0;
+    #endif
+}
+
 uint32_t kc85_save_snapshot(kc85_t* sys, kc85_t* dst) {
     CHIPS_ASSERT(sys && dst);
+    mem_ext_t roms[3] = {{0}};
+    const size_t num_roms = _kc85_shared_roms(sys, roms);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     dst->patch_callback.func = 0;
     dst->patch_callback.user_data = 0;
-    mem_snapshot_onsave(&dst->mem, sys);
+    mem_snapshot_onsave_ext(&dst->mem, sys, roms, num_roms);
+    #if defined(CHIPS_SHARED_ROMS)
+        #if defined(CHIPS_KC85_TYPE_3) || defined(CHIPS_KC85_TYPE_4)
+            dst->rom_basic = 0;
+        #endif
+        #if defined(CHIPS_KC85_TYPE_4)
+            dst->rom_caos_c = 0;
+        #endif
+        dst->rom_caos_e = 0;
+    #endif
     return KC85_SNAPSHOT_VERSION;
 }
 
@@ -1729,13 +1829,30 @@ bool kc85_load_snapshot(kc85_t* sys, uint32_t version, const kc85_t* src) {
     if (version != KC85_SNAPSHOT_VERSION) {
         return false;
     }
+    #if defined(CHIPS_SHARED_ROMS)
+        // the snapshot only references the ROM images, these must be identical
+        if (src->rom_id != sys->rom_id) {
+            return false;
+        }
+    #endif
+    mem_ext_t roms[3] = {{0}};
+    const size_t num_roms = _kc85_shared_roms(sys, roms);
     // intermediate copy
     static kc85_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     im.patch_callback = sys->patch_callback;
-    mem_snapshot_onload(&im.mem, sys);
+    mem_snapshot_onload_ext(&im.mem, sys, roms, num_roms);
+    #if defined(CHIPS_SHARED_ROMS)
+        #if defined(CHIPS_KC85_TYPE_3) || defined(CHIPS_KC85_TYPE_4)
+            im.rom_basic = sys->rom_basic;
+        #endif
+        #if defined(CHIPS_KC85_TYPE_4)
+            im.rom_caos_c = sys->rom_caos_c;
+        #endif
+        im.rom_caos_e = sys->rom_caos_e;
+    #endif
     *sys = im;
     return true;
 }
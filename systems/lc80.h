@@ -77,7 +77,7 @@ extern "C" {
 #endif
 
 // bump this whenever the lc80_t struct layout changes
-#define LC80_SNAPSHOT_VERSION (0x0001)
+#define LC80_SNAPSHOT_VERSION (0x0003)
 
 // key codes (for lc80_key(), lc80_key_down(), lc80_key_up()
 #define LC80_KEY_0      ('0')
@@ -207,6 +207,7 @@ typedef struct {
     uint32_t ds8205[2];         // pin state of the 2 DS8205 3-to-8 decoders (equiv LS138)
     uint8_t pio_b;              // last PIO port B state
     beeper_t beeper;
+    uint32_t beeper_num_deferred;   // ticks since the last beeper_run(), see _lc80_sync_beeper()
     bool reset;
     bool nmi;
 
@@ -328,6 +329,7 @@ void lc80_reset(lc80_t* sys) {
     z80pio_reset(&sys->pio_sys);
     z80pio_reset(&sys->pio_usr);
     beeper_reset(&sys->beeper);
+    sys->beeper_num_deferred = 0;
     sys->pins = z80_prefetch(&sys->cpu, 0x0000);
 }
 
@@ -379,6 +381,29 @@ static uint32_t _lc80_vqe23_write(uint32_t vqe23, int digit, uint8_t data) {
     return vqe23;
 }
 
+/* The beeper runs in event mode, output changes are recorded with their
+   tick offset, and the samples are generated in one go when the change
+   buffer is full, and at the end of lc80_exec().
+*/
+static void _lc80_sync_beeper(lc80_t* sys) {
+    uint32_t num_ticks = sys->beeper_num_deferred;
+    while (num_ticks > 0) {
+        int num_samples = 0;
+        num_ticks -= beeper_run(&sys->beeper, num_ticks,
+            &sys->audio.sample_buffer[sys->audio.sample_pos],
+            sys->audio.num_samples - sys->audio.sample_pos,
+            &num_samples);
+        sys->audio.sample_pos += num_samples;
+        if (sys->audio.sample_pos == sys->audio.num_samples) {
+            if (sys->audio.callback.func) {
+                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
+            }
+            sys->audio.sample_pos = 0;
+        }
+    }
+    sys->beeper_num_deferred = 0;
+}
+
 // LC80 CPU tick callback
 uint64_t _lc80_tick(lc80_t* sys, uint64_t pins) {
     pins = z80_tick(&sys->cpu, pins);
@@ -486,7 +511,10 @@ uint64_t _lc80_tick(lc80_t* sys, uint64_t pins) {
         const uint8_t pio_b = Z80PIO_GET_PB(pins);
 
         /* TAPE OUT */
-        beeper_set(&sys->beeper, 0 == (pio_b & (1<<1)));
+        if (beeper_events_full(&sys->beeper)) {
+            _lc80_sync_beeper(sys);
+        }
+        beeper_set_at(&sys->beeper, sys->beeper_num_deferred, 0 == (pio_b & (1<<1)));
 
         /* LED display update
 
@@ -547,17 +575,8 @@ uint64_t _lc80_tick(lc80_t* sys, uint64_t pins) {
         pins &= Z80_PIN_MASK;
     }
 
-    // tick beeper
-    if (beeper_tick(&sys->beeper)) {
-        /* new audio sample ready */
-        sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->beeper.sample;
-        if (sys->audio.sample_pos == sys->audio.num_samples) {
-            if (sys->audio.callback.func) {
-                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
-            }
-            sys->audio.sample_pos = 0;
-        }
-    }
+    // tick beeper (deferred, see _lc80_sync_beeper())
+    sys->beeper_num_deferred++;
     if (sys->nmi) {
         pins |= Z80_NMI;
     }
@@ -584,6 +603,7 @@ uint32_t lc80_exec(lc80_t* sys, uint32_t micro_seconds) {
             sys->debug.callback.func(sys->debug.callback.user_data, pins);
         }
     }
+    _lc80_sync_beeper(sys);
     sys->pins = pins;
     if (sys->nmi) {
         sys->nmi = false;
@@ -68,7 +68,7 @@ extern "C" {
 #endif
 
 // increase when namco_t memory layout changes
-#define NAMCO_SNAPSHOT_VERSION (1)
+#define NAMCO_SNAPSHOT_VERSION (3)
 
 #define NAMCO_MAX_AUDIO_SAMPLES (1024)
 #define NAMCO_DEFAULT_AUDIO_SAMPLES (128)
@@ -167,6 +167,11 @@ typedef struct {
     uint8_t clut_select;    // Pengo only
     uint8_t tile_select;    // Pengo only
     uint8_t sprite_coords[16];      // 8 sprites, uint8_t x, uint8_t y
+    // background tiles which need to be redrawn (see _namco_decode_chars())
+    struct {
+        bool all;                       // redraw all tiles
+        uint8_t bits[0x0400/8];         // one bit per video/color RAM offset
+    } dirty;
 
     bool valid;
     chips_debug_t debug;
@@ -176,7 +181,11 @@ typedef struct {
     uint8_t color_ram[0x0400];
     uint8_t main_ram[0x0800];       // Pacman: 1 KB, Pengo: 2 KB
     uint8_t rom_cpu[0x8000];        // program ROM: Pacman: 16 KB, Pengo: 32 KB
-    uint8_t rom_gfx[0x4000];        // tile ROM: Pacman: 8 KB, Pengo: 16 KB
+    // tile and sprite ROM decoded to one byte per pixel (see _namco_unpack_chars()), Pacman: 1 bank, Pengo: 2 banks
+    struct {
+        alignas(64) uint8_t chars[2][256][8*8];
+        alignas(64) uint8_t sprites[2][64][16*16];
+    } gfx;
     uint8_t rom_prom[0x0420];       // palette and color lookup ROM
     uint32_t hw_colors[32];         // decoded color palette from palette ROM
     uint8_t palette_cache[512];     // palette indirection table, Pacman: 256 entries , Pengo: 512 entries
@@ -220,6 +229,7 @@ bool namco_load_snapshot(namco_t* sys, uint32_t version, namco_t* src);
 #if defined NAMCO_PACMAN
     #define NAMCO_ADDR_MASK         (0x7FFF)    /* Pacman has only 15 addr pins wired */
     #define NAMCO_IOMAP_BASE        (0x5000)
+    #define NAMCO_ADDR_VIDEO_RAM    (0x4000)    /* video RAM followed by color RAM */
     #define NAMCO_ADDR_SPRITES_ATTR (0x03F0)    /* offset in main_ram */
     /* IN0 bits (active low) */
     #define NAMCO_IN0_UP            (1<<0)
@@ -274,6 +284,7 @@ bool namco_load_snapshot(namco_t* sys, uint32_t version, namco_t* src);
 #else /* PENGO */
     #define NAMCO_ADDR_MASK         (0xFFFF)        /* Pengo has 16 address lines */
     #define NAMCO_IOMAP_BASE        (0x9000)
+    #define NAMCO_ADDR_VIDEO_RAM    (0x8000)        /* video RAM followed by color RAM */
     #define NAMCO_ADDR_SPRITES_ATTR (0x07F0)        /* offset in main_ram */
     /* IN0 bits (active low) */
     #define NAMCO_IN0_UP            (1<<0)
@@ -387,6 +398,42 @@ static void _namco_sound_tick(namco_t* sys);
 
 #define _namco_def(val, def) (val == 0 ? def : val)
 
+/* Decode an 8x4 pixel strip of tile ROM data into one byte per pixel.
+
+    Each byte in the tile ROM holds the 2-bit pixels of a row of 4 pixels,
+    the high bits in the upper nibble, the low bits in the lower nibble.
+*/
+static void _namco_unpack_8x4(uint8_t* dst, uint32_t dst_pitch, const uint8_t* src) {
+    for (uint32_t yy = 0; yy < 8; yy++) {
+        for (uint32_t xx = 0; xx < 4; xx++) {
+            uint8_t p2_hi = (src[yy]>>(7-xx)) & 1;
+            uint8_t p2_lo = (src[yy]>>(3-xx)) & 1;
+            dst[yy * dst_pitch + xx] = (p2_hi<<1)|p2_lo;
+        }
+    }
+}
+
+// decode 256 background tiles (8x8 pixels, 16 bytes per tile)
+static void _namco_unpack_chars(uint8_t dst[256][8*8], const uint8_t* src) {
+    for (uint32_t i = 0; i < 256; i++) {
+        _namco_unpack_8x4(&dst[i][0], 8, &src[i * 16 + 8]);
+        _namco_unpack_8x4(&dst[i][4], 8, &src[i * 16 + 0]);
+    }
+}
+
+// decode 64 sprites (16x16 pixels, 64 bytes per sprite)
+static void _namco_unpack_sprites(uint8_t dst[64][16*16], const uint8_t* src) {
+    // ROM offsets of the 8x4 strips, left to right, top to bottom
+    static const uint32_t strips[2][4] = { { 8, 16, 24, 0 }, { 40, 48, 56, 32 } };
+    for (uint32_t i = 0; i < 64; i++) {
+        for (uint32_t y = 0; y < 2; y++) {
+            for (uint32_t x = 0; x < 4; x++) {
+                _namco_unpack_8x4(&dst[i][(y * 8) * 16 + x * 4], 16, &src[i * 64 + strips[y][x]]);
+            }
+        }
+    }
+}
+
 void namco_init(namco_t* sys, const namco_desc_t* desc) {
     CHIPS_ASSERT(sys && desc);
     if (desc->debug.callback.func) { CHIPS_ASSERT(desc->debug.stopped); }
@@ -425,16 +472,18 @@ void namco_init(namco_t* sys, const namco_desc_t* desc) {
     memcpy(&sys->rom_cpu[0x5000], desc->roms.pengo.cpu_5000_5FFF.ptr, 0x1000);
     memcpy(&sys->rom_cpu[0x6000], desc->roms.pengo.cpu_6000_6FFF.ptr, 0x1000);
     memcpy(&sys->rom_cpu[0x7000], desc->roms.pengo.cpu_7000_7FFF.ptr, 0x1000);
-    memcpy(&sys->rom_gfx[0x0000], desc->roms.pengo.gfx_0000_1FFF.ptr, 0x2000);
-    memcpy(&sys->rom_gfx[0x2000], desc->roms.pengo.gfx_2000_3FFF.ptr, 0x2000);
+    _namco_unpack_chars(sys->gfx.chars[0], (const uint8_t*)desc->roms.pengo.gfx_0000_1FFF.ptr);
+    _namco_unpack_sprites(sys->gfx.sprites[0], (const uint8_t*)desc->roms.pengo.gfx_0000_1FFF.ptr + 0x1000);
+    _namco_unpack_chars(sys->gfx.chars[1], (const uint8_t*)desc->roms.pengo.gfx_2000_3FFF.ptr);
+    _namco_unpack_sprites(sys->gfx.sprites[1], (const uint8_t*)desc->roms.pengo.gfx_2000_3FFF.ptr + 0x1000);
     memcpy(&sys->rom_prom[0x0020], desc->roms.pengo.prom_0020_041F.ptr, 0x0400);
     #endif
     #if defined(NAMCO_PACMAN)
     CHIPS_ASSERT(desc->roms.pacman.gfx_0000_0FFF.ptr && (desc->roms.pacman.gfx_0000_0FFF.size == 0x1000));
     CHIPS_ASSERT(desc->roms.pacman.gfx_1000_1FFF.ptr && (desc->roms.pacman.gfx_1000_1FFF.size == 0x1000));
     CHIPS_ASSERT(desc->roms.pacman.prom_0020_011F.ptr && (desc->roms.pacman.prom_0020_011F.size == 0x0100));
-    memcpy(&sys->rom_gfx[0x0000], desc->roms.pacman.gfx_0000_0FFF.ptr, 0x1000);
-    memcpy(&sys->rom_gfx[0x1000], desc->roms.pacman.gfx_1000_1FFF.ptr, 0x1000);
+    _namco_unpack_chars(sys->gfx.chars[0], (const uint8_t*)desc->roms.pacman.gfx_0000_0FFF.ptr);
+    _namco_unpack_sprites(sys->gfx.sprites[0], (const uint8_t*)desc->roms.pacman.gfx_1000_1FFF.ptr);
     memcpy(&sys->rom_prom[0x0020], desc->roms.pacman.prom_0020_011F.ptr, 0x0100);
     #endif
 
@@ -521,6 +570,7 @@ void namco_init(namco_t* sys, const namco_desc_t* desc) {
         sys->palette_cache[i] = pal_index;
         sys->palette_cache[256 + i] = 0x10 | pal_index;
     }
+    sys->dirty.all = true;
 }
 
 void namco_discard(namco_t* sys) {
@@ -531,6 +581,21 @@ void namco_discard(namco_t* sys) {
 void namco_reset(namco_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     z80_reset(&sys->cpu);
+    sys->dirty.all = true;
+}
+
+// mark a background tile dirty by its video/color RAM offset
+static inline void _namco_tile_dirty(namco_t* sys, uint16_t offset) {
+    sys->dirty.bits[(offset & 0x3FF)>>3] |= 1<<(offset & 7);
+}
+
+// track writes to video and color RAM for the background tile renderer
+static inline void _namco_video_ram_wr(namco_t* sys, uint16_t addr, uint8_t data) {
+    const uint16_t offset = addr & 0x3FF;
+    const uint8_t* ram = (addr & 0x400) ? sys->color_ram : sys->video_ram;
+    if (ram[offset] != data) {
+        _namco_tile_dirty(sys, offset);
+    }
 }
 
 static uint64_t _namco_tick(namco_t* sys, uint64_t pins) {
@@ -556,6 +621,9 @@ static uint64_t _namco_tick(namco_t* sys, uint64_t pins) {
             // memory write access
             uint8_t data = Z80_GET_DATA(pins);
             if (addr < NAMCO_IOMAP_BASE) {
+                if ((addr & 0xF800) == NAMCO_ADDR_VIDEO_RAM) {
+                    _namco_video_ram_wr(sys, addr, data);
+                }
                 mem_wr(&sys->mem, addr, data);
             }
             else {
@@ -571,12 +639,15 @@ static uint64_t _namco_tick(namco_t* sys, uint64_t pins) {
                 }
                 #if defined(NAMCO_PENGO)
                 else if (addr == NAMCO_ADDR_PAL_SELECT) {
+                    sys->dirty.all |= sys->pal_select != (data & 1);
                     sys->pal_select = data & 1;
                 }
                 else if (addr == NAMCO_ADDR_CLUT_SELECT) {
+                    sys->dirty.all |= sys->clut_select != (data & 1);
                     sys->clut_select = data & 1;
                 }
                 else if (addr == NAMCO_ADDR_TILE_SELECT) {
+                    sys->dirty.all |= sys->tile_select != (data & 1);
                     sys->tile_select = data & 1;
                 }
                 #endif
@@ -653,64 +724,59 @@ static uint16_t _namco_video_offset(uint32_t x, uint32_t y) {
     return offset;
 }
 
-// 8x4 video tile decoder (used both for background tiles and sprites)
-static inline void _namco_8x4(
-    uint8_t* fb,
-    uint8_t* tile_base,
-    uint8_t* pal_base,
-    uint8_t* pal_rom,
-    uint32_t tile_stride,
-    uint32_t tile_offset,
-    uint32_t px,
-    uint32_t py,
-    uint8_t char_code,
-    uint8_t color_code,
-    bool opaque,
-    bool flip_x,
-    bool flip_y)
-{
-    uint32_t xor_x = flip_x ? 3 : 0;
-    uint32_t xor_y = flip_y ? 7 : 0;
-    for (uint32_t yy = 0; yy < 8; yy++) {
-        uint32_t y = py + (yy ^ xor_y);
-        if (y >= NAMCO_DISPLAY_HEIGHT) {
-            continue;
-        }
-        int tile_index = char_code * tile_stride + tile_offset + yy;
-        for (uint32_t xx = 0; xx < 4; xx++) {
-            uint32_t x = px + (xx ^ xor_x);
-            if (x >= NAMCO_DISPLAY_WIDTH) {
-                continue;
-            }
-            uint8_t p2_hi = (tile_base[tile_index]>>(7-xx)) & 1;
-            uint8_t p2_lo = (tile_base[tile_index]>>(3-xx)) & 1;
-            uint8_t p2 = (p2_hi<<1)|p2_lo;
-            uint8_t hw_color = pal_base[(color_code<<2)|p2];
-            if (opaque || (pal_rom[hw_color] != 0)) {
-                fb[y * NAMCO_FRAMEBUFFER_WIDTH + x] = hw_color;
-            }
-        }
-    }
-}
+/* decode background tiles
 
-// decode background tiles
+    Only tiles which have changed since the last frame are decoded, a
+    tile is dirty when its video or color RAM byte has been written with
+    a new value, or when it has been overdrawn by a sprite in the last
+    frame (see _namco_decode_sprites()). Changing the palette, color
+    lookup table or tile bank selection redraws all tiles.
+*/
 static void _namco_decode_chars(namco_t* sys) {
-    uint8_t* pal_base = &sys->palette_cache[(sys->pal_select<<8)|(sys->clut_select<<7)];
-    uint8_t* tile_base = &sys->rom_gfx[0x0000] + (sys->tile_select * 0x2000);
+    const uint8_t* pal_base = &sys->palette_cache[(sys->pal_select<<8)|(sys->clut_select<<7)];
+    const bool all = sys->dirty.all;
     for (uint32_t y = 0; y < 28; y++) {
         for (uint32_t x = 0; x < 36; x++) {
             uint16_t offset = _namco_video_offset(x, y);
+            if (!all && (0 == (sys->dirty.bits[offset>>3] & (1<<(offset & 7))))) {
+                continue;
+            }
             uint8_t char_code = sys->video_ram[offset];
             uint8_t color_code = sys->color_ram[offset] & 0x1F;
-            _namco_8x4(sys->fb, tile_base, pal_base, sys->rom_prom, 16, 8, x*8, y*8, char_code, color_code, true, false, false);
-            _namco_8x4(sys->fb, tile_base, pal_base, sys->rom_prom, 16, 0, x*8+4, y*8, char_code, color_code, true, false, false);
+            const uint8_t* colors = &pal_base[color_code<<2];
+            const uint8_t* src = sys->gfx.chars[sys->tile_select][char_code];
+            uint8_t* dst = &sys->fb[(y * 8) * NAMCO_FRAMEBUFFER_WIDTH + x * 8];
+            for (uint32_t yy = 0; yy < 8; yy++, src += 8, dst += NAMCO_FRAMEBUFFER_WIDTH) {
+                for (uint32_t xx = 0; xx < 8; xx++) {
+                    dst[xx] = colors[src[xx]];
+                }
+            }
+        }
+    }
+    sys->dirty.all = false;
+    memset(sys->dirty.bits, 0, sizeof(sys->dirty.bits));
+}
+
+// mark the background tiles under a 16x16 sprite dirty, so they are restored in the next frame
+static void _namco_sprite_dirty(namco_t* sys, uint32_t px, uint32_t py) {
+    // px/py may have wrapped around for sprites partially above the screen
+    const int x0 = (int)px;
+    const int y0 = (int)py;
+    for (int y = y0 & ~7; y < y0 + 16; y += 8) {
+        if ((y < 0) || (y >= NAMCO_DISPLAY_HEIGHT)) {
+            continue;
+        }
+        for (int x = x0 & ~7; x < x0 + 16; x += 8) {
+            if ((x < 0) || (x >= NAMCO_DISPLAY_WIDTH)) {
+                continue;
+            }
+            _namco_tile_dirty(sys, _namco_video_offset((uint32_t)x>>3, (uint32_t)y>>3));
         }
     }
 }
 
 static void _namco_decode_sprites(namco_t* sys) {
-    uint8_t* pal_base = &sys->palette_cache[(sys->pal_select<<8)|(sys->clut_select<<7)];
-    uint8_t* tile_base = &sys->rom_gfx[0x1000] + (sys->tile_select * 0x2000);
+    const uint8_t* pal_base = &sys->palette_cache[(sys->pal_select<<8)|(sys->clut_select<<7)];
     #if defined(NAMCO_PACMAN)
     const int max_sprite = 6;
     const int min_sprite = 1;
@@ -723,23 +789,35 @@ static void _namco_decode_sprites(namco_t* sys) {
         uint32_t px = 272 - sys->sprite_coords[sprite_index*2 + 1];
         uint8_t shape = sys->main_ram[NAMCO_ADDR_SPRITES_ATTR + sprite_index*2 + 0];
         uint8_t char_code = shape>>2;
-        uint8_t color_code = sys->main_ram[NAMCO_ADDR_SPRITES_ATTR + sprite_index*2 + 1];
+        uint8_t color_code = sys->main_ram[NAMCO_ADDR_SPRITES_ATTR + sprite_index*2 + 1] & 0x1F;
         bool flip_x = shape & 1;
         bool flip_y = shape & 2;
-        uint32_t fy0 = flip_y ? 8 : 0;
-        uint32_t fy1 = flip_y ? 0 : 8;
-        uint32_t fx0 = flip_x ? 12: 0;
-        uint32_t fx1 = flip_x ? 8 : 4;
-        uint32_t fx2 = flip_x ? 4 : 8;
-        uint32_t fx3 = flip_x ? 0 :12;
-        _namco_8x4(sys->fb, tile_base, pal_base, sys->rom_prom, 64, 8,  px+fx0, py+fy0, char_code, color_code, false, flip_x, flip_y);
-        _namco_8x4(sys->fb, tile_base, pal_base, sys->rom_prom, 64, 16, px+fx1, py+fy0, char_code, color_code, false, flip_x, flip_y);
-        _namco_8x4(sys->fb, tile_base, pal_base, sys->rom_prom, 64, 24, px+fx2, py+fy0, char_code, color_code, false, flip_x, flip_y);
-        _namco_8x4(sys->fb, tile_base, pal_base, sys->rom_prom, 64, 0,  px+fx3, py+fy0, char_code, color_code, false, flip_x, flip_y);
-        _namco_8x4(sys->fb, tile_base, pal_base, sys->rom_prom, 64, 40, px+fx0, py+fy1, char_code, color_code, false, flip_x, flip_y);
-        _namco_8x4(sys->fb, tile_base, pal_base, sys->rom_prom, 64, 48, px+fx1, py+fy1, char_code, color_code, false, flip_x, flip_y);
-        _namco_8x4(sys->fb, tile_base, pal_base, sys->rom_prom, 64, 56, px+fx2, py+fy1, char_code, color_code, false, flip_x, flip_y);
-        _namco_8x4(sys->fb, tile_base, pal_base, sys->rom_prom, 64, 32, px+fx3, py+fy1, char_code, color_code, false, flip_x, flip_y);
+        const uint8_t* colors = &pal_base[color_code<<2];
+        const uint8_t* src = sys->gfx.sprites[sys->tile_select][char_code];
+        // pixels with a black palette color are transparent
+        bool opaque[4];
+        for (int i = 0; i < 4; i++) {
+            opaque[i] = sys->rom_prom[colors[i]] != 0;
+        }
+        for (uint32_t yy = 0; yy < 16; yy++) {
+            uint32_t y = py + yy;
+            if (y >= NAMCO_DISPLAY_HEIGHT) {
+                continue;
+            }
+            const uint8_t* src_row = &src[(flip_y ? (15 - yy) : yy) * 16];
+            uint8_t* dst = &sys->fb[y * NAMCO_FRAMEBUFFER_WIDTH];
+            for (uint32_t xx = 0; xx < 16; xx++) {
+                uint32_t x = px + xx;
+                if (x >= NAMCO_DISPLAY_WIDTH) {
+                    continue;
+                }
+                uint8_t p = src_row[flip_x ? (15 - xx) : xx];
+                if (opaque[p]) {
+                    dst[x] = colors[p];
+                }
+            }
+        }
+        _namco_sprite_dirty(sys, px, py);
     }
 }
 
@@ -1021,6 +1099,7 @@ bool namco_load_snapshot(namco_t* sys, uint32_t version, namco_t* src) {
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
     chips_audio_callback_snapshot_onload(&im.sound.callback, &sys->sound.callback);
     mem_snapshot_onload(&im.mem, sys);
+    im.dirty.all = true;
     *sys = im;
     return true;
 }
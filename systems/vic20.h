@@ -18,6 +18,15 @@
     ~~~
         your own assert macro (default: assert(c))
 
+    ~~~C
+    CHIPS_SHARED_ROMS
+    ~~~
+        if defined, the ROM images in vic20_desc_t.roms are mapped directly
+        instead of being copied into vic20_t, the ROM data must outlive the
+        emulator instance (for instance ROM images in flash memory, or
+        shared between several emulator instances), snapshots only contain
+        an identity hash of the ROM images
+
     You need to include the following headers before including vic20.h:
 
     - chips/chips_common.h
@@ -29,6 +38,30 @@
     - chips/clk.h
     - systems/c1530.h
 
+    ## Forking
+
+    vic20_fork() clones a running emulator instance much faster than
+    vic20_save_snapshot() followed by vic20_load_snapshot(), which is useful
+    for state-space search or fuzzing. Instead of copying the RAM, the parent
+    and all its clones share their RAM pages through a caller-owned
+    mem_page_pool_t (provided in vic20_desc_t.page_pool), a shared page
+    is copied back into an instance's own RAM on the first write which
+    changes it. Only the chip state, memory mapping tables and color RAM
+    are copied eagerly (and the ROM images, unless CHIPS_SHARED_ROMS is
+    defined). The framebuffer isn't copied, the clone's framebuffer
+    content is undefined until the next frame has been rendered.
+
+    Only RAM pages which are mapped into the CPU address space are shared,
+    unused expansion RAM is copied. The page pool must outlive all instances
+    using it, and needs one page per mapped RAM page and instance (5 for
+    an unexpanded VIC-20, at most VIC20_NUM_RAM_PAGES). If the pool is
+    exhausted, the remaining RAM pages are copied.
+
+    The destination of vic20_fork() must either be zero-initialized (or
+    discarded), or a valid instance, which is discarded first (releasing
+    its shared pages). The page pool isn't thread-safe, all instances
+    sharing a pool must be forked, run and discarded on the same thread.
+
     ## The Commodore VIC-20
 
 
@@ -65,11 +98,12 @@ extern "C" {
 #endif
 
 // bump snapshot version when vic20_t memory layout changes
-#define VIC20_SNAPSHOT_VERSION (1)
+#define VIC20_SNAPSHOT_VERSION (6)
 
 #define VIC20_FREQUENCY (1108404)
 #define VIC20_MAX_AUDIO_SAMPLES (1024)        // max number of audio samples in internal sample buffer
 #define VIC20_DEFAULT_AUDIO_SAMPLES (128)     // default number of samples in internal sample buffer
+#define VIC20_NUM_RAM_PAGES (40)              // number of 1 KByte RAM pages which can be shared by vic20_fork()
 
 // VIC-20 joystick types (only one joystick supported)
 typedef enum {
@@ -110,10 +144,12 @@ typedef enum {
 // config parameters for vic20_init()
 typedef struct {
     bool c1530_enabled;             // set to true to enable C1530 datassette emulation
+    bool idle_skip_disabled;        // set to true to disable fast-forwarding through idle loops
     vic20_joystick_type_t joystick_type;    // default is VIC20_JOYSTICK_NONE
     vic20_memory_config_t mem_config;       // default is VIC20_MEMCONFIG_STANDARD
     chips_debug_t debug;            // optional debugging hook
     chips_audio_desc_t audio;
+    mem_page_pool_t* page_pool;     // optional shared RAM page pool for vic20_fork()
     struct {
         chips_range_t chars;    // 4 KByte character ROM dump
         chips_range_t basic;    // 8 KByte BASIC dump
@@ -144,6 +180,24 @@ typedef struct {
     bool valid;
     chips_debug_t debug;
 
+    // idle-loop detection state (see _vic20_idle_detect())
+    struct {
+        bool enabled;
+        bool dirty;             // I/O access or memory modified since loop start
+        uint16_t prev_pc;       // address of previous opcode fetch
+        uint16_t loop_pc;       // start address of current idle-loop candidate
+        uint32_t ticks;         // ticks since loop start
+        uint64_t pins;          // CPU pins at loop start
+        m6502_t cpu;            // CPU state at loop start
+    } idle;
+
+    // copy-on-write RAM page sharing (see vic20_fork())
+    struct {
+        mem_page_pool_t* pool;
+        uint64_t write_mask;    // CPU-visible pages which are mapped to shared pages for writing
+        mem_shared_page_t* pages[VIC20_NUM_RAM_PAGES];  // shared page of each RAM page, 0 if private
+    } cow;
+
     struct {
         chips_audio_callback_t callback;
         int num_samples;
@@ -155,9 +209,16 @@ typedef struct {
     uint8_t ram0[0x0400];           // 1 KB zero page, stack, system work area
     uint8_t ram_3k[0x0C00];         // optional 3K exp RAM
     uint8_t ram1[0x1000];           // 4 KB main RAM
+    #if defined(CHIPS_SHARED_ROMS)
+    const uint8_t* rom_char;        // 4 KB character ROM image
+    const uint8_t* rom_basic;       // 8 KB BASIC ROM image
+    const uint8_t* rom_kernal;      // 8 KB KERNAL V3 ROM image
+    uint32_t rom_id;                // identity hash of ROM images, checked in vic20_load_snapshot()
+    #else
     uint8_t rom_char[0x1000];       // 4 KB character ROM image
     uint8_t rom_basic[0x2000];      // 8 KB BASIC ROM image
     uint8_t rom_kernal[0x2000];     // 8 KB KERNAL V3 ROM image
+    #endif
     uint8_t ram_exp[4][0x2000];     // optional expansion 8K RAM blocks
     uint8_t fb[M6561_FRAMEBUFFER_SIZE_BYTES];
 
@@ -208,6 +269,8 @@ bool vic20_is_tape_motor_on(vic20_t* sys);
 uint32_t vic20_save_snapshot(vic20_t* sys, vic20_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
 bool vic20_load_snapshot(vic20_t* sys, uint32_t version, vic20_t* src);
+// clone an emulator instance into dst, sharing RAM pages copy-on-write (requires vic20_desc_t.page_pool)
+void vic20_fork(vic20_t* sys, vic20_t* dst);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -231,6 +294,102 @@ static void _vic20_init_key_map(vic20_t* sys);
 
 #define _VIC20_DEFAULT(val,def) (((val) != 0) ? (val) : (def))
 
+/*
+    Copy-on-write RAM page sharing.
+
+    A RAM page is either private (mapped to the instance's own RAM arrays),
+    or shared (mapped to a page in the page pool). Writes which change the
+    content of a shared page copy the page back into private RAM first.
+*/
+
+// get the private host memory of a RAM page
+static uint8_t* _vic20_ram_page(vic20_t* sys, size_t index) {
+    CHIPS_ASSERT(index < VIC20_NUM_RAM_PAGES);
+    if (index < 1) {
+        return sys->ram0;
+    }
+    else if (index < 4) {
+        return sys->ram_3k + (index - 1) * MEM_PAGE_SIZE;
+    }
+    else if (index < 8) {
+        return sys->ram1 + (index - 4) * MEM_PAGE_SIZE;
+    }
+    else {
+        return &sys->ram_exp[0][0] + (index - 8) * MEM_PAGE_SIZE;
+    }
+}
+
+// check if a RAM page is mapped into the CPU address space (as RAM or cartridge ROM)
+static bool _vic20_ram_page_mapped(vic20_t* sys, const uint8_t* ram) {
+    for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
+        const uint16_t addr = page << MEM_PAGE_SHIFT;
+        if ((mem_readptr(&sys->mem_cpu, addr) == ram) || (mem_writeptr(&sys->mem_cpu, addr) == ram)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void _vic20_cow_remap(vic20_t* sys, const uint8_t* old_ptr, uint8_t* new_ptr) {
+    mem_remap_page(&sys->mem_cpu, old_ptr, new_ptr);
+    mem_remap_page(&sys->mem_vic, old_ptr, new_ptr);
+    mem_remap_page(&sys->mem_cart, old_ptr, new_ptr);
+}
+
+// find the CPU-visible pages where writes end up in a shared page
+static void _vic20_cow_update_write_mask(vic20_t* sys) {
+    uint64_t mask = 0;
+    if (sys->cow.pool) {
+        for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
+            if (mem_pool_contains(sys->cow.pool, mem_writeptr(&sys->mem_cpu, page << MEM_PAGE_SHIFT))) {
+                mask |= 1ULL << page;
+            }
+        }
+    }
+    sys->cow.write_mask = mask;
+}
+
+static void _vic20_cow_unshare(vic20_t* sys, size_t index) {
+    mem_shared_page_t* page = sys->cow.pages[index];
+    uint8_t* ram = _vic20_ram_page(sys, index);
+    memcpy(ram, page->data, MEM_PAGE_SIZE);
+    _vic20_cow_remap(sys, page->data, ram);
+    mem_unref_page(page);
+    sys->cow.pages[index] = 0;
+}
+
+// called before a write which changes the content of a shared page
+static void _vic20_cow_unshare_addr(vic20_t* sys, uint16_t addr) {
+    const uint8_t* ptr = mem_writeptr(&sys->mem_cpu, addr & ~MEM_PAGE_MASK);
+    for (size_t i = 0; i < VIC20_NUM_RAM_PAGES; i++) {
+        if (sys->cow.pages[i] && (sys->cow.pages[i]->data == ptr)) {
+            _vic20_cow_unshare(sys, i);
+            break;
+        }
+    }
+    _vic20_cow_update_write_mask(sys);
+}
+
+static void _vic20_cow_unshare_all(vic20_t* sys) {
+    for (size_t i = 0; i < VIC20_NUM_RAM_PAGES; i++) {
+        if (sys->cow.pages[i]) {
+            _vic20_cow_unshare(sys, i);
+        }
+    }
+    sys->cow.write_mask = 0;
+}
+
+// drop all shared page references without copying (RAM content becomes undefined)
+static void _vic20_cow_release(vic20_t* sys) {
+    for (size_t i = 0; i < VIC20_NUM_RAM_PAGES; i++) {
+        if (sys->cow.pages[i]) {
+            mem_unref_page(sys->cow.pages[i]);
+            sys->cow.pages[i] = 0;
+        }
+    }
+    sys->cow.write_mask = 0;
+}
+
 void vic20_init(vic20_t* sys, const vic20_desc_t* desc) {
     CHIPS_ASSERT(sys && desc);
     if (desc->debug.callback.func) { CHIPS_ASSERT(desc->debug.stopped); }
@@ -242,15 +401,29 @@ void vic20_init(vic20_t* sys, const vic20_desc_t* desc) {
     sys->via1_joy_mask = M6522_PA2|M6522_PA3|M6522_PA4|M6522_PA5;
     sys->via2_joy_mask = M6522_PB7;
     sys->debug = desc->debug;
+    sys->idle.enabled = !desc->idle_skip_disabled;
+    sys->idle.dirty = true;
+    // pool pointers are stored as 24-bit offsets in vic20_fork()
+    CHIPS_ASSERT(!desc->page_pool || ((desc->page_pool->num_pages * sizeof(mem_shared_page_t)) < (1<<24)));
+    sys->cow.pool = desc->page_pool;
     sys->audio.callback = desc->audio.callback;
     sys->audio.num_samples = _VIC20_DEFAULT(desc->audio.num_samples, VIC20_DEFAULT_AUDIO_SAMPLES);
     CHIPS_ASSERT(sys->audio.num_samples <= VIC20_MAX_AUDIO_SAMPLES);
-    CHIPS_ASSERT(desc->roms.chars.ptr && (desc->roms.chars.size == sizeof(sys->rom_char)));
-    CHIPS_ASSERT(desc->roms.basic.ptr && (desc->roms.basic.size == sizeof(sys->rom_basic)));
-    CHIPS_ASSERT(desc->roms.kernal.ptr && (desc->roms.kernal.size == sizeof(sys->rom_kernal)));
+    CHIPS_ASSERT(desc->roms.chars.ptr && (desc->roms.chars.size == 0x1000));
+    CHIPS_ASSERT(desc->roms.basic.ptr && (desc->roms.basic.size == 0x2000));
+    CHIPS_ASSERT(desc->roms.kernal.ptr && (desc->roms.kernal.size == 0x2000));
+    #if defined(CHIPS_SHARED_ROMS)
+    sys->rom_char = (const uint8_t*) desc->roms.chars.ptr;
+    sys->rom_basic = (const uint8_t*) desc->roms.basic.ptr;
+    sys->rom_kernal = (const uint8_t*) desc->roms.kernal.ptr;
+    sys->rom_id = mem_rom_id(0, sys->rom_char, 0x1000);
+    sys->rom_id = mem_rom_id(sys->rom_id, sys->rom_basic, 0x2000);
+    sys->rom_id = mem_rom_id(sys->rom_id, sys->rom_kernal, 0x2000);
+    #else
     memcpy(sys->rom_char, desc->roms.chars.ptr, sizeof(sys->rom_char));
     memcpy(sys->rom_basic, desc->roms.basic.ptr, sizeof(sys->rom_basic));
     memcpy(sys->rom_kernal, desc->roms.kernal.ptr, sizeof(sys->rom_kernal));
+    #endif
 
     // datasette: motor off, no buttons pressed
     sys->cas_port = VIC20_CASPORT_MOTOR|VIC20_CASPORT_SENSE;
@@ -366,6 +539,7 @@ void vic20_discard(vic20_t* sys) {
     if (sys->c1530.valid) {
         c1530_discard(&sys->c1530);
     }
+    _vic20_cow_release(sys);
     sys->valid = false;
 }
 
@@ -377,6 +551,7 @@ void vic20_reset(vic20_t* sys) {
     sys->via2_joy_mask = M6522_PB7;
     sys->pins |= M6502_RES;
     sys->cas_port = VIC20_CASPORT_MOTOR|VIC20_CASPORT_SENSE;
+    sys->idle.dirty = true;
     m6522_reset(&sys->via_1);
     m6522_reset(&sys->via_2);
     m6561_reset(&sys->vic);
@@ -385,6 +560,8 @@ void vic20_reset(vic20_t* sys) {
     }
 }
 
+static uint64_t _vic20_tick_io(vic20_t* sys, uint64_t pins, uint64_t vic_pins, uint64_t via1_pins, uint64_t via2_pins);
+
 static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
 
     // tick the CPU
@@ -423,6 +600,8 @@ static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
         if (pins & M6502_A5) {
             via2_pins |= M6522_CS1;
         }
+        // an I/O access disqualifies the current idle-loop candidate
+        sys->idle.dirty = true;
     }
     else {
         // regular memory access
@@ -431,9 +610,62 @@ static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
             M6502_SET_DATA(pins, mem_rd(&sys->mem_cpu, addr));
         }
         else {
-            mem_wr(&sys->mem_cpu, addr, M6502_GET_DATA(pins));
+            // idle loops may only write values which are already in memory
+            const uint8_t data = M6502_GET_DATA(pins);
+            if (mem_rd(&sys->mem_cpu, addr) != data) {
+                sys->idle.dirty = true;
+                if (sys->cow.write_mask & (1ULL << (addr >> MEM_PAGE_SHIFT))) {
+                    _vic20_cow_unshare_addr(sys, addr);
+                }
+            }
+            mem_wr(&sys->mem_cpu, addr, data);
         }
     }
+    return _vic20_tick_io(sys, pins, vic_pins, via1_pins, via2_pins);
+}
+
+// merge the VIA1 input pins (joystick and datassette sense)
+static inline uint64_t _vic20_via1_inputs(vic20_t* sys, uint64_t via1_pins) {
+    // FIXME: SERIAL PORT
+    // FIXME: RESTORE key to M6522_CA1
+    via1_pins |= sys->via1_joy_mask | (M6522_PA0|M6522_PA1|M6522_PA7);
+    if (sys->cas_port & VIC20_CASPORT_SENSE) {
+        via1_pins |= M6522_PA6;
+    }
+    return via1_pins;
+}
+
+// merge the VIA2 input pins (keyboard rows, joystick and datassette read)
+static inline uint64_t _vic20_via2_inputs(vic20_t* sys, uint64_t via2_pins) {
+    uint8_t kbd_lines = ~kbd_scan_lines(&sys->kbd);
+    M6522_SET_PA(via2_pins, kbd_lines);
+    via2_pins |= sys->via2_joy_mask;
+    if (sys->cas_port & VIC20_CASPORT_READ) {
+        via2_pins |= M6522_CA1;
+    }
+    return via2_pins;
+}
+
+// tick the VIC and collect audio samples, returns CPU pins with updated data bus
+static inline uint64_t _vic20_tick_vic(vic20_t* sys, uint64_t pins, uint64_t vic_pins) {
+    vic_pins = m6561_tick(&sys->vic, vic_pins);
+    if ((vic_pins & (M6561_CS|M6561_RW)) == (M6561_CS|M6561_RW)) {
+        pins = M6502_COPY_DATA(pins, vic_pins);
+    }
+    if (vic_pins & M6561_SAMPLE) {
+        sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->vic.sound.sample;
+        if (sys->audio.sample_pos == sys->audio.num_samples) {
+            if (sys->audio.callback.func) {
+                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
+            }
+            sys->audio.sample_pos = 0;
+        }
+    }
+    return pins;
+}
+
+// tick the VIAs, VIC and datasette, returns CPU pins with updated IRQ, NMI and data bus
+static uint64_t _vic20_tick_io(vic20_t* sys, uint64_t pins, uint64_t vic_pins, uint64_t via1_pins, uint64_t via2_pins) {
 
     /* tick VIA1
 
@@ -458,13 +690,7 @@ static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
         NOTE: the IRQ/NMI mapping is reversed from the C64
     */
     {
-        // FIXME: SERIAL PORT
-        // FIXME: RESTORE key to M6522_CA1
-        via1_pins |= sys->via1_joy_mask | (M6522_PA0|M6522_PA1|M6522_PA7);
-        if (sys->cas_port & VIC20_CASPORT_SENSE) {
-            via1_pins |= M6522_PA6;
-        }
-        via1_pins = m6522_tick(&sys->via_1, via1_pins);
+        via1_pins = m6522_tick(&sys->via_1, _vic20_via1_inputs(sys, via1_pins));
         if (via1_pins & M6522_CA2) {
             sys->cas_port |= VIC20_CASPORT_MOTOR;
         }
@@ -499,13 +725,7 @@ static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
             PB3 -> CASS WRITE (not implemented)
     */
     {
-        uint8_t kbd_lines = ~kbd_scan_lines(&sys->kbd);
-        M6522_SET_PA(via2_pins, kbd_lines);
-        via2_pins |= sys->via2_joy_mask;
-        if (sys->cas_port & VIC20_CASPORT_READ) {
-            via2_pins |= M6522_CA1;
-        }
-        via2_pins = m6522_tick(&sys->via_2, via2_pins);
+        via2_pins = m6522_tick(&sys->via_2, _vic20_via2_inputs(sys, via2_pins));
         uint8_t kbd_cols = ~M6522_GET_PB(via2_pins);
         kbd_set_active_columns(&sys->kbd, kbd_cols);
         if (via2_pins & M6522_IRQ) {
@@ -517,21 +737,7 @@ static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
     }
 
     // tick the VIC
-    {
-        vic_pins = m6561_tick(&sys->vic, vic_pins);
-        if ((vic_pins & (M6561_CS|M6561_RW)) == (M6561_CS|M6561_RW)) {
-            pins = M6502_COPY_DATA(pins, vic_pins);
-        }
-        if (vic_pins & M6561_SAMPLE) {
-            sys->audio.sample_buffer[sys->audio.sample_pos++] = sys->vic.sound.sample;
-            if (sys->audio.sample_pos == sys->audio.num_samples) {
-                if (sys->audio.callback.func) {
-                    sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
-                }
-                sys->audio.sample_pos = 0;
-            }
-        }
-    }
+    pins = _vic20_tick_vic(sys, pins, vic_pins);
 
     // optionally tick the C1530 datassette
     if (sys->c1530.valid) {
@@ -540,14 +746,143 @@ static uint64_t _vic20_tick(vic20_t* sys, uint64_t pins) {
     return pins;
 }
 
+/*
+    Idle-loop detection:
+
+    An idle loop is a short instruction sequence (for instance the KERNAL's
+    keyboard-wait loop) which starts and ends at the same opcode fetch with
+    identical CPU state, doesn't access the I/O area and doesn't modify
+    memory. Such a loop is a fixed point: each further iteration behaves
+    exactly the same until an interrupt line changes state.
+
+    Loop candidates are the targets of backward jumps, a candidate is confirmed
+    when the next visit of the loop start has the same CPU state. After that,
+    only the VIAs, VIC and datasette are ticked until an interrupt line
+    changes, and the CPU catches up with the partially executed iteration.
+*/
+#define _VIC20_IDLE_MAX_LOOP_TICKS (64)
+
+static bool _vic20_idle_cpu_equal(const m6502_t* c0, const m6502_t* c1) {
+    return (c0->IR == c1->IR) && (c0->PC == c1->PC) && (c0->AD == c1->AD) &&
+           (c0->A == c1->A) && (c0->X == c1->X) && (c0->Y == c1->Y) &&
+           (c0->S == c1->S) && (c0->P == c1->P) && (c0->PINS == c1->PINS) &&
+           (c0->irq_pip == c1->irq_pip) && (c0->nmi_pip == c1->nmi_pip) &&
+           (c0->brk_flags == c1->brk_flags);
+}
+
+static void _vic20_idle_start(vic20_t* sys, uint16_t pc, uint64_t pins) {
+    sys->idle.dirty = false;
+    sys->idle.loop_pc = pc;
+    sys->idle.ticks = 0;
+    sys->idle.pins = pins;
+    sys->idle.cpu = sys->cpu;
+}
+
+// called on each opcode fetch, returns true when an idle loop has been confirmed
+static bool _vic20_idle_detect(vic20_t* sys, uint64_t pins) {
+    const uint16_t pc = M6502_GET_ADDR(pins);
+    const uint16_t prev_pc = sys->idle.prev_pc;
+    sys->idle.prev_pc = pc;
+    if (pc == sys->idle.loop_pc) {
+        if (!sys->idle.dirty &&
+            (sys->idle.ticks <= _VIC20_IDLE_MAX_LOOP_TICKS) &&
+            (pins == sys->idle.pins) &&
+            _vic20_idle_cpu_equal(&sys->cpu, &sys->idle.cpu))
+        {
+            return true;
+        }
+        _vic20_idle_start(sys, pc, pins);
+    }
+    else if (pc < prev_pc) {
+        _vic20_idle_start(sys, pc, pins);
+    }
+    return false;
+}
+
+// fast-forward through a confirmed idle loop, returns number of skipped ticks
+static uint32_t _vic20_idle_skip(vic20_t* sys, uint64_t* inout_pins, uint32_t max_ticks) {
+    const uint64_t irq_mask = M6502_IRQ|M6502_NMI;
+    const uint32_t loop_ticks = sys->idle.ticks;
+    uint64_t pins = *inout_pins;
+    const uint64_t irq_pins = pins & irq_mask;
+
+    // tick the I/O chips on their own until an interrupt line changes
+    const uint64_t io_pins = pins & ~irq_mask & M6502_PIN_MASK;
+    uint64_t irq_out = irq_pins;
+    uint32_t ticks = 0;
+    while ((ticks < max_ticks) && (irq_out == irq_pins)) {
+        // without a running datassette, the VIA input pins stay the same
+        // until the next VIA event, so the VIAs can be advanced in bulk
+        // and only the VIC needs to be ticked
+        uint32_t num_idle = 0;
+        uint64_t via1_pins = 0, via2_pins = 0;
+        if (!sys->c1530.valid) {
+            via1_pins = _vic20_via1_inputs(sys, io_pins);
+            via2_pins = _vic20_via2_inputs(sys, io_pins);
+            const uint32_t via1_ticks = m6522_cycles_until_event(&sys->via_1, via1_pins);
+            const uint32_t via2_ticks = m6522_cycles_until_event(&sys->via_2, via2_pins);
+            num_idle = ((via1_ticks < via2_ticks) ? via1_ticks : via2_ticks) - 1;
+            if (num_idle > (max_ticks - ticks)) {
+                num_idle = max_ticks - ticks;
+            }
+        }
+        if (num_idle > 0) {
+            m6522_advance(&sys->via_1, via1_pins, num_idle);
+            m6522_advance(&sys->via_2, via2_pins, num_idle);
+            for (uint32_t i = 0; i < num_idle; i++) {
+                _vic20_tick_vic(sys, pins, io_pins);
+            }
+            ticks += num_idle;
+        }
+        else {
+            irq_out = _vic20_tick_io(sys, pins & ~irq_mask, io_pins, io_pins, io_pins) & irq_mask;
+            ticks++;
+        }
+    }
+
+    // whole loop iterations leave the CPU unchanged, run the remaining
+    // ticks of the last iteration on the CPU, this only accesses memory
+    const uint32_t partial_ticks = ticks % loop_ticks;
+    for (uint32_t i = 0; i < partial_ticks; i++) {
+        pins = m6502_tick(&sys->cpu, pins);
+        const uint16_t addr = M6502_GET_ADDR(pins);
+        if (pins & M6502_RW) {
+            M6502_SET_DATA(pins, mem_rd(&sys->mem_cpu, addr));
+        }
+        else {
+            mem_wr(&sys->mem_cpu, addr, M6502_GET_DATA(pins));
+        }
+    }
+    *inout_pins = (pins & ~irq_mask) | irq_out;
+
+    // continue detection, an interrupt line change invalidates the candidate
+    sys->idle.ticks = partial_ticks;
+    sys->idle.dirty = (irq_out != irq_pins);
+    return ticks;
+}
+
 uint32_t vic20_exec(vic20_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
     uint32_t num_ticks = clk_us_to_ticks(VIC20_FREQUENCY, micro_seconds);
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
-        // run without debug callback
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
-            pins = _vic20_tick(sys, pins);
+        if (sys->idle.enabled) {
+            // run without debug callback, fast-forward idle loops
+            uint32_t ticks = 0;
+            while (ticks < num_ticks) {
+                pins = _vic20_tick(sys, pins);
+                ticks++;
+                sys->idle.ticks++;
+                if ((pins & M6502_SYNC) && _vic20_idle_detect(sys, pins)) {
+                    ticks += _vic20_idle_skip(sys, &pins, num_ticks - ticks);
+                }
+            }
+        }
+        else {
+            // run without debug callback
+            for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
+                pins = _vic20_tick(sys, pins);
+            }
         }
     }
     else {
@@ -636,9 +971,11 @@ bool vic20_quickload(vic20_t* sys, chips_range_t data) {
     ptr += 2;
     const uint16_t end_addr = start_addr + (data.size - 2);
     uint16_t addr = start_addr;
+    _vic20_cow_unshare_all(sys);
     while (addr < end_addr) {
         mem_wr(&sys->mem_cpu, addr++, *ptr++);
     }
+    sys->idle.dirty = true;
     return true;
 }
 
@@ -657,6 +994,7 @@ bool vic20_insert_rom_cartridge(vic20_t* sys, chips_range_t data) {
     ptr += 2;
     const uint16_t end_addr = start_addr + (data.size - 2);
     uint16_t addr = start_addr;
+    _vic20_cow_unshare_all(sys);
     while (addr < end_addr) {
         mem_wr(&sys->mem_cart, addr++, *ptr++);
     }
@@ -673,6 +1011,7 @@ bool vic20_insert_rom_cartridge(vic20_t* sys, chips_range_t data) {
         mem_map_rom(&sys->mem_cpu, 0, 0x6000, 0x2000, sys->ram_exp[2]);
     }
     mem_map_rom(&sys->mem_cpu, 0, 0xA000, 0x2000, sys->ram_exp[3]);
+    sys->idle.dirty = true;
     sys->pins |= M6502_RES;
     return true;
 }
@@ -680,6 +1019,8 @@ bool vic20_insert_rom_cartridge(vic20_t* sys, chips_range_t data) {
 void vic20_remove_rom_cartridge(vic20_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     mem_unmap_layer(&sys->mem_cpu, 0);
+    _vic20_cow_update_write_mask(sys);
+    sys->idle.dirty = true;
     sys->pins |= M6502_RES;
 }
 
@@ -829,17 +1170,48 @@ chips_display_info_t vic20_display_info(vic20_t* sys) {
     return res;
 }
 
+// get the ROM images referenced by snapshots, returns number of ROM images
+static size_t _vic20_shared_roms(vic20_t* sys, mem_ext_t* roms) {
+    #if defined(CHIPS_SHARED_ROMS)
+    roms[0] = (mem_ext_t){ .ptr = sys->rom_char, .size = 0x1000 };
+    roms[1] = (mem_ext_t){ .ptr = sys->rom_basic, .size = 0x2000 };
+    roms[2] = (mem_ext_t){ .ptr = sys->rom_kernal, .size = 0x2000 };
+    return 3;
+    #else
+    (void)sys; (void)roms;
+    return 0;
+    #endif
+}
+
 uint32_t vic20_save_snapshot(vic20_t* sys, vic20_t* dst) {
     CHIPS_ASSERT(sys && dst);
+    mem_ext_t roms[3] = {{0}};
+    const size_t num_roms = _vic20_shared_roms(sys, roms);
     *dst = *sys;
+    // snapshots contain the RAM content, copy shared pages into the snapshot
+    // and point its memory mapping at the private RAM pages, sys keeps sharing
+    for (size_t i = 0; i < VIC20_NUM_RAM_PAGES; i++) {
+        if (sys->cow.pages[i]) {
+            memcpy(_vic20_ram_page(dst, i), sys->cow.pages[i]->data, MEM_PAGE_SIZE);
+            _vic20_cow_remap(dst, sys->cow.pages[i]->data, _vic20_ram_page(sys, i));
+            dst->cow.pages[i] = 0;
+        }
+    }
+    dst->cow.pool = 0;
+    dst->cow.write_mask = 0;
     chips_debug_snapshot_onsave(&dst->debug);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     m6502_snapshot_onsave(&dst->cpu);
     m6561_snapshot_onsave(&dst->vic);
     c1530_snapshot_onsave(&dst->c1530);
-    mem_snapshot_onsave(&dst->mem_cpu, sys);
-    mem_snapshot_onsave(&dst->mem_vic, sys);
-    mem_snapshot_onsave(&dst->mem_cart, sys);
+    mem_snapshot_onsave_ext(&dst->mem_cpu, sys, roms, num_roms);
+    mem_snapshot_onsave_ext(&dst->mem_vic, sys, roms, num_roms);
+    mem_snapshot_onsave_ext(&dst->mem_cart, sys, roms, num_roms);
+    #if defined(CHIPS_SHARED_ROMS)
+    dst->rom_char = 0;
+    dst->rom_basic = 0;
+    dst->rom_kernal = 0;
+    #endif
     return VIC20_SNAPSHOT_VERSION;
 }
 
@@ -848,18 +1220,111 @@ bool vic20_load_snapshot(vic20_t* sys, uint32_t version, vic20_t* src) {
     if (version != VIC20_SNAPSHOT_VERSION) {
         return false;
     }
+    #if defined(CHIPS_SHARED_ROMS)
+    // the snapshot only references the ROM images, these must be identical
+    if (src->rom_id != sys->rom_id) {
+        return false;
+    }
+    #endif
+    mem_ext_t roms[3] = {{0}};
+    const size_t num_roms = _vic20_shared_roms(sys, roms);
+    _vic20_cow_release(sys);
     static vic20_t im;
     im = *src;
+    im.cow.pool = sys->cow.pool;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     m6502_snapshot_onload(&im.cpu, &sys->cpu);
     m6561_snapshot_onload(&im.vic, &sys->vic);
     c1530_snapshot_onload(&im.c1530, &sys->c1530);
-    mem_snapshot_onload(&im.mem_cpu, sys);
-    mem_snapshot_onload(&im.mem_vic, sys);
-    mem_snapshot_onload(&im.mem_cart, sys);
+    mem_snapshot_onload_ext(&im.mem_cpu, sys, roms, num_roms);
+    mem_snapshot_onload_ext(&im.mem_vic, sys, roms, num_roms);
+    mem_snapshot_onload_ext(&im.mem_cart, sys, roms, num_roms);
+    #if defined(CHIPS_SHARED_ROMS)
+    im.rom_char = sys->rom_char;
+    im.rom_basic = sys->rom_basic;
+    im.rom_kernal = sys->rom_kernal;
+    #endif
+    im.idle.dirty = true;
     *sys = im;
     return true;
 }
 
+void vic20_fork(vic20_t* sys, vic20_t* dst) {
+    CHIPS_ASSERT(sys && sys->valid && sys->cow.pool && dst && (dst != sys));
+    mem_page_pool_t* pool = sys->cow.pool;
+    if (dst->valid) {
+        // drop the shared page references of the overwritten instance
+        vic20_discard(dst);
+    }
+
+    // move private RAM pages which are mapped into the CPU address space
+    // into the page pool, the other pages are copied below
+    for (size_t i = 0; i < VIC20_NUM_RAM_PAGES; i++) {
+        uint8_t* ram = _vic20_ram_page(sys, i);
+        if ((0 == sys->cow.pages[i]) && _vic20_ram_page_mapped(sys, ram)) {
+            mem_shared_page_t* page = mem_share_page(pool, ram);
+            if (0 == page) {
+                // pool is exhausted, the remaining pages are copied below
+                break;
+            }
+            _vic20_cow_remap(sys, ram, page->data);
+            sys->cow.pages[i] = page;
+        }
+    }
+    _vic20_cow_update_write_mask(sys);
+
+    // copy the chip state, memory mapping, color RAM and ROM images,
+    // and whatever is still private
+    memcpy(dst, sys, offsetof(vic20_t, audio.sample_buffer));
+    memcpy(dst->audio.sample_buffer, sys->audio.sample_buffer, (size_t)sys->audio.sample_pos * sizeof(float));
+    memcpy(dst->color_ram, sys->color_ram, sizeof(sys->color_ram));
+    #if defined(CHIPS_SHARED_ROMS)
+    dst->rom_char = sys->rom_char;
+    dst->rom_basic = sys->rom_basic;
+    dst->rom_kernal = sys->rom_kernal;
+    dst->rom_id = sys->rom_id;
+    #else
+    memcpy(dst->rom_char, sys->rom_char, sizeof(sys->rom_char));
+    memcpy(dst->rom_basic, sys->rom_basic, sizeof(sys->rom_basic));
+    memcpy(dst->rom_kernal, sys->rom_kernal, sizeof(sys->rom_kernal));
+    #endif
+    dst->mem_cart = sys->mem_cart;
+    for (size_t i = 0; i < VIC20_NUM_RAM_PAGES; i++) {
+        if (sys->cow.pages[i]) {
+            mem_ref_page(sys->cow.pages[i]);
+        }
+        else {
+            memcpy(_vic20_ram_page(dst, i), _vic20_ram_page(sys, i), MEM_PAGE_SIZE);
+        }
+    }
+    if (sys->c1530.valid) {
+        dst->c1530 = (c1530_t){
+            .cas_port = &dst->cas_port,
+            .valid = true,
+            .size = sys->c1530.size,
+            .pos = sys->c1530.pos,
+            .pulse_count = sys->c1530.pulse_count,
+        };
+        memcpy(dst->c1530.buf, sys->c1530.buf, sys->c1530.size);
+    }
+    else {
+        dst->c1530.valid = false;
+    }
+
+    // rebase pointers into sys to pointers into dst, pointers into the
+    // ROM images and page pool are kept as they are
+    mem_ext_t ext[4] = {{0}};
+    size_t num_ext = _vic20_shared_roms(sys, ext);
+    ext[num_ext++] = (mem_ext_t){ .ptr = (const uint8_t*)pool->pages, .size = (uint32_t)(pool->num_pages * sizeof(mem_shared_page_t)) };
+    mem_snapshot_onsave_ext(&dst->mem_cpu, sys, ext, num_ext);
+    mem_snapshot_onload_ext(&dst->mem_cpu, dst, ext, num_ext);
+    mem_snapshot_onsave_ext(&dst->mem_vic, sys, ext, num_ext);
+    mem_snapshot_onload_ext(&dst->mem_vic, dst, ext, num_ext);
+    mem_snapshot_onsave_ext(&dst->mem_cart, sys, ext, num_ext);
+    mem_snapshot_onload_ext(&dst->mem_cart, dst, ext, num_ext);
+    dst->vic.user_data = dst;
+    dst->vic.crt.fb = dst->fb;
+}
+
 #endif // CHIPS_IMPL
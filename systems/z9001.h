@@ -88,7 +88,7 @@ extern "C" {
 #endif
 
 // bump this whenever the z9001_t struct layout changes
-#define Z9001_SNAPSHOT_VERSION (0x0001)
+#define Z9001_SNAPSHOT_VERSION (0x0002)
 
 #define Z9001_MAX_AUDIO_SAMPLES (1024)      // max number of audio samples in internal sample buffer
 #define Z9001_DEFAULT_AUDIO_SAMPLES (128)   // default number of samples in internal sample buffer
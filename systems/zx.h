@@ -18,6 +18,14 @@
     ~~~
         your own assert macro (default: assert(c))
 
+    ~~~C
+    CHIPS_SHARED_ROMS
+    ~~~
+        if defined, the ROM images in zx_desc_t.roms are mapped directly
+        instead of being copied into zx_t, the ROM data must outlive the
+        emulator instance, snapshots only contain an identity hash of the
+        ROM images
+
     You need to include the following headers before including zx.h:
 
     - chips/chips_common.h
@@ -36,8 +44,47 @@
 
     TODO!
 
+    ## Contended Memory
+
+    While the ULA fetches pixel and attribute bytes for the 192 display
+    lines, a CPU access to the RAM the ULA reads from (0x4000..0x7FFF on
+    the 48K, the odd RAM banks on the 128K), or to an ULA port, is delayed
+    by up to 6 ticks. The delay only depends on the tick position in the
+    frame and follows the pattern 6,5,4,3,2,1,0,0 for the 128 ticks of
+    a display line where the ULA is fetching.
+
+    The delays for one scanline are computed in zx_init(), and the accessed
+    16 KB page is checked against a bit mask of contended pages, so an access
+    to uncontended memory costs nothing extra, and a contended access costs
+    one table lookup. The ULA holds the CPU after the access instead of before,
+    while the rest of the system keeps running for the delay ticks, this
+    keeps the total timing right but moves the access itself a few ticks
+    earlier than on the real machine.
+
+    ## Tape Loading
+
+    Insert a TAP or TZX file with zx_insert_tape(). The file data isn't
+    copied, it must stay valid until the tape is removed or another tape
+    is inserted. Snapshots only contain the tape position and player state,
+    zx_load_snapshot() only keeps the tape of the snapshot if the same tape
+    file is inserted, otherwise the tape is removed.
+
+    When the ROM LD-BYTES
+    routine (0x0556) is called, the next standard speed block (a TAP block
+    or TZX block 0x10) is copied directly into memory, the flag byte, length
+    and checksum are checked like the ROM would do, and execution continues
+    at the ROM's SA/LD-RET (0x053F) with the carry flag set on success.
+
+    When the next block is not a standard speed block (TZX turbo speed,
+    pure tone, pulse sequence and pure data blocks), the tape starts
+    playing in real time from that block, and the tape signal is fed into
+    the EAR bit of port 0xFE. Once playing, the tape keeps playing until
+    its end, and LD-BYTES runs through the ROM code.
+
     ## TODO:
-    - 'contended memory' timing and IO port timing
+    - TZX loops, jumps and calls are skipped, CSW, generalized data and
+      direct recording blocks stop the tape
+    - IO port contention is approximated with one lookup per ULA timing slot
     - reads from port 0xFF must return 'current VRAM bytes
     - video decoding only has scanline accuracy, not pixel accuracy
 
@@ -69,7 +116,7 @@ extern "C" {
 #endif
 
 // bump this whenever the zx_t struct layout changes
-#define ZX_SNAPSHOT_VERSION (0x0001)
+#define ZX_SNAPSHOT_VERSION (0x000A)
 
 #define ZX_MAX_AUDIO_SAMPLES (1024)      // max number of audio samples in internal sample buffer
 #define ZX_DEFAULT_AUDIO_SAMPLES (128)   // default number of samples in internal sample buffer
@@ -78,6 +125,7 @@ extern "C" {
 #define ZX_FRAMEBUFFER_SIZE_BYTES (ZX_FRAMEBUFFER_WIDTH * ZX_FRAMEBUFFER_HEIGHT)
 #define ZX_DISPLAY_WIDTH (320)
 #define ZX_DISPLAY_HEIGHT (256)
+#define ZX_MAX_SCANLINE_PERIOD (228)    // scanline length in CPU ticks on the 128K (224 on the 48K)
 
 // ZX Spectrum models
 typedef enum {
@@ -122,6 +170,24 @@ typedef struct {
     } roms;
 } zx_desc_t;
 
+// a decoded TAP or TZX tape block
+typedef struct {
+    uint32_t next;          // tape position of the next block
+    uint32_t data;          // tape position of the block data
+    uint32_t size;          // data size in bytes, or number of pulses in a pulse sequence
+    uint32_t pause;         // pause after the block in milliseconds
+    uint16_t pilot_len;     // pulse lengths in CPU ticks
+    uint16_t sync1_len;
+    uint16_t sync2_len;
+    uint16_t zero_len;
+    uint16_t one_len;
+    uint16_t pilot_pulses;
+    uint8_t last_bits;      // used bits in the last data byte
+    bool standard;          // a standard speed data block, can be loaded by the LD-BYTES trap
+    bool pulses;            // data is a sequence of 16-bit pulse lengths
+    bool stop;              // stop the tape after this block
+} zx_tape_block_t;
+
 // ZX emulator state
 typedef struct {
     z80_t cpu;
@@ -133,6 +199,7 @@ typedef struct {
     uint8_t kbd_joymask;        // joystick mask from keyboard joystick emulation
     uint8_t joy_joymask;        // joystick mask from zx_joystick()
     uint32_t tick_count;
+    uint32_t audio_num_deferred;    // number of deferred beeper and AY ticks, see _zx_sync_audio()
     uint8_t last_mem_config;    // last out to 0x7FFD
     uint8_t last_fe_out;        // last out value to 0xFE port
     uint8_t blink_counter;      // incremented on each vblank
@@ -144,6 +211,18 @@ typedef struct {
     int scanline_y;
     int int_counter;
     uint32_t display_ram_bank;
+    // ULA memory contention, see _zx_contention()
+    struct {
+        uint8_t pages;      // bit mask of contended 16 KB pages
+        int first_line;     // scanline and tick of the first contended tick in a frame
+        int first_tick;
+        uint8_t delay[ZX_MAX_SCANLINE_PERIOD];  // delay by tick position in contended display line
+    } contention;
+    // display RAM change tracking, see _zx_video_ram_wr()
+    struct {
+        uint8_t pages;          // bit mask of 16 KB pages which map the display RAM bank
+        uint32_t dirty[192/32]; // display lines which need to be decoded
+    } video;
     kbd_t kbd;
     mem_t mem;
     uint64_t pins;
@@ -157,9 +236,34 @@ typedef struct {
         float sample_buffer[ZX_MAX_AUDIO_SAMPLES];
     } audio;
     uint8_t ram[8][0x4000];
+    #if defined(CHIPS_SHARED_ROMS)
+    const uint8_t* rom[2];
+    uint32_t rom_id;        // identity hash of ROM images, checked in zx_load_snapshot()
+    #else
     uint8_t rom[2][0x4000];
+    #endif
     uint8_t junk[0x4000];
+    // scanline decoder lookup tables, see _zx_init_video_tables()
+    alignas(64) uint64_t pixel_masks[256];  // one mask byte per pixel for each pixel byte
+    uint8_t attr_colors[2][256][2];         // ink and paper color by blink phase and attribute byte
     alignas(64) uint8_t fb[ZX_FRAMEBUFFER_SIZE_BYTES];
+    // tape loading, see _zx_tape_trap() and _zx_tape_update()
+    struct {
+        const uint8_t* data;    // caller-owned TAP or TZX file
+        uint32_t size;          // size > 0 if a tape is inserted
+        uint32_t id;            // identity hash of the tape file, checked in zx_load_snapshot()
+        uint32_t pos;           // tape position of the next block
+        bool playing;           // true while the tape signal is played in real time
+        bool level;             // current EAR signal level
+        bool toggle;            // true if the signal level toggles at the end of the current pulse
+        uint8_t phase;          // current phase in block, see _zx_tape_next_pulse()
+        uint32_t count;         // remaining pulses in current phase
+        uint32_t data_pos;      // tape position of current data byte
+        uint32_t bit;           // current bit (times 2 for half-bits) in data byte
+        uint32_t pulse_ticks;   // ticks until the end of the current pulse
+        uint32_t last_tick;     // tick_count at last update
+        zx_tape_block_t block;  // the currently playing block
+    } tape;
 } zx_t;
 
 // initialize a new ZX Spectrum instance
@@ -184,6 +288,10 @@ zx_joystick_type_t zx_joystick_type(zx_t* sys);
 void zx_joystick(zx_t* sys, uint8_t mask);
 // load a ZX Z80 file into the emulator
 bool zx_quickload(zx_t* sys, chips_range_t data);
+// insert a TAP or TZX tape file, data must remain valid until the tape is removed
+bool zx_insert_tape(zx_t* sys, chips_range_t data);
+// remove tape
+void zx_remove_tape(zx_t* sys);
 // save a snapshot, patches any pointers to zero, returns a snapshot version
 uint32_t zx_save_snapshot(zx_t* sys, zx_t* dst);
 // load a snapshot, returns false if snapshot version doesn't match
@@ -203,6 +311,9 @@ bool zx_load_snapshot(zx_t* sys, uint32_t version, zx_t* src);
 
 static void _zx_init_memory_map(zx_t* sys);
 static void _zx_init_keyboard_matrix(zx_t* sys);
+static void _zx_init_contention(zx_t* sys);
+static void _zx_init_video_tables(zx_t* sys);
+static void _zx_tape_rewind(zx_t* sys);
 
 #define _ZX_DEFAULT(val,def) (((val) != 0) ? (val) : (def))
 
@@ -228,8 +339,14 @@ void zx_init(zx_t* sys, const zx_desc_t* desc) {
     if (ZX_TYPE_128 == sys->type) {
         CHIPS_ASSERT(desc->roms.zx128_0.ptr && (desc->roms.zx128_0.size == 0x4000));
         CHIPS_ASSERT(desc->roms.zx128_1.ptr && (desc->roms.zx128_1.size == 0x4000));
+        #if defined(CHIPS_SHARED_ROMS)
+        sys->rom[0] = (const uint8_t*) desc->roms.zx128_0.ptr;
+        sys->rom[1] = (const uint8_t*) desc->roms.zx128_1.ptr;
+        sys->rom_id = mem_rom_id(mem_rom_id(0, sys->rom[0], 0x4000), sys->rom[1], 0x4000);
+        #else
         memcpy(sys->rom[0], desc->roms.zx128_0.ptr, 0x4000);
         memcpy(sys->rom[1], desc->roms.zx128_1.ptr, 0x4000);
+        #endif
         sys->display_ram_bank = 5;
         sys->frame_scan_lines = 311;
         sys->top_border_scanlines = 63;
@@ -237,19 +354,27 @@ void zx_init(zx_t* sys, const zx_desc_t* desc) {
     }
     else {
         CHIPS_ASSERT(desc->roms.zx48k.ptr && (desc->roms.zx48k.size == 0x4000));
+        #if defined(CHIPS_SHARED_ROMS)
+        sys->rom[0] = (const uint8_t*) desc->roms.zx48k.ptr;
+        sys->rom_id = mem_rom_id(0, sys->rom[0], 0x4000);
+        #else
         memcpy(sys->rom[0], desc->roms.zx48k.ptr, 0x4000);
+        #endif
         sys->display_ram_bank = 0;
         sys->frame_scan_lines = 312;
         sys->top_border_scanlines = 64;
         sys->scanline_period = 224;
     }
     sys->scanline_counter = sys->scanline_period;
+    _zx_init_contention(sys);
+    _zx_init_video_tables(sys);
 
     sys->pins = z80_init(&sys->cpu);
 
     const int audio_hz = _ZX_DEFAULT(desc->audio.sample_rate, 44100);
+    // the beeper is clocked together with the AY, see _zx_sync_audio()
     beeper_init(&sys->beeper, &(beeper_desc_t){
-        .tick_hz = (int)sys->freq_hz,
+        .tick_hz = (int)sys->freq_hz / 2,
         .sound_hz = audio_hz,
         .base_volume = _ZX_DEFAULT(desc->audio.beeper_volume, 0.25f),
     });
@@ -277,6 +402,7 @@ void zx_reset(zx_t* sys) {
     if (sys->type == ZX_TYPE_128) {
         ay38910_reset(&sys->ay);
     }
+    sys->audio_num_deferred = 0;
     sys->memory_paging_disabled = false;
     sys->kbd_joymask = 0;
     sys->joy_joymask = 0;
@@ -284,6 +410,7 @@ void zx_reset(zx_t* sys) {
     sys->scanline_counter = sys->scanline_period;
     sys->scanline_y = 0;
     sys->blink_counter = 0;
+    _zx_tape_rewind(sys);
     if (sys->type == ZX_TYPE_48K) {
         sys->display_ram_bank = 0;
     }
@@ -293,6 +420,24 @@ void zx_reset(zx_t* sys) {
     _zx_init_memory_map(sys);
 }
 
+static void _zx_video_dirty_all(zx_t* sys) {
+    memset(sys->video.dirty, 0xFF, sizeof(sys->video.dirty));
+}
+
+// mark the display lines touched by a write to display RAM offset 'offset'
+static void _zx_video_ram_wr(zx_t* sys, uint16_t offset) {
+    if (offset < 0x1800) {
+        // pixel byte: | 0| 1| 0|Y7|Y6|Y2|Y1|Y0|Y5|Y4|Y3|X4|X3|X2|X1|X0|
+        const uint32_t y = ((offset>>5) & 0xC0) | ((offset>>8) & 0x07) | ((offset>>2) & 0x38);
+        sys->video.dirty[y>>5] |= 1U<<(y & 31);
+    }
+    else if (offset < 0x1B00) {
+        // attribute byte: 8 display lines, which are in the same dirty word
+        const uint32_t y = ((offset - 0x1800)>>5)<<3;
+        sys->video.dirty[y>>5] |= 0xFFU<<(y & 31);
+    }
+}
+
 static bool _zx_decode_scanline(zx_t* sys) {
     /* this is called by the timer callback for every PAL line, controlling
         the vidmem decoding and vblank interrupt
@@ -317,67 +462,50 @@ static bool _zx_decode_scanline(zx_t* sys) {
     if ((sys->scanline_y >= top_decode_line) && (sys->scanline_y < btm_decode_line)) {
         const uint16_t y = sys->scanline_y - top_decode_line;
         uint8_t* dst = &sys->fb[y * ZX_FRAMEBUFFER_WIDTH];
-        const uint8_t* vidmem_bank = sys->ram[sys->display_ram_bank];
-        const bool blink = 0 != (sys->blink_counter & 0x10);
         if ((y < 32) || (y >= 224)) {
             // upper/lower border
-            for (int x = 0; x < ZX_DISPLAY_WIDTH; x++) {
-                *dst++ = sys->border_color;
-            }
+            memset(dst, sys->border_color, ZX_DISPLAY_WIDTH);
         }
         else {
-            /* compute video memory Y offset (inside 256x192 area)
-                this is how the 16-bit video memory address is computed
-                from X and Y coordinates:
-                | 0| 1| 0|Y7|Y6|Y2|Y1|Y0|Y5|Y4|Y3|X4|X3|X2|X1|X0|
-            */
-            const uint16_t yy = y-32;
-            const uint16_t y_offset = ((yy & 0xC0)<<5) | ((yy & 0x07)<<8) | ((yy & 0x38)<<2);
-
-            // left border
-            for (int x = 0; x < (4*8); x++) {
-                *dst++ = sys->border_color;
-            }
-
-            // valid 256x192 vidmem area
-            for (uint16_t x = 0; x < 32; x++) {
-                const uint16_t pix_offset = y_offset | x;
-                const uint16_t clr_offset = 0x1800 + (((yy & ~0x7)<<2) | x);
-
-                // pixel mask and color attribute bytes
-                const uint8_t pix = vidmem_bank[pix_offset];
-                const uint8_t clr = vidmem_bank[clr_offset];
-
-                // foreground and background color
-                uint8_t fg, bg;
-                if ((clr & (1<<7)) && blink) {
-                    fg = (clr>>3) & 7;
-                    bg = clr & 7;
-                }
-                else {
-                    fg = clr & 7;
-                    bg = (clr>>3) & 7;
-                }
-                // color bit 6: standard vs bright
-                fg |= (clr & (1<<6)) >> 3;
-                bg |= (clr & (1<<6)) >> 3;
+            // left and right border, these may change on each line
+            memset(dst, sys->border_color, 32);
+            memset(dst + 32 + 256, sys->border_color, 32);
 
-                for (int px = 7; px >=0; px--) {
-                    *dst++ = pix & (1<<px) ? fg : bg;
+            // the 256x192 vidmem area is only decoded if the display RAM has changed
+            const uint16_t yy = y-32;
+            const uint32_t dirty_mask = 1U<<(yy & 31);
+            if (sys->video.dirty[yy>>5] & dirty_mask) {
+                sys->video.dirty[yy>>5] &= ~dirty_mask;
+                /* compute video memory Y offset (inside 256x192 area)
+                    this is how the 16-bit video memory address is computed
+                    from X and Y coordinates:
+                    | 0| 1| 0|Y7|Y6|Y2|Y1|Y0|Y5|Y4|Y3|X4|X3|X2|X1|X0|
+                */
+                const uint16_t y_offset = ((yy & 0xC0)<<5) | ((yy & 0x07)<<8) | ((yy & 0x38)<<2);
+                const uint8_t* pix_ptr = &sys->ram[sys->display_ram_bank][y_offset];
+                const uint8_t* clr_ptr = &sys->ram[sys->display_ram_bank][0x1800 + ((yy & ~0x7)<<2)];
+                const uint8_t (*attr_colors)[2] = sys->attr_colors[(sys->blink_counter & 0x10) ? 1 : 0];
+                dst += 32;
+                for (int x = 0; x < 32; x++, dst += 8) {
+                    // one mask byte per pixel, selects between the ink and paper color
+                    const uint64_t mask = sys->pixel_masks[pix_ptr[x]];
+                    const uint8_t* colors = attr_colors[clr_ptr[x]];
+                    const uint64_t ink = colors[0] * 0x0101010101010101ULL;
+                    const uint64_t paper = colors[1] * 0x0101010101010101ULL;
+                    const uint64_t pixels = (ink & mask) | (paper & ~mask);
+                    memcpy(dst, &pixels, 8);
                 }
             }
-
-            // right border
-            for (int x = 0; x < (4*8); x++) {
-                *dst++ = sys->border_color;
-            }
         }
     }
 
     if (sys->scanline_y++ >= sys->frame_scan_lines) {
         // start new frame, request vblank interrupt
         sys->scanline_y = 0;
-        sys->blink_counter++;
+        // the flash attribute swaps ink and paper every 16 frames
+        if (0 == (++sys->blink_counter & 0x0F)) {
+            _zx_video_dirty_all(sys);
+        }
         return true;
     }
     else {
@@ -390,9 +518,22 @@ static void _zx_update_memory_map_zx128(zx_t* sys, uint8_t data) {
     if (!sys->memory_paging_disabled) {
         sys->last_mem_config = data;
         // bit 3 defines the video scanout memory bank (5 or 7)
-        sys->display_ram_bank = (data & (1<<3)) ? 7 : 5;
+        const uint32_t display_ram_bank = (data & (1<<3)) ? 7 : 5;
+        if (display_ram_bank != sys->display_ram_bank) {
+            sys->display_ram_bank = display_ram_bank;
+            _zx_video_dirty_all(sys);
+        }
+        // bank 5 is always mapped at 0x4000
+        sys->video.pages = ((5 == display_ram_bank) ? (1<<1) : 0) | (((data & 7) == display_ram_bank) ? (1<<3) : 0);
         // only last memory bank is mappable
         mem_map_ram(&sys->mem, 0, 0xC000, 0x4000, sys->ram[data & 0x7]);
+        // the odd banks are contended
+        if (data & 1) {
+            sys->contention.pages |= (1<<3);
+        }
+        else {
+            sys->contention.pages &= ~(1<<3);
+        }
 
         // ROM0 or ROM1
         if (data & (1<<4)) {
@@ -413,9 +554,440 @@ static void _zx_update_memory_map_zx128(zx_t* sys, uint8_t data) {
     }
 }
 
-static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
-    pins = z80_tick(&sys->cpu, pins);
+/*  The beeper runs in event mode (output changes are recorded with their
+    tick offset), and the AY output only depends on its register state,
+    so the audio ticks are only counted, and the samples are generated in
+    one go before the next AY access, when the beeper change buffer is
+    full, and at the end of zx_exec().
+
+    The beeper and AY are both clocked at half CPU frequency and are
+    initialized and reset together, so they produce their samples on
+    the same ticks.
+*/
+static void _zx_sync_audio(zx_t* sys) {
+    uint32_t num_ticks = sys->audio_num_deferred;
+    while (num_ticks > 0) {
+        float ay_samples[64];
+        int max_samples = sys->audio.num_samples - sys->audio.sample_pos;
+        if (max_samples > 64) {
+            max_samples = 64;
+        }
+        float* dst = &sys->audio.sample_buffer[sys->audio.sample_pos];
+        int num_samples = 0;
+        const uint32_t ticks = beeper_run(&sys->beeper, num_ticks, dst, max_samples, &num_samples);
+        if (sys->type == ZX_TYPE_128) {
+            int num_ay_samples = 0;
+            ay38910_render(&sys->ay, ticks, ay_samples, max_samples, &num_ay_samples);
+            // both resamplers run at the same rate and normally produce the same
+            // number of samples, but only mix what the AY actually rendered
+            if (num_ay_samples > num_samples) {
+                num_ay_samples = num_samples;
+            }
+            for (int i = 0; i < num_ay_samples; i++) {
+                dst[i] += ay_samples[i];
+            }
+        }
+        num_ticks -= ticks;
+        sys->audio.sample_pos += num_samples;
+        if (sys->audio.sample_pos == sys->audio.num_samples) {
+            if (sys->audio.callback.func) {
+                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
+            }
+            sys->audio.sample_pos = 0;
+        }
+    }
+    sys->audio_num_deferred = 0;
+}
+
+/*  Tape loading
+
+    The tape is a TAP file (a sequence of 16-bit block lengths followed by
+    the block data), or a TZX file (a 10 byte header followed by blocks
+    which start with a block id byte). _zx_tape_block() decodes the block
+    at a tape position into a zx_tape_block_t, blocks which don't produce
+    a signal (text, archive info, groups...) are decoded as empty blocks.
+
+    Standard speed timings in CPU ticks, from the ROM loader:
+*/
+#define _ZX_TAPE_PILOT_LEN (2168)
+#define _ZX_TAPE_SYNC1_LEN (667)
+#define _ZX_TAPE_SYNC2_LEN (735)
+#define _ZX_TAPE_ZERO_LEN (855)
+#define _ZX_TAPE_ONE_LEN (1710)
+#define _ZX_TAPE_HEADER_PILOT_PULSES (8063)
+#define _ZX_TAPE_DATA_PILOT_PULSES (3223)
+#define _ZX_TAPE_STANDARD_PAUSE (1000)
+#define _ZX_TZX_HEADER_SIZE (10)
+
+// the ROM LD-BYTES and SA/LD-RET routines
+#define _ZX_ROM_LD_BYTES (0x0556)
+#define _ZX_ROM_SA_LD_RET (0x053F)
+
+static uint32_t _zx_tape_rd16(const zx_t* sys, uint32_t pos) {
+    return sys->tape.data[pos] | (sys->tape.data[pos+1]<<8);
+}
+
+static uint32_t _zx_tape_rd24(const zx_t* sys, uint32_t pos) {
+    return _zx_tape_rd16(sys, pos) | (sys->tape.data[pos+2]<<16);
+}
+
+static uint32_t _zx_tape_rd32(const zx_t* sys, uint32_t pos) {
+    return _zx_tape_rd16(sys, pos) | (_zx_tape_rd16(sys, pos+2)<<16);
+}
+
+static bool _zx_tape_is_tzx(const uint8_t* ptr, size_t size) {
+    return (size >= _ZX_TZX_HEADER_SIZE) && (0 == memcmp(ptr, "ZXTape!\x1A", 8));
+}
+
+// rewind the tape to the first block and stop playing
+static void _zx_tape_rewind(zx_t* sys) {
+    sys->tape.pos = _zx_tape_is_tzx(sys->tape.data, sys->tape.size) ? _ZX_TZX_HEADER_SIZE : 0;
+    sys->tape.playing = false;
+}
+
+// decode the tape block at 'pos', returns false at the end of tape or on unsupported blocks
+static bool _zx_tape_block(const zx_t* sys, uint32_t pos, zx_tape_block_t* blk) {
+    const uint32_t size = sys->tape.size;
+    memset(blk, 0, sizeof(zx_tape_block_t));
+    if (!_zx_tape_is_tzx(sys->tape.data, size)) {
+        // a TAP block, 16-bit length followed by flag byte, data and checksum
+        if ((pos + 2) > size) {
+            return false;
+        }
+        blk->data = pos + 2;
+        blk->size = _zx_tape_rd16(sys, pos);
+        blk->standard = true;
+        blk->pause = _ZX_TAPE_STANDARD_PAUSE;
+    }
+    else {
+        // a TZX block, the block id byte is followed by the block header
+        // (all block header sizes are checked against the size below)
+        if ((pos + 1) > size) {
+            return false;
+        }
+        const uint8_t id = sys->tape.data[pos++];
+        uint32_t hdr_size = 0;
+        switch (id) {
+            case 0x10: hdr_size = 4; break;     // standard speed data
+            case 0x11: hdr_size = 18; break;    // turbo speed data
+            case 0x12: hdr_size = 4; break;     // pure tone
+            case 0x13: hdr_size = 1; break;     // pulse sequence
+            case 0x14: hdr_size = 10; break;    // pure data
+            case 0x20: hdr_size = 2; break;     // pause or stop the tape
+            case 0x21: hdr_size = 1; break;     // group start
+            case 0x22: hdr_size = 0; break;     // group end
+            case 0x23: hdr_size = 2; break;     // jump to block
+            case 0x24: hdr_size = 2; break;     // loop start
+            case 0x25: hdr_size = 0; break;     // loop end
+            case 0x26: hdr_size = 2; break;     // call sequence
+            case 0x27: hdr_size = 0; break;     // return from sequence
+            case 0x28: hdr_size = 2; break;     // select block
+            case 0x2A: hdr_size = 4; break;     // stop the tape if in 48K mode
+            case 0x2B: hdr_size = 5; break;     // set signal level
+            case 0x30: hdr_size = 1; break;     // text description
+            case 0x31: hdr_size = 2; break;     // message
+            case 0x32: hdr_size = 2; break;     // archive info
+            case 0x33: hdr_size = 1; break;     // hardware type
+            case 0x35: hdr_size = 20; break;    // custom info
+            case 0x5A: hdr_size = 9; break;     // glue block
+            default: return false;              // CSW, generalized data, direct recording...
+        }
+        if ((pos + hdr_size) > size) {
+            return false;
+        }
+        blk->data = pos + hdr_size;
+        switch (id) {
+            case 0x10:
+                blk->pause = _zx_tape_rd16(sys, pos);
+                blk->size = _zx_tape_rd16(sys, pos + 2);
+                blk->standard = true;
+                break;
+            case 0x11:
+                blk->pilot_len = _zx_tape_rd16(sys, pos);
+                blk->sync1_len = _zx_tape_rd16(sys, pos + 2);
+                blk->sync2_len = _zx_tape_rd16(sys, pos + 4);
+                blk->zero_len = _zx_tape_rd16(sys, pos + 6);
+                blk->one_len = _zx_tape_rd16(sys, pos + 8);
+                blk->pilot_pulses = _zx_tape_rd16(sys, pos + 10);
+                blk->last_bits = sys->tape.data[pos + 12];
+                blk->pause = _zx_tape_rd16(sys, pos + 13);
+                blk->size = _zx_tape_rd24(sys, pos + 15);
+                break;
+            case 0x12:
+                blk->pilot_len = _zx_tape_rd16(sys, pos);
+                blk->pilot_pulses = _zx_tape_rd16(sys, pos + 2);
+                break;
+            case 0x13:
+                blk->pulses = true;
+                blk->size = sys->tape.data[pos] * 2;
+                break;
+            case 0x14:
+                blk->zero_len = _zx_tape_rd16(sys, pos);
+                blk->one_len = _zx_tape_rd16(sys, pos + 2);
+                blk->last_bits = sys->tape.data[pos + 4];
+                blk->pause = _zx_tape_rd16(sys, pos + 5);
+                blk->size = _zx_tape_rd24(sys, pos + 7);
+                break;
+            case 0x20:
+                blk->pause = _zx_tape_rd16(sys, pos);
+                blk->stop = (0 == blk->pause);
+                break;
+            case 0x21: case 0x30: blk->data += sys->tape.data[pos]; break;
+            case 0x26: blk->data += _zx_tape_rd16(sys, pos) * 2; break;
+            case 0x28: case 0x32: blk->data += _zx_tape_rd16(sys, pos); break;
+            case 0x2A: case 0x2B: blk->data = pos + 4 + _zx_tape_rd32(sys, pos); break;
+            case 0x31: blk->data += sys->tape.data[pos + 1]; break;
+            case 0x33: blk->data += sys->tape.data[pos] * 3; break;
+            case 0x35: blk->data += _zx_tape_rd32(sys, pos + 16); break;
+            default: break;
+        }
+        if (!blk->pulses && (blk->size == 0)) {
+            // no data, only header or skipped content
+            blk->next = blk->data;
+            blk->data = 0;
+            return blk->next <= size;
+        }
+    }
+    blk->next = blk->data + blk->size;
+    if (blk->standard) {
+        blk->pilot_len = _ZX_TAPE_PILOT_LEN;
+        blk->sync1_len = _ZX_TAPE_SYNC1_LEN;
+        blk->sync2_len = _ZX_TAPE_SYNC2_LEN;
+        blk->zero_len = _ZX_TAPE_ZERO_LEN;
+        blk->one_len = _ZX_TAPE_ONE_LEN;
+        blk->last_bits = 8;
+        if (blk->size > 0) {
+            // the flag byte selects the header or data pilot tone length
+            const bool header = sys->tape.data[blk->data] < 0x80;
+            blk->pilot_pulses = header ? _ZX_TAPE_HEADER_PILOT_PULSES : _ZX_TAPE_DATA_PILOT_PULSES;
+        }
+    }
+    return blk->next <= size;
+}
+
+// check if a block produces a tape signal
+static bool _zx_tape_block_has_signal(const zx_tape_block_t* blk) {
+    return (blk->pilot_pulses > 0) || (blk->size > 0) || (blk->pause > 0) || blk->stop;
+}
+
+// skip blocks without a tape signal, returns false at end of tape
+static bool _zx_tape_next_block(zx_t* sys, zx_tape_block_t* blk) {
+    while (_zx_tape_block(sys, sys->tape.pos, blk)) {
+        if (_zx_tape_block_has_signal(blk)) {
+            return true;
+        }
+        sys->tape.pos = blk->next;
+    }
+    return false;
+}
+
+/*  The real time tape player, a block is played as pilot tone, 2 sync
+    pulses, the pulse sequence (only in pulse sequence blocks), the data
+    bits (2 pulses per bit, most significant bit first) and the pause
+    after the block, each pulse ends with a signal edge, except the pause.
+*/
+enum {
+    _ZX_TAPE_PHASE_BLOCK,
+    _ZX_TAPE_PHASE_PILOT,
+    _ZX_TAPE_PHASE_SYNC1,
+    _ZX_TAPE_PHASE_SYNC2,
+    _ZX_TAPE_PHASE_PULSES,
+    _ZX_TAPE_PHASE_DATA,
+    _ZX_TAPE_PHASE_PAUSE,
+};
+
+// start the next pulse, returns false and stops the tape at the end of the tape
+static bool _zx_tape_next_pulse(zx_t* sys) {
+    const zx_tape_block_t* blk = &sys->tape.block;
+    while (true) {
+        switch (sys->tape.phase) {
+            case _ZX_TAPE_PHASE_BLOCK:
+                if (!_zx_tape_next_block(sys, &sys->tape.block)) {
+                    sys->tape.playing = false;
+                    return false;
+                }
+                sys->tape.pos = blk->next;
+                sys->tape.count = blk->pilot_pulses;
+                sys->tape.phase = _ZX_TAPE_PHASE_PILOT;
+                break;
+            case _ZX_TAPE_PHASE_PILOT:
+                if (sys->tape.count > 0) {
+                    sys->tape.count--;
+                    sys->tape.pulse_ticks = blk->pilot_len;
+                    sys->tape.toggle = true;
+                    return true;
+                }
+                sys->tape.phase = _ZX_TAPE_PHASE_SYNC1;
+                break;
+            case _ZX_TAPE_PHASE_SYNC1:
+                sys->tape.phase = _ZX_TAPE_PHASE_SYNC2;
+                if (blk->sync1_len > 0) {
+                    sys->tape.pulse_ticks = blk->sync1_len;
+                    sys->tape.toggle = true;
+                    return true;
+                }
+                break;
+            case _ZX_TAPE_PHASE_SYNC2:
+                sys->tape.phase = blk->pulses ? _ZX_TAPE_PHASE_PULSES : _ZX_TAPE_PHASE_DATA;
+                sys->tape.data_pos = blk->data;
+                sys->tape.bit = 0;
+                if (blk->sync2_len > 0) {
+                    sys->tape.pulse_ticks = blk->sync2_len;
+                    sys->tape.toggle = true;
+                    return true;
+                }
+                break;
+            case _ZX_TAPE_PHASE_PULSES:
+                if (sys->tape.data_pos < (blk->data + blk->size)) {
+                    sys->tape.pulse_ticks = _zx_tape_rd16(sys, sys->tape.data_pos);
+                    sys->tape.data_pos += 2;
+                    sys->tape.toggle = true;
+                    return true;
+                }
+                sys->tape.phase = _ZX_TAPE_PHASE_PAUSE;
+                break;
+            case _ZX_TAPE_PHASE_DATA:
+                if (sys->tape.data_pos < (blk->data + blk->size)) {
+                    const bool last = (sys->tape.data_pos + 1) == (blk->data + blk->size);
+                    const uint32_t num_bits = (last && (blk->last_bits > 0) && (blk->last_bits < 8)) ? blk->last_bits : 8;
+                    if ((sys->tape.bit>>1) < num_bits) {
+                        const uint8_t mask = 0x80 >> (sys->tape.bit>>1);
+                        const bool one = 0 != (sys->tape.data[sys->tape.data_pos] & mask);
+                        sys->tape.pulse_ticks = one ? blk->one_len : blk->zero_len;
+                        sys->tape.toggle = true;
+                        sys->tape.bit++;
+                        return true;
+                    }
+                    sys->tape.data_pos++;
+                    sys->tape.bit = 0;
+                }
+                else {
+                    sys->tape.phase = _ZX_TAPE_PHASE_PAUSE;
+                }
+                break;
+            case _ZX_TAPE_PHASE_PAUSE:
+                sys->tape.phase = _ZX_TAPE_PHASE_BLOCK;
+                if (blk->stop) {
+                    sys->tape.playing = false;
+                    return false;
+                }
+                if (blk->pause > 0) {
+                    // the signal is low during the pause
+                    sys->tape.level = false;
+                    sys->tape.pulse_ticks = (uint32_t)((sys->freq_hz * blk->pause) / 1000);
+                    sys->tape.toggle = false;
+                    return true;
+                }
+                break;
+        }
+    }
+}
 
+// start playing the tape in real time at the current tape position
+static void _zx_tape_play(zx_t* sys) {
+    sys->tape.playing = true;
+    sys->tape.level = false;
+    sys->tape.phase = _ZX_TAPE_PHASE_BLOCK;
+    sys->tape.last_tick = sys->tick_count;
+    _zx_tape_next_pulse(sys);
+}
+
+// advance the tape player to the current tick, called when the EAR bit is read
+static void _zx_tape_update(zx_t* sys) {
+    uint32_t ticks = sys->tick_count - sys->tape.last_tick;
+    sys->tape.last_tick = sys->tick_count;
+    while (sys->tape.playing && (ticks >= sys->tape.pulse_ticks)) {
+        ticks -= sys->tape.pulse_ticks;
+        if (sys->tape.toggle) {
+            sys->tape.level = !sys->tape.level;
+        }
+        _zx_tape_next_pulse(sys);
+    }
+    if (sys->tape.playing) {
+        sys->tape.pulse_ticks -= ticks;
+    }
+}
+
+/*  Trapped LD-BYTES routine, load the next standard speed block:
+
+    - Entry: A  = expected flag byte
+             F  = carry set to LOAD, reset to VERIFY
+             DE = number of bytes to load
+             IX = destination address
+    - Exit:  carry set on success, reset if the flag byte doesn't match,
+             the block is too short, the checksum is wrong, or on a
+             VERIFY mismatch
+
+    Continues with the ROM's SA/LD-RET, which restores the border color,
+    enables interrupts, checks for BREAK and returns to the caller.
+*/
+static uint64_t _zx_tape_trap(zx_t* sys, uint64_t pins) {
+    // check that the ROM routines are where we expect them (INC D and PUSH AF)
+    if ((mem_rd(&sys->mem, _ZX_ROM_LD_BYTES) != 0x14) || (mem_rd(&sys->mem, _ZX_ROM_SA_LD_RET) != 0xF5)) {
+        return pins;
+    }
+    zx_tape_block_t blk;
+    if (!_zx_tape_next_block(sys, &blk)) {
+        // at end of tape, the ROM waits for a signal until BREAK is pressed
+        return pins;
+    }
+    if (!blk.standard) {
+        // continue with the ROM code and the real time tape signal
+        _zx_tape_play(sys);
+        return pins;
+    }
+    sys->tape.pos = blk.next;
+
+    z80_t* cpu = &sys->cpu;
+    const bool load = 0 != (cpu->f & Z80_CF);
+    const uint8_t* data = &sys->tape.data[blk.data];
+    uint32_t i = 0;
+    bool success = false;
+    if ((blk.size > 0) && (data[i++] == cpu->a)) {
+        uint8_t parity = cpu->a;
+        bool verify_ok = true;
+        while ((cpu->de > 0) && (i < blk.size)) {
+            const uint8_t val = data[i++];
+            parity ^= val;
+            if (load) {
+                mem_wr(&sys->mem, cpu->ix, val);
+                if (sys->video.pages & (1<<(cpu->ix>>14))) {
+                    _zx_video_ram_wr(sys, cpu->ix & 0x3FFF);
+                }
+            }
+            else if (mem_rd(&sys->mem, cpu->ix) != val) {
+                verify_ok = false;
+                break;
+            }
+            cpu->ix++;
+            cpu->de--;
+        }
+        // the checksum byte follows the data bytes
+        if (verify_ok && (cpu->de == 0) && (i < blk.size)) {
+            parity ^= data[i];
+            success = (0 == parity);
+        }
+        // the ROM returns with A = H = parity after 'CP 1'
+        cpu->a = cpu->h = parity;
+    }
+    if (success) {
+        cpu->f = (cpu->f & ~Z80_ZF) | Z80_CF;
+    }
+    else {
+        cpu->f &= ~Z80_CF;
+    }
+
+    // a custom loader may read the following turbo speed blocks directly
+    zx_tape_block_t next_blk;
+    if (_zx_tape_next_block(sys, &next_blk) && !next_blk.standard) {
+        _zx_tape_play(sys);
+    }
+    // skip the opcode fetch and continue in SA/LD-RET
+    return z80_prefetch(cpu, _ZX_ROM_SA_LD_RET) | (pins & Z80_INT);
+}
+
+// the per-tick work of the ULA and audio chips, this also runs while the CPU is held
+static inline uint64_t _zx_tick_ula(zx_t* sys, uint64_t pins) {
     // video decoding and vblank interrupt
     if (--sys->scanline_counter <= 0) {
         sys->scanline_counter += sys->scanline_period;
@@ -434,11 +1006,97 @@ static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
             pins &= ~Z80_INT;
         }
     }
+    return pins;
+}
+
+static inline void _zx_tick_audio(zx_t* sys) {
+    // tick the beeper and AY at half frequency (deferred, see _zx_sync_audio())
+    if (++sys->tick_count & 1) {
+        sys->audio_num_deferred++;
+    }
+}
+
+/*  Return the ULA contention delay for a bus access 'offset' ticks after
+    the current tick. The position in the frame is taken from the scanline
+    counters, the current tick is at tick (scanline_period - scanline_counter)
+    of scanline scanline_y, counted from the vblank interrupt.
+*/
+static inline uint32_t _zx_contention(const zx_t* sys, int offset) {
+    const int period = sys->scanline_period;
+    int x = (period - sys->scanline_counter) + offset - sys->contention.first_tick;
+    int y = sys->scanline_y - sys->contention.first_line;
+    if (x < 0) {
+        x += period;
+        y--;
+    }
+    else if (x >= period) {
+        x -= period;
+        y++;
+    }
+    return ((unsigned)y < 192) ? sys->contention.delay[x] : 0;
+}
+
+// check if an address is in a contended 16 KB page
+static inline bool _zx_contended(const zx_t* sys, uint16_t addr) {
+    return 0 != (sys->contention.pages & (1<<(addr>>14)));
+}
+
+/*  The IO port contention patterns (C:n is a contended tick followed
+    by n ticks, N:n are n uncontended ticks):
+
+    high byte contended, ULA port:      C:1, C:3
+    high byte contended, no ULA port:   C:1, C:1, C:1, C:1
+    ULA port:                           N:1, C:3
+    otherwise:                          N:4
+*/
+static uint32_t _zx_io_contention(const zx_t* sys, uint64_t pins) {
+    if (pins & Z80_M1) {
+        // interrupt acknowledge
+        return 0;
+    }
+    const bool ula = 0 == (pins & Z80_A0);
+    uint32_t delay = 0;
+    if (_zx_contended(sys, Z80_GET_ADDR(pins))) {
+        delay = _zx_contention(sys, 0);
+        if (ula) {
+            delay += _zx_contention(sys, delay + 1);
+        }
+        else {
+            for (int i = 1; i < 4; i++) {
+                delay += _zx_contention(sys, delay + i);
+            }
+        }
+    }
+    else if (ula) {
+        delay = _zx_contention(sys, 1);
+    }
+    return delay;
+}
+
+static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
+    pins = z80_tick(&sys->cpu, pins);
+
+    // trap the opcode fetch at the ROM LD-BYTES routine for instant tape loading
+    if (sys->tape.size > 0) {
+        const uint64_t trap_mask = Z80_M1|Z80_MREQ|Z80_RD|0xFFFF;
+        const uint64_t trap_val = Z80_M1|Z80_MREQ|Z80_RD|_ZX_ROM_LD_BYTES;
+        if (((pins & trap_mask) == trap_val) && !sys->tape.playing) {
+            pins = _zx_tape_trap(sys, pins);
+        }
+    }
+    pins = _zx_tick_ula(sys, pins);
 
+    uint32_t delay = 0;
     if (pins & Z80_MREQ) {
         // a memory request
-        // FIXME: 'contended memory'
         const uint16_t addr = Z80_GET_ADDR(pins);
+        if (_zx_contended(sys, addr) && !(pins & Z80_RFSH)) {
+            delay = _zx_contention(sys, 0);
+            // the display RAM is always in a contended page
+            if ((pins & Z80_WR) && (sys->video.pages & (1<<(addr>>14)))) {
+                _zx_video_ram_wr(sys, addr & 0x3FFF);
+            }
+        }
         if (pins & Z80_RD) {
             Z80_SET_DATA(pins, mem_rd(&sys->mem, addr));
         }
@@ -447,6 +1105,7 @@ static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
         }
     }
     else if (pins & Z80_IORQ) {
+        delay = _zx_io_contention(sys, pins);
         if ((pins & Z80_A0) == 0) {
             /* Spectrum ULA (...............0)
                 Bits 5 and 7 as read by INning from Port 0xfe are always one
@@ -454,8 +1113,15 @@ static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
             if (pins & Z80_RD) {
                 // read from ULA
                 uint8_t data = (1<<7)|(1<<5);
-                // MIC/EAR flags -> bit 6
-                if (sys->last_fe_out & (1<<3|1<<4)) {
+                if (sys->tape.playing) {
+                    // tape signal -> bit 6
+                    _zx_tape_update(sys);
+                    if (sys->tape.level) {
+                        data |= (1<<6);
+                    }
+                }
+                else if (sys->last_fe_out & (1<<3|1<<4)) {
+                    // MIC/EAR flags -> bit 6
                     data |= (1<<6);
                 }
                 // keyboard matrix bits are encoded in the upper 8 bit of the port address
@@ -470,7 +1136,10 @@ static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
                 const uint8_t data = Z80_GET_DATA(pins);
                 sys->border_color = data & 7;
                 sys->last_fe_out = data;
-                beeper_set(&sys->beeper, 0 != (data & (1<<4)));
+                if (beeper_events_full(&sys->beeper)) {
+                    _zx_sync_audio(sys);
+                }
+                beeper_set_at(&sys->beeper, sys->audio_num_deferred, 0 != (data & (1<<4)));
             }
         }
         else if (((pins & (Z80_WR|Z80_A15|Z80_A1)) == Z80_WR) && (sys->type == ZX_TYPE_128)) {
@@ -483,6 +1152,7 @@ static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
             // AY-3-8912 access (1*............0.)
             if (pins & Z80_A14) { pins |= AY38910_BC1; }
             if (pins & Z80_WR) { pins |= AY38910_BDIR; }
+            _zx_sync_audio(sys);
             pins = ay38910_iorq(&sys->ay, pins) & Z80_PIN_MASK;
         }
         else if ((pins & (Z80_RD|Z80_A7|Z80_A6|Z80_A5)) == Z80_RD) {
@@ -491,23 +1161,12 @@ static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
         }
     }
 
-    // tick the AY at half frequency, use the buffered chip select
-    // pin mask so that the AY doesn't miss any IO requests
-    if (++sys->tick_count & 1) {
-        ay38910_tick(&sys->ay);
-    }
+    _zx_tick_audio(sys);
 
-    // tick the beeper
-    if (beeper_tick(&sys->beeper)) {
-        // new sample ready (if this is not a ZX128, sys->ay.sample will be 0)
-        const float sample = sys->beeper.sample + sys->ay.sample;
-        sys->audio.sample_buffer[sys->audio.sample_pos++] = sample;
-        if (sys->audio.sample_pos == sys->audio.num_samples) {
-            if (sys->audio.callback.func) {
-                sys->audio.callback.func(sys->audio.sample_buffer, sys->audio.num_samples, sys->audio.callback.user_data);
-            }
-            sys->audio.sample_pos = 0;
-        }
+    // the ULA holds the CPU for the contention delay, the rest of the system keeps running
+    for (; delay > 0; delay--) {
+        pins = _zx_tick_ula(sys, pins);
+        _zx_tick_audio(sys);
     }
     return pins;
 }
@@ -515,23 +1174,28 @@ static uint64_t _zx_tick(zx_t* sys, uint64_t pins) {
 uint32_t zx_exec(zx_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
     const uint32_t num_ticks = clk_us_to_ticks(sys->freq_hz, micro_seconds);
+    // a tick may be followed by contention delay ticks, so count ticks via tick_count
+    const uint32_t start_tick = sys->tick_count;
     uint64_t pins = sys->pins;
     if (0 == sys->debug.callback.func) {
         // run without debug hook
-        for (uint32_t tick = 0; tick < num_ticks; tick++) {
+        while ((sys->tick_count - start_tick) < num_ticks) {
             pins = _zx_tick(sys, pins);
         }
     }
     else {
         // run with debug hook
-        for (uint32_t tick = 0; (tick < num_ticks) && !(*sys->debug.stopped); tick++) {
+        while (((sys->tick_count - start_tick) < num_ticks) && !(*sys->debug.stopped)) {
             pins = _zx_tick(sys, pins);
+            // the debugger may inspect the AY
+            _zx_sync_audio(sys);
             sys->debug.callback.func(sys->debug.callback.user_data, pins);
         }
     }
+    _zx_sync_audio(sys);
     sys->pins = pins;
     kbd_update(&sys->kbd, micro_seconds);
-    return num_ticks;
+    return sys->tick_count - start_tick;
 }
 
 void zx_key_down(zx_t* sys, int key_code) {
@@ -673,6 +1337,53 @@ static void _zx_init_memory_map(zx_t* sys) {
         mem_map_ram(&sys->mem, 0, 0xC000, 0x4000, sys->ram[2]);
         mem_map_rom(&sys->mem, 0, 0x0000, 0x4000, sys->rom[0]);
     }
+    // on both models only the RAM at 0x4000 is contended after reset, this is also the display RAM
+    sys->contention.pages = (1<<1);
+    sys->video.pages = (1<<1);
+    _zx_video_dirty_all(sys);
+}
+
+// lookup tables for _zx_decode_scanline()
+static void _zx_init_video_tables(zx_t* sys) {
+    for (int pix = 0; pix < 256; pix++) {
+        uint8_t mask[8];
+        for (int px = 0; px < 8; px++) {
+            mask[px] = (pix & (0x80>>px)) ? 0xFF : 0x00;
+        }
+        memcpy(&sys->pixel_masks[pix], mask, 8);
+    }
+    for (int blink = 0; blink < 2; blink++) {
+        for (int clr = 0; clr < 256; clr++) {
+            uint8_t ink, paper;
+            if ((clr & (1<<7)) && blink) {
+                ink = (clr>>3) & 7;
+                paper = clr & 7;
+            }
+            else {
+                ink = clr & 7;
+                paper = (clr>>3) & 7;
+            }
+            // color bit 6: standard vs bright
+            sys->attr_colors[blink][clr][0] = ink | ((clr & (1<<6)) >> 3);
+            sys->attr_colors[blink][clr][1] = paper | ((clr & (1<<6)) >> 3);
+        }
+    }
+}
+
+/*  Compute the ULA contention delays for one display line, the first
+    contended tick is 14335 ticks after the vblank interrupt on the 48K,
+    and 14361 ticks on the 128K, followed by 128 ticks with the delay
+    pattern 6,5,4,3,2,1,0,0, this repeats for each of the 192 display
+    lines.
+*/
+static void _zx_init_contention(zx_t* sys) {
+    static const uint8_t pattern[8] = { 6, 5, 4, 3, 2, 1, 0, 0 };
+    const int first = (sys->type == ZX_TYPE_128) ? 14361 : 14335;
+    sys->contention.first_line = first / sys->scanline_period;
+    sys->contention.first_tick = first % sys->scanline_period;
+    for (int i = 0; i < sys->scanline_period; i++) {
+        sys->contention.delay[i] = (i < 128) ? pattern[i & 7] : 0;
+    }
 }
 
 static void _zx_init_keyboard_matrix(zx_t* sys) {
@@ -947,9 +1658,44 @@ bool zx_quickload(zx_t* sys, chips_range_t data) {
         sys->pins = z80_prefetch(&sys->cpu, (hdr->PC_h<<8)|hdr->PC_l);
     }
     sys->border_color = (hdr->flags0>>1) & 7;
+    _zx_video_dirty_all(sys);
+    return true;
+}
+
+bool zx_insert_tape(zx_t* sys, chips_range_t data) {
+    CHIPS_ASSERT(sys && sys->valid);
+    CHIPS_ASSERT(data.ptr);
+    zx_remove_tape(sys);
+    if ((data.size == 0) || (data.size > 0x7FFFFFFF)) {
+        return false;
+    }
+    const uint8_t* ptr = (const uint8_t*) data.ptr;
+    if (!_zx_tape_is_tzx(ptr, data.size)) {
+        // a TAP file must consist of complete blocks
+        size_t tap_pos = 0;
+        while ((tap_pos + 2) <= data.size) {
+            tap_pos += 2 + (ptr[tap_pos] | (ptr[tap_pos+1]<<8));
+        }
+        if (tap_pos != data.size) {
+            return false;
+        }
+    }
+    sys->tape.data = ptr;
+    sys->tape.size = (uint32_t)data.size;
+    sys->tape.id = mem_rom_id(0, ptr, sys->tape.size);
+    _zx_tape_rewind(sys);
     return true;
 }
 
+void zx_remove_tape(zx_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    sys->tape.data = 0;
+    sys->tape.size = 0;
+    sys->tape.id = 0;
+    sys->tape.pos = 0;
+    sys->tape.playing = false;
+}
+
 chips_display_info_t zx_display_info(zx_t* sys) {
     static const uint32_t palette[16] = {
         0xFF000000,     // std black
@@ -996,13 +1742,36 @@ chips_display_info_t zx_display_info(zx_t* sys) {
     return res;
 }
 
+// get the ROM images referenced by snapshots, returns number of ROM images
+static size_t _zx_shared_roms(zx_t* sys, mem_ext_t* roms) {
+    #if defined(CHIPS_SHARED_ROMS)
+    size_t num_roms = 0;
+    for (size_t i = 0; i < 2; i++) {
+        if (sys->rom[i]) {
+            roms[num_roms++] = (mem_ext_t){ .ptr = sys->rom[i], .size = 0x4000 };
+        }
+    }
+    return num_roms;
+    #else
+    (void)sys; (void)roms;
+    return 0;
+    #endif
+}
+
 uint32_t zx_save_snapshot(zx_t* sys, zx_t* dst) {
     CHIPS_ASSERT(sys && dst);
+    mem_ext_t roms[2] = {{0}};
+    const size_t num_roms = _zx_shared_roms(sys, roms);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
     chips_audio_callback_snapshot_onsave(&dst->audio.callback);
     ay38910_snapshot_onsave(&dst->ay);
-    mem_snapshot_onsave(&dst->mem, sys);
+    mem_snapshot_onsave_ext(&dst->mem, sys, roms, num_roms);
+    dst->tape.data = 0;
+    #if defined(CHIPS_SHARED_ROMS)
+    dst->rom[0] = 0;
+    dst->rom[1] = 0;
+    #endif
     return ZX_SNAPSHOT_VERSION;
 }
 
@@ -1011,13 +1780,37 @@ bool zx_load_snapshot(zx_t* sys, uint32_t version, zx_t* src) {
     if (version != ZX_SNAPSHOT_VERSION) {
         return false;
     }
+    #if defined(CHIPS_SHARED_ROMS)
+    // the snapshot only references the ROM images, these must be identical
+    if (src->rom_id != sys->rom_id) {
+        return false;
+    }
+    #endif
+    mem_ext_t roms[2] = {{0}};
+    const size_t num_roms = _zx_shared_roms(sys, roms);
     static zx_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
     chips_audio_callback_snapshot_onload(&im.audio.callback, &sys->audio.callback);
     ay38910_snapshot_onload(&im.ay, &sys->ay);
-    mem_snapshot_onload(&im.mem, sys);
+    mem_snapshot_onload_ext(&im.mem, sys, roms, num_roms);
+    // the snapshot only references the tape file, keep it only if the same tape is inserted
+    if ((im.tape.size > 0) && (im.tape.size == sys->tape.size) && (im.tape.id == sys->tape.id)) {
+        im.tape.data = sys->tape.data;
+    }
+    else {
+        im.tape.data = 0;
+        im.tape.size = 0;
+        im.tape.id = 0;
+        im.tape.pos = 0;
+        im.tape.playing = false;
+    }
+    #if defined(CHIPS_SHARED_ROMS)
+    im.rom[0] = sys->rom[0];
+    im.rom[1] = sys->rom[1];
+    #endif
     *sys = im;
+    _zx_video_dirty_all(sys);
     return true;
 }
 